@@ -0,0 +1,93 @@
+#include <iostream>
+#include <memory>
+
+#include "../library/QRCodeBatchVideoProcessor.hpp"
+#include "../library/QRCodePoseLog.hpp"
+#include<cstdlib>
+
+/*
+This program estimates the camera pose in every frame of a recorded video using all of the machine's cores and writes the poses, in frame order, to a CSV or binary pose log.
+
+Usage: processVideoBatch <video> <calibration file> <output.csv|output.bin> [--workers N] [--chunk-frames N]
+*/
+int main(int argc, char **argv)
+{
+//Separate the option flags from the positional arguments
+std::vector<std::string> positionalArguments;
+int numberOfWorkers = 0;
+int numberOfFramesPerChunk = QRCodeBatchDefaultNumberOfFramesPerChunk;
+for(int i=1; i < argc; i++)
+{
+std::string argument = argv[i];
+if(argument == "--workers" && i+1 < argc)
+{
+numberOfWorkers = atoi(argv[++i]);
+}
+else if(argument == "--chunk-frames" && i+1 < argc)
+{
+numberOfFramesPerChunk = atoi(argv[++i]);
+}
+else
+{
+positionalArguments.push_back(argument);
+}
+}
+
+if(positionalArguments.size() != 3)
+{
+fprintf(stderr, "Usage: %s <video> <calibration file> <output.csv|output.bin> [--workers N] [--chunk-frames N]\n", argv[0]);
+return 1;
+}
+
+const std::string &videoPath = positionalArguments[0];
+const std::string &calibrationFilePath = positionalArguments[1];
+const std::string &poseLogPath = positionalArguments[2];
+
+//Logs ending in .bin are written in the compact binary format, anything else as CSV
+QRCodePoseLogFormat poseLogFormat = POSE_LOG_CSV;
+if(poseLogPath.size() >= 4 && poseLogPath.compare(poseLogPath.size() - 4, 4, ".bin") == 0)
+{
+poseLogFormat = POSE_LOG_BINARY;
+}
+
+try
+{
+QRCodeCameraCalibration cameraCalibration;
+SOM_TRY
+loadCameraCalibration(calibrationFilePath, cameraCalibration);
+SOM_CATCH("Error loading camera calibration\n")
+
+std::unique_ptr<QRCodeBatchVideoProcessor> processor;
+std::unique_ptr<QRCodePoseLogWriter> poseLog;
+SOM_TRY
+processor.reset(new QRCodeBatchVideoProcessor(cameraCalibration, numberOfWorkers, numberOfFramesPerChunk));
+poseLog.reset(new QRCodePoseLogWriter(poseLogPath, poseLogFormat));
+SOM_CATCH("Error setting up batch processing\n")
+
+QRCodeBatchVideoSummary summary;
+SOM_TRY
+summary = processor->processVideo(videoPath, *poseLog, [](const QRCodeBatchVideoProgress &inputProgress)
+{
+if(inputProgress.totalNumberOfFrames > 0)
+{
+fprintf(stderr, "\r%lld/%lld frames (%.1lf%%), %lld poses, %.1lf frames/s", (long long) inputProgress.numberOfFramesProcessed, (long long) inputProgress.totalNumberOfFrames, 100.0 * inputProgress.numberOfFramesProcessed / inputProgress.totalNumberOfFrames, (long long) inputProgress.numberOfPoses, inputProgress.framesPerSecond);
+}
+else
+{
+fprintf(stderr, "\r%lld frames, %lld poses, %.1lf frames/s", (long long) inputProgress.numberOfFramesProcessed, (long long) inputProgress.numberOfPoses, inputProgress.framesPerSecond);
+}
+});
+poseLog->close();
+SOM_CATCH("Error processing video\n")
+
+fprintf(stderr, "\n");
+printf("Processed %lld frames in %.2lf s (%.1lf frames/s): %lld poses from %lld frames, %lld unreadable frames, %lld frames with errors\n", (long long) summary.numberOfFrames, summary.elapsedSeconds, summary.framesPerSecond, (long long) summary.numberOfPoses, (long long) summary.numberOfFramesWithPoses, (long long) summary.numberOfUnreadableFrames, (long long) summary.numberOfFramesWithErrors);
+}
+catch(SOMException &inputException)
+{
+fprintf(stderr, "\n%s", inputException.toString().c_str());
+return 1;
+}
+
+return 0;
+}
@@ -0,0 +1,162 @@
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+#include<chrono>
+#include<random>
+#include<vector>
+#include<memory>
+
+#include "../library/QRCodeBatchPoseSolver.hpp"
+#include "syntheticTags.hpp"
+#include <opencv2/calib3d/calib3d.hpp>
+
+/*
+This program compares solving the poses of every tag in a frame one at a time (solvePnP, Rodrigues and invert with temporary matrices, the way the estimator used to) against QRCodeBatchPoseSolver, with and without a worker pool, for 1 to 200 tags per frame.  The tags are placed at random in front of the camera from the example calibration and their projected corners get 0.25 pixels of noise, so the position error of each method is reported as well.  Only the solves are timed: the poses are read back and their errors added up outside of the timed sections, the same way for every method.
+
+Usage: batchPoseSolverBenchmark [numberOfFramesPerSize]
+*/
+
+//Declare handy constants
+static const int tagCounts[] = {1, 2, 5, 10, 20, 50, 100, 200};
+static const double cornerNoiseInPixels = .25;
+static const double minimumTagDepth = .5; //Meters
+static const double maximumTagDepth = 3.5;
+
+/*
+This struct adds up the time and position errors of one method.
+*/
+struct methodResults
+{
+double seconds = 0.0; //Time spent solving
+double errorSum = 0.0; //Sum of the position errors in meters
+int numberOfPoses = 0; //Number of poses in errorSum
+
+/*
+This function returns the mean position error.
+@return: The mean error in meters (0 if there were no poses)
+*/
+double getMeanError() const
+{
+return numberOfPoses > 0 ? errorSum / numberOfPoses : 0.0;
+}
+};
+
+/*
+This function times the batch solve of one frame, then (untimed) adds the errors of its poses to the results.
+@param inputBatchSolver: The solver to use
+@param inputFrame: The tags of the frame
+@param inputCameraMatrix: The camera matrix to solve with
+@param inputDistortionParameters: The distortion to solve with
+@param inputResults: The results to add the time and errors to
+*/
+static void timeBatchSolve(QRCodeBatchPoseSolver &inputBatchSolver, const std::vector<syntheticTag> &inputFrame, const cv::Mat_<double> &inputCameraMatrix, const cv::Mat_<double> &inputDistortionParameters, methodResults &inputResults)
+{
+auto startTime = std::chrono::steady_clock::now();
+inputBatchSolver.clear();
+for(const syntheticTag &tag : inputFrame)
+{
+inputBatchSolver.addTag(tag.corners, tag.QRCodeDimension);
+}
+inputBatchSolver.solve(inputCameraMatrix, inputDistortionParameters);
+inputResults.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+cv::Matx44d cameraPose;
+for(int i=0; i < inputFrame.size(); i++)
+{
+if(inputBatchSolver.getCameraPose(i, cameraPose))
+{
+inputResults.errorSum += getPositionError(cameraPose, inputFrame[i].cameraPosition);
+inputResults.numberOfPoses++;
+}
+}
+}
+
+int main(int argc, char **argv)
+{
+int numberOfFramesPerSize = 200;
+if(argc > 1)
+{
+numberOfFramesPerSize = std::max(1, atoi(argv[1]));
+}
+
+//Same calibration as the example program
+cv::Mat_<double> cameraMatrix;
+cv::Mat_<double> distortionParameters;
+getExampleCameraCalibration(cameraMatrix, distortionParameters);
+
+std::shared_ptr<SOMWorkerPool> workerPool(new SOMWorkerPool());
+QRCodeBatchPoseSolver batchSolver;
+QRCodeBatchPoseSolver threadedBatchSolver(workerPool);
+std::mt19937 randomNumberGenerator(1);
+
+printf("%d frames per size, %d worker threads\n", numberOfFramesPerSize, workerPool->getNumberOfWorkers());
+printf("%6s %14s %14s %14s %14s %14s %14s\n", "tags", "serial us", "batch us", "threaded us", "serial err mm", "batch err mm", "thread err mm");
+
+for(int tagCount : tagCounts)
+{
+std::vector<std::vector<syntheticTag> > frames(numberOfFramesPerSize);
+for(int frameIndex = 0; frameIndex < numberOfFramesPerSize; frameIndex++)
+{
+makeSyntheticTags(tagCount, cornerNoiseInPixels, minimumTagDepth, maximumTagDepth, cameraMatrix, distortionParameters, randomNumberGenerator, frames[frameIndex]);
+}
+
+//Only the solves are timed; the errors of every method are added up afterwards in the same way
+methodResults serialResults;
+methodResults batchResults;
+methodResults threadedResults;
+std::vector<cv::Matx44d> serialPoses;
+
+//One tag at a time, as estimateOneOrMoreStatesFromGrayscaleFrame used to
+for(const std::vector<syntheticTag> &frame : frames)
+{
+serialPoses.resize(frame.size());
+auto startTime = std::chrono::steady_clock::now();
+for(int i=0; i < frame.size(); i++)
+{
+double buf = frame[i].QRCodeDimension/2.0;
+std::vector<cv::Point3d> objectPoints = {cv::Point3d(-buf, -buf, 0), cv::Point3d(buf, -buf, 0), cv::Point3d(buf, buf, 0), cv::Point3d(-buf, buf, 0)};
+std::vector<cv::Point2d> imagePoints(frame[i].corners, frame[i].corners + 4);
+cv::Mat_<double> rotationVector(3, 1);
+cv::Mat_<double> translationVector(3, 1);
+cv::solvePnP(objectPoints, imagePoints, cameraMatrix, distortionParameters, rotationVector, translationVector);
+
+cv::Mat_<double> rotationMatrix;
+cv::Rodrigues(rotationVector, rotationMatrix);
+cv::Mat_<double> viewMatrix = cv::Mat_<double>::eye(4, 4);
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+viewMatrix(row, col) = rotationMatrix(row, col);
+}
+viewMatrix(row, 3) = translationVector(row, 0);
+}
+cv::Mat_<double> cameraPoseMatrix = viewMatrix.inv();
+serialPoses[i] = cv::Matx44d(cameraPoseMatrix);
+}
+serialResults.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+for(int i=0; i < frame.size(); i++)
+{
+serialResults.errorSum += getPositionError(serialPoses[i], frame[i].cameraPosition);
+serialResults.numberOfPoses++;
+}
+}
+
+//Batched on the calling thread
+for(const std::vector<syntheticTag> &frame : frames)
+{
+timeBatchSolve(batchSolver, frame, cameraMatrix, distortionParameters, batchResults);
+}
+
+//Batched and split across the worker pool when it is large enough
+for(const std::vector<syntheticTag> &frame : frames)
+{
+timeBatchSolve(threadedBatchSolver, frame, cameraMatrix, distortionParameters, threadedResults);
+}
+
+printf("%6d %14.2lf %14.2lf %14.2lf %14.3lf %14.3lf %14.3lf\n", tagCount, 1e6*serialResults.seconds/numberOfFramesPerSize, 1e6*batchResults.seconds/numberOfFramesPerSize, 1e6*threadedResults.seconds/numberOfFramesPerSize, 1e3*serialResults.getMeanError(), 1e3*batchResults.getMeanError(), 1e3*threadedResults.getMeanError());
+}
+
+return 0;
+}
@@ -0,0 +1,144 @@
+#include<cstdio>
+#include<cstdlib>
+#include<ctime>
+#include<vector>
+#include<memory>
+
+#include "../library/QRCodeStateEstimator.hpp"
+
+/*
+This program measures what contrast enhancement buys on real footage (such as a recording of tags in a dim warehouse).  The frames of the video are decoded into memory first, then the same frames are run through an estimator with each preprocessing setting on one thread.  The thread's CPU time is measured, so detections per CPU second is the number of detections one core delivers per second with that setting.
+
+Usage: contrastEnhancementBenchmark <video> [calibration file] [maximumNumberOfFrames]
+Without a calibration file a distortion free camera with a focal length of the frame width is assumed, which is good enough for counting detections.
+*/
+
+/*
+This struct describes one preprocessing setting to measure.
+*/
+struct benchmarkConfiguration
+{
+const char *name;
+QRCodeContrastEnhancementMode mode;
+bool tracksTags;
+};
+
+/*
+This function returns the CPU time used by the calling thread.
+@return: The CPU time in seconds
+*/
+static double getThreadCPUSeconds()
+{
+timespec time;
+clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+return time.tv_sec + 1e-9*time.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+if(argc < 2)
+{
+fprintf(stderr, "Usage: %s <video> [calibration file] [maximumNumberOfFrames]\n", argv[0]);
+return 1;
+}
+
+int maximumNumberOfFrames = 600;
+if(argc > 3)
+{
+maximumNumberOfFrames = std::max(1, atoi(argv[3]));
+}
+
+//Decode up front so only the estimator is timed
+std::vector<cv::Mat> grayscaleFrames;
+{
+cv::VideoCapture video(argv[1]);
+if(!video.isOpened())
+{
+fprintf(stderr, "Unable to open video %s\n", argv[1]);
+return 1;
+}
+
+cv::Mat frame;
+while(grayscaleFrames.size() < maximumNumberOfFrames && video.read(frame) && !frame.empty())
+{
+cv::Mat grayscaleFrame;
+cv::cvtColor(frame, grayscaleFrame, CV_BGR2GRAY);
+grayscaleFrames.push_back(grayscaleFrame);
+}
+}
+
+if(grayscaleFrames.size() == 0)
+{
+fprintf(stderr, "No frames could be decoded from %s\n", argv[1]);
+return 1;
+}
+
+try
+{
+QRCodeCameraCalibration cameraCalibration;
+if(argc > 2)
+{
+SOM_TRY
+loadCameraCalibration(argv[2], cameraCalibration);
+SOM_CATCH("Error loading camera calibration\n")
+}
+else
+{
+cameraCalibration.imageWidth = grayscaleFrames[0].cols;
+cameraCalibration.imageHeight = grayscaleFrames[0].rows;
+cameraCalibration.cameraMatrix = cv::Mat_<double>::zeros(3, 3);
+cameraCalibration.cameraMatrix(0, 0) = grayscaleFrames[0].cols;
+cameraCalibration.cameraMatrix(1, 1) = grayscaleFrames[0].cols;
+cameraCalibration.cameraMatrix(0, 2) = (grayscaleFrames[0].cols - 1) / 2.0;
+cameraCalibration.cameraMatrix(1, 2) = (grayscaleFrames[0].rows - 1) / 2.0;
+cameraCalibration.cameraMatrix(2, 2) = 1.0;
+cameraCalibration.distortionParameters = cv::Mat_<double>::zeros(1, 5);
+}
+
+std::vector<benchmarkConfiguration> configurations =
+{
+{"none", CONTRAST_ENHANCEMENT_NONE, false},
+{"threshold full frame", CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD, false},
+{"threshold tracking", CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD, true},
+{"contrast full frame", CONTRAST_ENHANCEMENT_LOCAL_CONTRAST, false},
+{"contrast tracking", CONTRAST_ENHANCEMENT_LOCAL_CONTRAST, true}
+};
+
+printf("%d frames of %dx%d\n", (int) grayscaleFrames.size(), grayscaleFrames[0].cols, grayscaleFrames[0].rows);
+printf("%-22s %14s %12s %14s %20s\n", "preprocessing", "frames w/ tags", "detections", "CPU ms/frame", "detections/s/core");
+
+QRCodeDetection detections[QRCodeMaximumDetectionsPerFrame];
+for(const benchmarkConfiguration &configuration : configurations)
+{
+std::unique_ptr<QRCodeStateEstimator> estimator;
+SOM_TRY
+estimator.reset(new QRCodeStateEstimator(cameraCalibration, false));
+SOM_CATCH("Error creating estimator\n")
+estimator->contrastEnhancer.mode = configuration.mode;
+estimator->contrastEnhancementTracksTags = configuration.tracksTags;
+
+int numberOfFramesWithTags = 0;
+int numberOfDetections = 0;
+double startCPUSeconds = getThreadCPUSeconds();
+for(const cv::Mat &grayscaleFrame : grayscaleFrames)
+{
+int numberOfFrameDetections = 0;
+if(estimator->tryEstimateStatesFromGrayscaleFrame(grayscaleFrame, detections, QRCodeMaximumDetectionsPerFrame, numberOfFrameDetections) == QRCODE_STATUS_OK)
+{
+numberOfFramesWithTags++;
+numberOfDetections += numberOfFrameDetections;
+}
+}
+double CPUSeconds = getThreadCPUSeconds() - startCPUSeconds;
+
+printf("%-22s %13.1lf%% %12d %14.3lf %20.1lf\n", configuration.name, 100.0 * numberOfFramesWithTags / grayscaleFrames.size(), numberOfDetections, 1e3 * CPUSeconds / grayscaleFrames.size(), CPUSeconds > 0.0 ? numberOfDetections / CPUSeconds : 0.0);
+}
+}
+catch(SOMException &inputException)
+{
+fprintf(stderr, "%s", inputException.toString().c_str());
+return 1;
+}
+
+return 0;
+}
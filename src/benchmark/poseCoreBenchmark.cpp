@@ -0,0 +1,184 @@
+#include<cstdio>
+#include<cstdlib>
+#include<cmath>
+#include<chrono>
+#include<random>
+#include<vector>
+#include<algorithm>
+
+#include "../library/QRCodePoseCore.hpp"
+#include "syntheticTags.hpp"
+#include <opencv2/calib3d/calib3d.hpp>
+
+/*
+This program compares the speed and accuracy of the single precision QRCodePoseCore<float> against the double precision paths: solvePnP (what the estimator uses by default) and QRCodePoseCore<double>.  The tags are placed at random in front of the camera from the example calibration and their projected corners get Gaussian noise, so the position error of each method is reported along with how far the float poses are from the double ones (the cost of single precision by itself).
+
+Usage: poseCoreBenchmark [numberOfTags] [cornerNoiseInPixels]
+*/
+
+//Declare handy constants
+static const double minimumTagDepth = .25; //Meters
+static const double maximumTagDepth = 1.75;
+
+/*
+This struct holds the corners of one tag in single precision.
+*/
+struct singlePrecisionCorners
+{
+cv::Point2f corners[4];
+};
+
+/*
+This function returns the distance between the positions in two camera poses.
+@param inputCameraPose: The first 4x4 pose
+@param inputOtherCameraPose: The second 4x4 pose
+@return: The distance in meters
+*/
+static double getPositionDifference(const cv::Matx44d &inputCameraPose, const cv::Matx44d &inputOtherCameraPose)
+{
+cv::Point3d difference(inputCameraPose(0, 3) - inputOtherCameraPose(0, 3), inputCameraPose(1, 3) - inputOtherCameraPose(1, 3), inputCameraPose(2, 3) - inputOtherCameraPose(2, 3));
+return sqrt(difference.dot(difference));
+}
+
+/*
+This function prints a line of the results table.
+@param inputName: The name of the method
+@param inputSeconds: How long the method took for all of the tags
+@param inputPositionErrors: The position error of each solved tag in meters
+@param inputNumberOfTags: The number of tags given to the method
+*/
+static void printResults(const char *inputName, double inputSeconds, std::vector<double> &inputPositionErrors, int inputNumberOfTags)
+{
+double meanError = 0.0;
+for(double error : inputPositionErrors)
+{
+meanError += error;
+}
+meanError = inputPositionErrors.size() > 0 ? meanError / inputPositionErrors.size() : 0.0;
+
+double medianError = 0.0;
+if(inputPositionErrors.size() > 0)
+{
+std::nth_element(inputPositionErrors.begin(), inputPositionErrors.begin() + inputPositionErrors.size()/2, inputPositionErrors.end());
+medianError = inputPositionErrors[inputPositionErrors.size()/2];
+}
+
+printf("%-24s %12.3lf %16.3lf %16.3lf %10d\n", inputName, 1e6*inputSeconds/inputNumberOfTags, 1e3*medianError, 1e3*meanError, inputNumberOfTags - (int) inputPositionErrors.size());
+}
+
+int main(int argc, char **argv)
+{
+int numberOfTags = 100000;
+double cornerNoiseInPixels = .25;
+if(argc > 1)
+{
+numberOfTags = std::max(1, atoi(argv[1]));
+}
+if(argc > 2)
+{
+cornerNoiseInPixels = std::max(0.0, atof(argv[2]));
+}
+
+//Same calibration as the example program
+cv::Mat_<double> cameraMatrix;
+cv::Mat_<double> distortionParameters;
+getExampleCameraCalibration(cameraMatrix, distortionParameters);
+
+std::mt19937 randomNumberGenerator(1);
+std::vector<syntheticTag> tags;
+makeSyntheticTags(numberOfTags, cornerNoiseInPixels, minimumTagDepth, maximumTagDepth, cameraMatrix, distortionParameters, randomNumberGenerator, tags);
+
+QRCodePoseCore<float> floatCore;
+QRCodePoseCore<double> doubleCore;
+floatCore.setCameraModel(cameraMatrix, distortionParameters);
+doubleCore.setCameraModel(cameraMatrix, distortionParameters);
+
+std::vector<cv::Matx44d> solvePnPPoses(tags.size());
+std::vector<cv::Matx44d> doublePoses(tags.size());
+std::vector<cv::Matx44d> floatPoses(tags.size());
+std::vector<unsigned char> doublePoseIsValid(tags.size());
+std::vector<unsigned char> floatPoseIsValid(tags.size());
+
+//The estimator's default path
+auto startTime = std::chrono::steady_clock::now();
+for(int i=0; i < tags.size(); i++)
+{
+double buf = tags[i].QRCodeDimension/2.0;
+cv::Point3d objectPoints[4] = {cv::Point3d(-buf, -buf, 0), cv::Point3d(buf, -buf, 0), cv::Point3d(buf, buf, 0), cv::Point3d(-buf, buf, 0)};
+cv::Mat objectPointsMatrix(4, 1, CV_64FC3, objectPoints);
+cv::Mat imagePointsMatrix(4, 1, CV_64FC2, tags[i].corners);
+cv::Matx31d rotationVector;
+cv::Matx31d translationVector;
+cv::solvePnP(objectPointsMatrix, imagePointsMatrix, cameraMatrix, distortionParameters, rotationVector, translationVector);
+
+cv::Matx33d rotationMatrix;
+cv::Rodrigues(rotationVector, rotationMatrix);
+QRCodePoseCore<double>::invertTagPose(rotationMatrix, cv::Vec<double, 3>(translationVector(0), translationVector(1), translationVector(2)), solvePnPPoses[i]);
+}
+double solvePnPSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+startTime = std::chrono::steady_clock::now();
+for(int i=0; i < tags.size(); i++)
+{
+doublePoseIsValid[i] = doubleCore.solveCameraPose(tags[i].corners, tags[i].QRCodeDimension, doublePoses[i]);
+}
+double doubleSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+//The float corners are made outside of the timed loop, as the estimator would get them from zbar's integer corners
+std::vector<singlePrecisionCorners> floatCorners(tags.size());
+for(int i=0; i < tags.size(); i++)
+{
+for(int cornerIndex = 0; cornerIndex < 4; cornerIndex++)
+{
+floatCorners[i].corners[cornerIndex] = tags[i].corners[cornerIndex];
+}
+}
+
+startTime = std::chrono::steady_clock::now();
+cv::Matx44f floatPose;
+for(int i=0; i < tags.size(); i++)
+{
+floatPoseIsValid[i] = floatCore.solveCameraPose(floatCorners[i].corners, (float) tags[i].QRCodeDimension, floatPose);
+for(int element = 0; element < 16; element++)
+{
+floatPoses[i].val[element] = floatPose.val[element];
+}
+}
+double floatSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+std::vector<double> solvePnPErrors;
+std::vector<double> doubleErrors;
+std::vector<double> floatErrors;
+std::vector<double> floatToDoubleDifferences;
+for(int i=0; i < tags.size(); i++)
+{
+solvePnPErrors.push_back(getPositionError(solvePnPPoses[i], tags[i].cameraPosition));
+if(doublePoseIsValid[i])
+{
+doubleErrors.push_back(getPositionError(doublePoses[i], tags[i].cameraPosition));
+}
+if(floatPoseIsValid[i])
+{
+floatErrors.push_back(getPositionError(floatPoses[i], tags[i].cameraPosition));
+}
+if(doublePoseIsValid[i] && floatPoseIsValid[i])
+{
+floatToDoubleDifferences.push_back(getPositionDifference(floatPoses[i], doublePoses[i]));
+}
+}
+
+printf("%d tags, %.3lf pixels of corner noise\n", (int) tags.size(), cornerNoiseInPixels);
+printf("%-24s %12s %16s %16s %10s\n", "method", "us per tag", "median err mm", "mean err mm", "failures");
+printResults("solvePnP (double)", solvePnPSeconds, solvePnPErrors, tags.size());
+printResults("QRCodePoseCore<double>", doubleSeconds, doubleErrors, tags.size());
+printResults("QRCodePoseCore<float>", floatSeconds, floatErrors, tags.size());
+
+//Same math, so this is only the rounding error of single precision
+std::sort(floatToDoubleDifferences.begin(), floatToDoubleDifferences.end());
+if(floatToDoubleDifferences.size() > 0)
+{
+printf("float vs double position difference: median %.4lf mm, 99th percentile %.4lf mm, max %.4lf mm\n", 1e3*floatToDoubleDifferences[floatToDoubleDifferences.size()/2], 1e3*floatToDoubleDifferences[(floatToDoubleDifferences.size()*99)/100], 1e3*floatToDoubleDifferences.back());
+}
+
+return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef SYNTHETICTAGSHPP
+#define SYNTHETICTAGSHPP
+
+#include<cmath>
+#include<random>
+#include<vector>
+#include<algorithm>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+//Declare handy constants
+static constexpr int syntheticTagImageWidth = 1280; //Size of the image of the example calibration
+static constexpr int syntheticTagImageHeight = 720;
+
+/*
+This struct holds the corners of one synthetic tag and where the camera really is relative to it.
+*/
+struct syntheticTag
+{
+cv::Point2d corners[4];
+double QRCodeDimension;
+cv::Point3d cameraPosition; //Position of the camera in the coordinate system of the tag
+};
+
+/*
+This function fills in the calibration of the example program, which the synthetic tags are projected with.
+@param inputCameraMatrixBuffer: The buffer to store the 3x3 camera matrix in
+@param inputDistortionParametersBuffer: The buffer to store the 1x5 distortion parameters in
+*/
+inline void getExampleCameraCalibration(cv::Mat_<double> &inputCameraMatrixBuffer, cv::Mat_<double> &inputDistortionParametersBuffer)
+{
+inputCameraMatrixBuffer = cv::Mat_<double>::zeros(3, 3);
+inputCameraMatrixBuffer(0, 0) = 1.3442848643472917e+03;
+inputCameraMatrixBuffer(0, 2) = 6.3950000000000000e+02;
+inputCameraMatrixBuffer(1, 1) = 1.3442848643472917e+03;
+inputCameraMatrixBuffer(1, 2) = 3.595e+02;
+inputCameraMatrixBuffer(2, 2) = 1.0;
+
+inputDistortionParametersBuffer = cv::Mat_<double>::zeros(1, 5);
+inputDistortionParametersBuffer(0, 0) = 7.9440223269640672e-03;
+inputDistortionParametersBuffer(0, 1) = -5.6562236732221527e-01;
+inputDistortionParametersBuffer(0, 4) = 1.6991852512288661e+00;
+}
+
+/*
+This function makes tags with random poses that are in front of the camera and inside its syntheticTagImageWidth x syntheticTagImageHeight image.
+@param inputNumberOfTags: How many tags to make
+@param inputCornerNoiseInPixels: The standard deviation of the noise added to each corner coordinate
+@param inputMinimumDepth: The smallest distance in meters of a tag's center along the camera's axis
+@param inputMaximumDepth: The largest distance in meters of a tag's center along the camera's axis
+@param inputCameraMatrix: The camera matrix to project with
+@param inputDistortionParameters: The distortion to project with
+@param inputRandomNumberGenerator: The random number generator to use
+@param inputTagsBuffer: The buffer to store the tags in
+*/
+inline void makeSyntheticTags(int inputNumberOfTags, double inputCornerNoiseInPixels, double inputMinimumDepth, double inputMaximumDepth, const cv::Mat_<double> &inputCameraMatrix, const cv::Mat_<double> &inputDistortionParameters, std::mt19937 &inputRandomNumberGenerator, std::vector<syntheticTag> &inputTagsBuffer)
+{
+std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+std::normal_distribution<double> noise(0.0, std::max(inputCornerNoiseInPixels, 1e-12));
+
+inputTagsBuffer.clear();
+while(inputTagsBuffer.size() < inputNumberOfTags)
+{
+syntheticTag tag;
+tag.QRCodeDimension = .15 + .05*uniform(inputRandomNumberGenerator);
+double buf = tag.QRCodeDimension/2.0;
+std::vector<cv::Point3d> objectPoints = {cv::Point3d(-buf, -buf, 0), cv::Point3d(buf, -buf, 0), cv::Point3d(buf, buf, 0), cv::Point3d(-buf, buf, 0)};
+
+cv::Mat_<double> rotationVector(3, 1);
+cv::Mat_<double> translationVector(3, 1);
+rotationVector(0, 0) = .5*uniform(inputRandomNumberGenerator);
+rotationVector(1, 0) = .5*uniform(inputRandomNumberGenerator);
+rotationVector(2, 0) = 3.0*uniform(inputRandomNumberGenerator);
+translationVector(2, 0) = (inputMinimumDepth + inputMaximumDepth)/2.0 + (inputMaximumDepth - inputMinimumDepth)/2.0*uniform(inputRandomNumberGenerator);
+translationVector(0, 0) = .4*translationVector(2, 0)*uniform(inputRandomNumberGenerator);
+translationVector(1, 0) = .2*translationVector(2, 0)*uniform(inputRandomNumberGenerator);
+
+std::vector<cv::Point2d> imagePoints;
+cv::projectPoints(objectPoints, rotationVector, translationVector, inputCameraMatrix, inputDistortionParameters, imagePoints);
+
+bool isInImage = true;
+for(int i=0; i < 4; i++)
+{
+tag.corners[i] = imagePoints[i] + cv::Point2d(noise(inputRandomNumberGenerator), noise(inputRandomNumberGenerator));
+isInImage = isInImage && tag.corners[i].x >= 0 && tag.corners[i].x < syntheticTagImageWidth && tag.corners[i].y >= 0 && tag.corners[i].y < syntheticTagImageHeight;
+}
+if(!isInImage)
+{
+continue;
+}
+
+cv::Mat_<double> rotationMatrix;
+cv::Rodrigues(rotationVector, rotationMatrix);
+cv::Mat_<double> cameraPosition = -rotationMatrix.t() * translationVector;
+tag.cameraPosition = cv::Point3d(cameraPosition(0, 0), cameraPosition(1, 0), cameraPosition(2, 0));
+inputTagsBuffer.push_back(tag);
+}
+}
+
+/*
+This function returns the distance between an estimated camera pose and the true camera position.
+@param inputCameraPose: The estimated 4x4 pose
+@param inputCameraPosition: The true position
+@return: The distance in meters
+*/
+inline double getPositionError(const cv::Matx44d &inputCameraPose, const cv::Point3d &inputCameraPosition)
+{
+cv::Point3d difference(inputCameraPose(0, 3) - inputCameraPosition.x, inputCameraPose(1, 3) - inputCameraPosition.y, inputCameraPose(2, 3) - inputCameraPosition.z);
+return sqrt(difference.dot(difference));
+}
+
+#endif
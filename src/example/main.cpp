@@ -3,7 +3,18 @@
 #include <memory>
 
 #include "../library/QRCodeStateEstimator.hpp"
+#include "../library/QRCodePoseChannel.hpp"
+#include "../library/QRCodeFrameRecording.hpp"
+#include "../library/QRCodeLatencyTrace.hpp"
+#include "../library/SOMThreadConfiguration.hpp"
 #include<cmath>
+#include<thread>
+#include<chrono>
+
+//Declare handy constants
+static constexpr uint64_t traceExportInterval = 300; //Frames between rewrites of the --trace file
+static constexpr int maximumNumberOfConsecutiveDroppedCaptures = 100; //Give up on the camera (it was probably unplugged) after this many empty frames in a row
+static constexpr int droppedCaptureRetryDelayInMilliseconds = 20; //Wait between retries after an empty frame
 
 int main(int argc, char **argv) 
 {
@@ -77,12 +88,128 @@ distortionParameters.at<double>(0, 2) =  0.0;
 distortionParameters.at<double>(0, 3) =  0.0;
 distortionParameters.at<double>(0, 4) = 1.6991852512288661e+00;
 
+//Separate the option flags from the positional arguments ([cameraIndex] [poseChannelName])
+std::vector<std::string> positionalArguments;
+std::string recordingFilePath;
+std::string replayFilePath;
+std::string calibrationFilePath;
+std::string traceFilePath;
+SOMThreadConfiguration threadConfiguration;
+bool compressRecording = false;
+bool replayAtRecordedSpeed = false;
+for(int i=1; i < argc; i++)
+{
+std::string argument = argv[i];
+if((argument == "--record" || argument == "--record-compressed") && i+1 < argc)
+{
+compressRecording = (argument == "--record-compressed");
+recordingFilePath = argv[++i];
+}
+else if(argument == "--replay" && i+1 < argc)
+{
+replayFilePath = argv[++i];
+}
+else if(argument == "--calibration" && i+1 < argc)
+{
+calibrationFilePath = argv[++i];
+}
+else if(argument == "--trace" && i+1 < argc)
+{
+traceFilePath = argv[++i];
+}
+else if(argument == "--cpu-cores" && i+1 < argc)
+{
+SOM_TRY
+threadConfiguration.CPUCores = parseCPUCoreList(argv[++i]);
+SOM_CATCH("Error parsing CPU core list\n")
+}
+else if(argument == "--fifo-priority" && i+1 < argc)
+{
+threadConfiguration.realTimePriority = atoi(argv[++i]);
+}
+else if(argument == "--bind-numa")
+{
+threadConfiguration.bindMemoryToLocalNUMANode = true;
+}
+else if(argument == "--realtime")
+{
+replayAtRecordedSpeed = true;
+}
+else
+{
+positionalArguments.push_back(argument);
+}
+}
+
+//Pin/prioritize this thread before anything is allocated, so the estimator's memory comes from the local NUMA node
+SOM_TRY
+applyThreadConfiguration(threadConfiguration);
+SOM_CATCH("Error configuring main thread\n")
+
+//Use the calibration above unless a calibration file (such as exampleOpenCVCameraCalibrationFile.xml) is given
+QRCodeCameraCalibration cameraCalibration;
+cameraCalibration.imageWidth = 1280;
+cameraCalibration.imageHeight = 720;
+cameraCalibration.cameraMatrix = cameraMatrix;
+cameraCalibration.distortionParameters = distortionParameters;
+if(calibrationFilePath.size() > 0)
+{
+SOM_TRY
+loadCameraCalibration(calibrationFilePath, cameraCalibration);
+SOM_CATCH("Error loading camera calibration\n")
+}
+
+//Replay a recording through the estimator instead of using the camera, and report whether the poses still match
+if(replayFilePath.size() > 0)
+{
+std::unique_ptr<QRCodeFrameRecording> recording;
+std::unique_ptr<QRCodeStateEstimator> replayEstimator;
+QRCodeReplaySummary replaySummary;
+bool replayMatched = false;
+
+SOM_TRY
+recording.reset(new QRCodeFrameRecording(replayFilePath));
+replayEstimator.reset(new QRCodeStateEstimator(cameraCalibration, false));
+replayMatched = replayFrameRecording(*recording, *replayEstimator, replayAtRecordedSpeed, 1e-9, replaySummary);
+SOM_CATCH("Error replaying recording\n")
+
+printf("Replayed %d frames, %d mismatched, largest pose difference %g, %lf ms per frame in estimator\n", replaySummary.numberOfFramesReplayed, replaySummary.numberOfMismatchedFrames, replaySummary.largestPoseDifference, replaySummary.numberOfFramesReplayed > 0 ? 1000.0 * replaySummary.totalEstimationSeconds / replaySummary.numberOfFramesReplayed : 0.0);
+return replayMatched ? 0 : 1;
+}
+
 //Make it so that you can set which camera to use as a video source
 int cam_idx = 0;
 //Set camera ID from argument if there is one
-if (argc == 2) 
+if (positionalArguments.size() >= 1) 
+{
+cam_idx = atoi(positionalArguments[0].c_str());
+}
+
+//Publish poses to a shared memory channel for other processes if a channel name (such as "/qrcode_poses") is given
+std::unique_ptr<QRCodePosePublisher> posePublisher;
+if (positionalArguments.size() >= 2)
 {
-cam_idx = atoi(argv[1]);
+SOM_TRY
+posePublisher.reset(new QRCodePosePublisher(positionalArguments[1]));
+SOM_CATCH("Error creating pose channel\n")
+}
+
+//Record the frames and the estimator output so the session can be replayed later
+std::unique_ptr<QRCodeFrameRecorder> frameRecorder;
+if(recordingFilePath.size() > 0)
+{
+SOM_TRY
+frameRecorder.reset(new QRCodeFrameRecorder(recordingFilePath, compressRecording));
+SOM_CATCH("Error creating recording\n")
+}
+
+//Keep the timestamps of each frame's stages so they can be viewed as a Chrome trace
+std::unique_ptr<QRCodeLatencyTracer> latencyTracer;
+if(traceFilePath.size() > 0)
+{
+SOM_TRY
+latencyTracer.reset(new QRCodeLatencyTracer());
+SOM_CATCH("Error creating latency tracer\n")
 }
 
 //Open opencv camera video source
@@ -94,47 +221,120 @@ exit(EXIT_FAILURE);
 }
 
 //Make size same as calibration (Change to match your calibration)
-cap.set(CV_CAP_PROP_FRAME_WIDTH, 1280);
-cap.set(CV_CAP_PROP_FRAME_HEIGHT, 720);
+cap.set(CV_CAP_PROP_FRAME_WIDTH, cameraCalibration.imageWidth);
+cap.set(CV_CAP_PROP_FRAME_HEIGHT, cameraCalibration.imageHeight);
 
 //Initialize the state estimator, while wrapping any exceptions so we know where it came from
 std::unique_ptr<QRCodeStateEstimator> stateEstimator;
 SOM_TRY
-stateEstimator.reset(new QRCodeStateEstimator(1280, 720, cameraMatrix, distortionParameters, true));
+stateEstimator.reset(new QRCodeStateEstimator(cameraCalibration, true));
 SOM_CATCH("Error initializing state estimator\n")
 
 //Initialize some variables we are going to use while processing frames
 cv::Mat frame;
-cv::Mat cameraPoseBuffer;
-std::string QRCodeIdentifierBuffer;
-double QRCodeDimensionBuffer;
+cv::Mat grayscaleFrame;
+std::vector<cv::Mat> cameraPosesBuffer;
+std::vector<std::string> QRCodeIdentifiersBuffer;
+std::vector<double> QRCodeDimensionsBuffer;
 bool thereIsANewFrame = false;
+QRCodeFrameTimestamps frameTimestamps;
+uint64_t numberOfDroppedCaptures = 0;
+int numberOfConsecutiveDroppedCaptures = 0;
 
 while(true)
 {
 // Capture an OpenCV frame from the camera
 cap >> frame;
+int64_t captureTimestamp = getPoseChannelTimestamp();
+frameTimestamps = QRCodeFrameTimestamps();
+frameTimestamps.captureTimestamp = captureTimestamp;
+
+//The camera didn't deliver a frame, so report it (once per run of empty frames) and try again after a short wait
+if(frame.empty())
+{
+numberOfDroppedCaptures++;
+numberOfConsecutiveDroppedCaptures++;
+if(numberOfConsecutiveDroppedCaptures == 1)
+{
+fprintf(stderr, "Camera did not return a frame (%llu dropped so far)\n", (unsigned long long) numberOfDroppedCaptures);
+}
+
+if(latencyTracer)
+{
+latencyTracer->recordDroppedFrame(captureTimestamp, 0);
+}
+
+if(numberOfConsecutiveDroppedCaptures >= maximumNumberOfConsecutiveDroppedCaptures)
+{
+fprintf(stderr, "Camera returned %d empty frames in a row, giving up.\n", numberOfConsecutiveDroppedCaptures);
+if(latencyTracer)
+{
+SOM_TRY
+latencyTracer->exportChromeTrace(traceFilePath);
+SOM_CATCH("Error writing latency trace\n")
+}
+exit(EXIT_FAILURE);
+}
+
+std::this_thread::sleep_for(std::chrono::milliseconds(droppedCaptureRetryDelayInMilliseconds));
+continue;
+}
+
+if(numberOfConsecutiveDroppedCaptures > 0)
+{
+fprintf(stderr, "Camera recovered after %d empty frames\n", numberOfConsecutiveDroppedCaptures);
+numberOfConsecutiveDroppedCaptures = 0;
+}
 
 //Give the frame to the state estimator and try to get the camera's pose from the QR code image
 SOM_TRY
-thereIsANewFrame = stateEstimator->estimateStateFromBGRFrame(frame, cameraPoseBuffer, QRCodeIdentifierBuffer, QRCodeDimensionBuffer);
+cv::cvtColor(frame, grayscaleFrame, CV_BGR2GRAY);
+thereIsANewFrame = stateEstimator->estimateOneOrMoreStatesFromGrayscaleFrame(grayscaleFrame, cameraPosesBuffer, QRCodeIdentifiersBuffer, QRCodeDimensionsBuffer, &frameTimestamps);
 SOM_CATCH("Error estimating state\n")
 
+if(frameRecorder)
+{
+SOM_TRY
+frameRecorder->recordFrame(grayscaleFrame, captureTimestamp, cameraPosesBuffer, QRCodeIdentifiersBuffer, QRCodeDimensionsBuffer);
+SOM_CATCH("Error recording frame\n")
+}
+
 //Print out values of camera's pose matrix
 if(thereIsANewFrame)
 {
+if(posePublisher)
+{
+for(int i=0; i < cameraPosesBuffer.size(); i++)
+{
+posePublisher->publish(cameraPosesBuffer[i], QRCodeIdentifiersBuffer[i], QRCodeDimensionsBuffer[i], captureTimestamp);
+}
+frameTimestamps.publishTimestamp = getQRCodeTimestamp();
+}
+
 printf("Camera position/orientation matrix:\n");
 for(int row = 0; row < 4; row++)
 {
 
 for(int col = 0; col < 4; col ++)
 {
-printf("%lf ", cameraPoseBuffer.at<double>(row, col));
+printf("%lf ", cameraPosesBuffer[0].at<double>(row, col));
 }
 printf("\n");
 }
 }
 
+if(latencyTracer)
+{
+latencyTracer->recordFrame(frameTimestamps, 0);
+
+//The loop never ends, so rewrite the trace every so often
+if((latencyTracer->getNumberOfFramesRecorded() % traceExportInterval) == 0)
+{
+SOM_TRY
+latencyTracer->exportChromeTrace(traceFilePath);
+SOM_CATCH("Error writing latency trace\n")
+}
+}
 
 } //End of frame processing loop
 
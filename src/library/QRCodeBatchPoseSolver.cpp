@@ -0,0 +1,246 @@
+#include "QRCodeBatchPoseSolver.hpp"
+
+#include<mutex>
+#include<condition_variable>
+#include<atomic>
+#include<functional>
+
+/*
+This function initializes an empty batch.
+@param inputWorkerPool: The pool to split large batches across (NULL to always solve on the calling thread)
+*/
+QRCodeBatchPoseSolver::QRCodeBatchPoseSolver(std::shared_ptr<SOMWorkerPool> inputWorkerPool) : workerPool(inputWorkerPool), numberOfTags(0)
+{
+}
+
+/*
+This function removes all tags from the batch (keeping the memory that was allocated for them).
+*/
+void QRCodeBatchPoseSolver::clear()
+{
+numberOfTags = 0;
+pixelCorners.clear();
+QRCodeDimensions.clear();
+}
+
+/*
+This function makes sure a batch of the given size can be added without allocating memory.
+@param inputNumberOfTags: The number of tags to make room for
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeBatchPoseSolver::reserve(int inputNumberOfTags)
+{
+if(inputNumberOfTags < 0)
+{
+throw SOMException(std::string("Number of tags to reserve is negative\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+pixelCorners.reserve(inputNumberOfTags * 4);
+QRCodeDimensions.reserve(inputNumberOfTags);
+if(normalizedCorners.size() < inputNumberOfTags * 4)
+{
+normalizedCorners.resize(inputNumberOfTags * 4);
+}
+
+if(poseIsValid.size() < inputNumberOfTags)
+{
+for(int i=0; i < 4; i++)
+{
+cornerX[i].resize(inputNumberOfTags);
+cornerY[i].resize(inputNumberOfTags);
+}
+for(int i=0; i < 9; i++)
+{
+cameraRotation[i].resize(inputNumberOfTags);
+}
+for(int i=0; i < 3; i++)
+{
+cameraPosition[i].resize(inputNumberOfTags);
+}
+poseIsValid.resize(inputNumberOfTags);
+}
+}
+
+/*
+This function adds a tag to the batch.
+@param inputCorners: The 4 corners of the QR code in the frame (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@return: The index of the tag in the batch
+
+@exceptions: This function can throw exceptions
+*/
+int QRCodeBatchPoseSolver::addTag(const cv::Point2d *inputCorners, double inputQRCodeDimension)
+{
+if(inputCorners == nullptr || !(inputQRCodeDimension > 0.0))
+{
+throw SOMException(std::string("Invalid tag corners or dimension\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+pixelCorners.insert(pixelCorners.end(), inputCorners, inputCorners + 4);
+QRCodeDimensions.push_back(inputQRCodeDimension);
+numberOfTags++;
+
+return numberOfTags - 1;
+}
+
+/*
+This function returns the number of tags in the batch.
+@return: The number of tags
+*/
+int QRCodeBatchPoseSolver::getNumberOfTags() const
+{
+return numberOfTags;
+}
+
+/*
+This function solves the camera pose for every tag in the batch.
+@param inputCameraMatrix: The 3x3 camera matrix for the frame size
+@param inputDistortionParameters: The 1x5 distortion parameters
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeBatchPoseSolver::solve(const cv::Mat_<double> &inputCameraMatrix, const cv::Mat_<double> &inputDistortionParameters)
+{
+if(numberOfTags == 0)
+{
+return;
+}
+
+SOM_TRY
+reserve(numberOfTags);
+SOM_CATCH("Error making room for batch\n")
+
+//Undistort every corner of every tag in one call (headers wrap the vectors, so undistortPoints writes straight into them)
+cv::Mat pixelCornersMatrix(numberOfTags * 4, 1, CV_64FC2, pixelCorners.data());
+cv::Mat normalizedCornersMatrix(numberOfTags * 4, 1, CV_64FC2, normalizedCorners.data());
+cv::undistortPoints(pixelCornersMatrix, normalizedCornersMatrix, inputCameraMatrix, inputDistortionParameters);
+
+if(normalizedCornersMatrix.data != (uchar *) normalizedCorners.data())
+{
+throw SOMException(std::string("undistortPoints reallocated its output\n"), AN_ASSUMPTION_WAS_VIOLATED_ERROR, __FILE__, __LINE__);
+}
+
+//Scatter into the structure of arrays
+for(int tagIndex = 0; tagIndex < numberOfTags; tagIndex++)
+{
+for(int cornerIndex = 0; cornerIndex < 4; cornerIndex++)
+{
+cornerX[cornerIndex][tagIndex] = normalizedCorners[tagIndex*4 + cornerIndex].x;
+cornerY[cornerIndex][tagIndex] = normalizedCorners[tagIndex*4 + cornerIndex].y;
+}
+}
+
+int numberOfJobs = workerPool == nullptr ? 1 : std::min(workerPool->getNumberOfWorkers(), numberOfTags / QRCodeBatchPoseSolverMinimumTagsPerWorker);
+if(numberOfJobs <= 1)
+{
+solveRange(0, numberOfTags);
+return;
+}
+
+//The pool may be shared with jobs that are themselves waiting (such as a rig's cameras), so the calling thread solves ranges too and only waits for ranges a worker has actually started.  Jobs which start after every range has been claimed return without touching the solver, so the state they share lives on the heap.
+struct sharedRangeState
+{
+std::atomic<int> nextRangeIndex;
+std::mutex rangesMutex;
+std::condition_variable rangesFinishedCondition;
+int numberOfFinishedRanges;
+};
+std::shared_ptr<sharedRangeState> rangeState = std::make_shared<sharedRangeState>();
+rangeState->nextRangeIndex = 0;
+rangeState->numberOfFinishedRanges = 0;
+
+int numberOfRanges = numberOfJobs;
+int totalNumberOfTags = numberOfTags;
+std::function<void()> solveClaimedRanges = [this, rangeState, numberOfRanges, totalNumberOfTags]()
+{
+for(int rangeIndex = rangeState->nextRangeIndex++; rangeIndex < numberOfRanges; rangeIndex = rangeState->nextRangeIndex++)
+{
+solveRange((totalNumberOfTags * rangeIndex) / numberOfRanges, (totalNumberOfTags * (rangeIndex + 1)) / numberOfRanges);
+
+std::lock_guard<std::mutex> lock(rangeState->rangesMutex);
+rangeState->numberOfFinishedRanges++;
+if(rangeState->numberOfFinishedRanges == numberOfRanges)
+{
+rangeState->rangesFinishedCondition.notify_all();
+}
+}
+};
+
+for(int jobIndex = 1; jobIndex < numberOfJobs; jobIndex++)
+{
+workerPool->submit(solveClaimedRanges);
+}
+solveClaimedRanges();
+
+std::unique_lock<std::mutex> lock(rangeState->rangesMutex);
+rangeState->rangesFinishedCondition.wait(lock, [&](){return rangeState->numberOfFinishedRanges == numberOfRanges;});
+}
+
+/*
+This function returns the pose of the camera (OpenCV format) in the coordinate system of one of the tags after solve() has been called.
+@param inputTagIndex: The index returned by addTag
+@param inputCameraPoseBuffer: The buffer to store the 4x4 pose in
+@return: true if the pose was solved and false if the quad was degenerate
+*/
+bool QRCodeBatchPoseSolver::getCameraPose(int inputTagIndex, cv::Matx44d &inputCameraPoseBuffer) const
+{
+if(inputTagIndex < 0 || inputTagIndex >= numberOfTags || !poseIsValid[inputTagIndex])
+{
+return false;
+}
+
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+inputCameraPoseBuffer(row, col) = cameraRotation[row*3 + col][inputTagIndex];
+}
+inputCameraPoseBuffer(row, 3) = cameraPosition[row][inputTagIndex];
+inputCameraPoseBuffer(3, row) = 0.0;
+}
+inputCameraPoseBuffer(3, 3) = 1.0;
+
+return true;
+}
+
+/*
+This function solves the tags in the range [inputFirstTagIndex, inputLastTagIndex).  The corners must already be undistorted.
+@param inputFirstTagIndex: The first tag to solve
+@param inputLastTagIndex: One past the last tag to solve
+*/
+void QRCodeBatchPoseSolver::solveRange(int inputFirstTagIndex, int inputLastTagIndex)
+{
+//Raw pointers so the compiler can see there is no aliasing between the arrays of one iteration
+const double *x0 = cornerX[0].data(), *x1 = cornerX[1].data(), *x2 = cornerX[2].data(), *x3 = cornerX[3].data();
+const double *y0 = cornerY[0].data(), *y1 = cornerY[1].data(), *y2 = cornerY[2].data(), *y3 = cornerY[3].data();
+const double *dimensions = QRCodeDimensions.data();
+double *rotation[9];
+for(int i=0; i < 9; i++)
+{
+rotation[i] = cameraRotation[i].data();
+}
+double *positionX = cameraPosition[0].data(), *positionY = cameraPosition[1].data(), *positionZ = cameraPosition[2].data();
+double *isValid = poseIsValid.data();
+
+//computeHomographyTagPose has no control flow, so once it is inlined this loop vectorizes across tags (the arrays never overlap, which ivdep tells the compiler)
+#pragma GCC ivdep
+for(int i = inputFirstTagIndex; i < inputLastTagIndex; i++)
+{
+const double tagCornerX[4] = {x0[i], x1[i], x2[i], x3[i]};
+const double tagCornerY[4] = {y0[i], y1[i], y2[i], y3[i]};
+double tagRotation[9];
+double tagTranslation[3];
+double validity = computeHomographyTagPose(tagCornerX, tagCornerY, dimensions[i], tagRotation, tagTranslation);
+
+//The camera pose is the inverse of [r1 r2 r3 t], which is [R^T, -R^T t]
+for(int j=0; j < 9; j++)
+{
+rotation[j][i] = tagRotation[j];
+}
+positionX[i] = -(tagRotation[0]*tagTranslation[0] + tagRotation[1]*tagTranslation[1] + tagRotation[2]*tagTranslation[2]);
+positionY[i] = -(tagRotation[3]*tagTranslation[0] + tagRotation[4]*tagTranslation[1] + tagRotation[5]*tagTranslation[2]);
+positionZ[i] = -(tagRotation[6]*tagTranslation[0] + tagRotation[7]*tagTranslation[1] + tagRotation[8]*tagTranslation[2]);
+isValid[i] = validity;
+}
+}
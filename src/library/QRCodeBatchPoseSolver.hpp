@@ -0,0 +1,103 @@
+#ifndef QRCODEBATCHPOSESOLVERHPP
+#define QRCODEBATCHPOSESOLVERHPP
+
+#include<vector>
+#include<memory>
+#include<cmath>
+
+#include "SOMException.hpp"
+#include "SOMWorkerPool.hpp"
+#include "QRCodeHomographyPose.hpp"
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+//Declare handy constants
+static constexpr int QRCodeBatchPoseSolverMinimumTagsPerWorker = 64; //Smaller batches are solved on the calling thread, since a job costs more than solving a few tags
+
+/*
+This class solves the camera poses for many square QR codes seen in the same frame at once.  The corners of every tag are undistorted with a single cv::undistortPoints call and stored as a structure of arrays (one array per corner coordinate), then each pose is found in closed form with computeHomographyTagPose (the same math QRCodePoseCore starts from).  The per tag math is written as selects rather than branches and is built with -fno-math-errno -fno-trapping-math (see the library's CMakeLists.txt), so GCC vectorizes it across tags, and large batches are split across a SOMWorkerPool if one has been given.  The calling thread solves part of the batch itself and only waits for parts a worker has started, so the pool can be shared with jobs that call solve() themselves.
+
+The closed form solution fits all 4 corners with a homography, while solvePnP minimizes the reprojection error of a rigid pose, so the two differ slightly when the corners are noisy.
+*/
+class QRCodeBatchPoseSolver
+{
+public:
+/*
+This function initializes an empty batch.
+@param inputWorkerPool: The pool to split large batches across (NULL to always solve on the calling thread)
+*/
+QRCodeBatchPoseSolver(std::shared_ptr<SOMWorkerPool> inputWorkerPool = nullptr);
+
+/*
+This function removes all tags from the batch (keeping the memory that was allocated for them).
+*/
+void clear();
+
+/*
+This function makes sure a batch of the given size can be added without allocating memory.
+@param inputNumberOfTags: The number of tags to make room for
+
+@exceptions: This function can throw exceptions
+*/
+void reserve(int inputNumberOfTags);
+
+/*
+This function adds a tag to the batch.
+@param inputCorners: The 4 corners of the QR code in the frame (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@return: The index of the tag in the batch
+
+@exceptions: This function can throw exceptions
+*/
+int addTag(const cv::Point2d *inputCorners, double inputQRCodeDimension);
+
+/*
+This function returns the number of tags in the batch.
+@return: The number of tags
+*/
+int getNumberOfTags() const;
+
+/*
+This function solves the camera pose for every tag in the batch.
+@param inputCameraMatrix: The 3x3 camera matrix for the frame size
+@param inputDistortionParameters: The 1x5 distortion parameters
+
+@exceptions: This function can throw exceptions
+*/
+void solve(const cv::Mat_<double> &inputCameraMatrix, const cv::Mat_<double> &inputDistortionParameters);
+
+/*
+This function returns the pose of the camera (OpenCV format) in the coordinate system of one of the tags after solve() has been called.
+@param inputTagIndex: The index returned by addTag
+@param inputCameraPoseBuffer: The buffer to store the 4x4 pose in
+@return: true if the pose was solved and false if the quad was degenerate
+*/
+bool getCameraPose(int inputTagIndex, cv::Matx44d &inputCameraPoseBuffer) const;
+
+std::shared_ptr<SOMWorkerPool> workerPool;
+
+private:
+/*
+This function solves the tags in the range [inputFirstTagIndex, inputLastTagIndex).  The corners must already be undistorted.
+@param inputFirstTagIndex: The first tag to solve
+@param inputLastTagIndex: One past the last tag to solve
+*/
+void solveRange(int inputFirstTagIndex, int inputLastTagIndex);
+
+int numberOfTags;
+std::vector<cv::Point2d> pixelCorners; //4 per tag, the input of undistortPoints
+std::vector<cv::Point2d> normalizedCorners; //4 per tag, the output of undistortPoints
+std::vector<double> QRCodeDimensions;
+
+//Structure of arrays with the normalized corners
+std::vector<double> cornerX[4];
+std::vector<double> cornerY[4];
+
+//Structure of arrays with the results (the camera pose rotation is row major, 9 arrays)
+std::vector<double> cameraRotation[9];
+std::vector<double> cameraPosition[3];
+std::vector<double> poseIsValid; //1.0 or 0.0, kept as doubles so solveRange vectorizes
+};
+
+#endif
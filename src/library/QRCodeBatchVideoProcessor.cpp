@@ -0,0 +1,350 @@
+#include "QRCodeBatchVideoProcessor.hpp"
+
+#include<chrono>
+#include<cstring>
+#include<cmath>
+
+/*
+This function initializes the processor with its own worker pool.
+@param inputCameraCalibration: The calibration of the camera that recorded the videos
+@param inputNumberOfWorkers: How many threads to decode and estimate with (0 means one per hardware thread)
+@param inputNumberOfFramesPerChunk: How many consecutive frames each job decodes
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeBatchVideoProcessor::QRCodeBatchVideoProcessor(const QRCodeCameraCalibration &inputCameraCalibration, int inputNumberOfWorkers, int inputNumberOfFramesPerChunk) : cameraCalibration(inputCameraCalibration), numberOfFramesPerChunk(inputNumberOfFramesPerChunk)
+{
+if(inputNumberOfFramesPerChunk <= 0)
+{
+throw SOMException(std::string("Number of frames per chunk must be positive\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+SOM_TRY
+workerPool.reset(new SOMWorkerPool(inputNumberOfWorkers));
+SOM_CATCH("Error creating worker pool for batch video processor\n")
+}
+
+/*
+This function initializes the processor so that it runs its chunks on a worker pool that is shared with other users.
+@param inputCameraCalibration: The calibration of the camera that recorded the videos
+@param inputWorkerPool: The pool to run the chunk jobs on
+@param inputNumberOfFramesPerChunk: How many consecutive frames each job decodes
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeBatchVideoProcessor::QRCodeBatchVideoProcessor(const QRCodeCameraCalibration &inputCameraCalibration, const std::shared_ptr<SOMWorkerPool> &inputWorkerPool, int inputNumberOfFramesPerChunk) : cameraCalibration(inputCameraCalibration), numberOfFramesPerChunk(inputNumberOfFramesPerChunk)
+{
+if(!inputWorkerPool)
+{
+throw SOMException(std::string("Worker pool is NULL\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(inputNumberOfFramesPerChunk <= 0)
+{
+throw SOMException(std::string("Number of frames per chunk must be positive\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+workerPool = inputWorkerPool;
+}
+
+/*
+This function estimates the poses in every frame of a video and writes them to the log in frame order.  It returns once the whole video has been written.
+@param inputVideoPath: The video file to process
+@param inputPoseLog: The log to write the poses to
+@param inputProgressCallback: A function to call (from this thread) after each chunk is written, or nullptr
+
+@return: A summary of the video
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeBatchVideoSummary QRCodeBatchVideoProcessor::processVideo(const std::string &inputVideoPath, QRCodePoseLogWriter &inputPoseLog, std::function<void(const QRCodeBatchVideoProgress &)> inputProgressCallback)
+{
+std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+//Only the length and frame rate are needed here, each chunk opens the video itself
+int64_t totalNumberOfFrames = -1;
+double framesPerSecond = 0.0;
+{
+cv::VideoCapture video(inputVideoPath);
+if(!video.isOpened())
+{
+throw SOMException(std::string("Unable to open video ") + inputVideoPath + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+double reportedNumberOfFrames = video.get(CV_CAP_PROP_FRAME_COUNT);
+if(reportedNumberOfFrames >= 1.0)
+{
+totalNumberOfFrames = (int64_t) reportedNumberOfFrames;
+}
+framesPerSecond = std::max(video.get(CV_CAP_PROP_FPS), 0.0);
+}
+
+int64_t numberOfChunks = 1;
+if(totalNumberOfFrames > 0)
+{
+numberOfChunks = (totalNumberOfFrames + numberOfFramesPerChunk - 1) / numberOfFramesPerChunk;
+}
+
+std::vector<std::unique_ptr<chunkResult> > chunks(numberOfChunks);
+int64_t numberOfChunksInFlight = 0;
+int64_t maximumNumberOfChunksInFlight = QRCodeBatchChunksInFlightPerWorker * workerPool->getNumberOfWorkers();
+
+//The jobs write to the chunks, so don't let them go out of scope (such as on an exception) until every job has finished
+SOMScopeGuard inFlightChunksGuard([&]()
+{
+std::unique_lock<std::mutex> lock(chunksMutex);
+chunkFinishedCondition.wait(lock, [&](){return numberOfChunksInFlight == 0;});
+});
+
+QRCodeBatchVideoSummary summary;
+memset(&summary, 0, sizeof(summary));
+int64_t nextChunkToSubmit = 0;
+int64_t nextFrameIndexToWrite = 0;
+for(int64_t nextChunkToWrite = 0; nextChunkToWrite < numberOfChunks; nextChunkToWrite++)
+{
+//Keep every worker busy, with a bounded number of results waiting to be written
+for(; nextChunkToSubmit < numberOfChunks && nextChunkToSubmit - nextChunkToWrite < maximumNumberOfChunksInFlight; nextChunkToSubmit++)
+{
+chunks[nextChunkToSubmit].reset(new chunkResult());
+chunks[nextChunkToSubmit]->isFinished = false;
+chunkResult *chunk = chunks[nextChunkToSubmit].get();
+int64_t firstFrameIndex = nextChunkToSubmit * numberOfFramesPerChunk;
+int64_t numberOfFramesInChunk = totalNumberOfFrames > 0 ? std::min<int64_t>(numberOfFramesPerChunk, totalNumberOfFrames - firstFrameIndex) : -1;
+
+{
+std::lock_guard<std::mutex> lock(chunksMutex);
+numberOfChunksInFlight++;
+}
+SOMScopeGuard submitGuard([&]()
+{
+std::lock_guard<std::mutex> lock(chunksMutex);
+numberOfChunksInFlight--;
+});
+
+SOM_TRY
+workerPool->submit([this, &inputVideoPath, &numberOfChunksInFlight, chunk, firstFrameIndex, numberOfFramesInChunk, framesPerSecond]()
+{
+processChunk(inputVideoPath, firstFrameIndex, numberOfFramesInChunk, framesPerSecond, *chunk);
+
+std::lock_guard<std::mutex> lock(chunksMutex);
+chunk->isFinished = true;
+numberOfChunksInFlight--;
+chunkFinishedCondition.notify_all();
+});
+SOM_CATCH("Error submitting video chunk\n")
+submitGuard.dismiss();
+}
+
+chunkResult &chunk = *chunks[nextChunkToWrite];
+{
+std::unique_lock<std::mutex> lock(chunksMutex);
+chunkFinishedCondition.wait(lock, [&](){return chunk.isFinished;});
+}
+
+if(chunk.exception)
+{
+SOM_TRY
+std::rethrow_exception(chunk.exception);
+SOM_CATCH("Error processing video chunk starting at frame " + std::to_string(nextChunkToWrite * numberOfFramesPerChunk) + "\n")
+}
+
+//Each chunk has to start where the one before it ended, so every frame is logged exactly once
+if(chunk.firstFrameIndex != nextFrameIndexToWrite || chunk.endFrameIndex < chunk.firstFrameIndex)
+{
+throw SOMException(std::string("Video chunk covers frames ") + std::to_string(chunk.firstFrameIndex) + " to " + std::to_string(chunk.endFrameIndex) + " but frame " + std::to_string(nextFrameIndexToWrite) + " was expected next\n", AN_ASSUMPTION_WAS_VIOLATED_ERROR, __FILE__, __LINE__);
+}
+nextFrameIndexToWrite = chunk.endFrameIndex;
+
+SOM_TRY
+for(size_t i=0; i < chunk.detections.size(); i++)
+{
+inputPoseLog.writePose(chunk.detectionFrameIndices[i], chunk.detectionFrameTimes[i], chunk.detections[i]);
+}
+SOM_CATCH("Error writing poses to log\n")
+
+summary.numberOfFrames += chunk.numberOfFrames;
+summary.numberOfFramesWithPoses += chunk.numberOfFramesWithPoses;
+summary.numberOfPoses += chunk.detections.size();
+summary.numberOfUnreadableFrames += chunk.numberOfUnreadableFrames;
+summary.numberOfFramesWithErrors += chunk.numberOfFramesWithErrors;
+chunks[nextChunkToWrite].reset();
+
+summary.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+summary.framesPerSecond = summary.elapsedSeconds > 0.0 ? summary.numberOfFrames / summary.elapsedSeconds : 0.0;
+
+if(inputProgressCallback)
+{
+QRCodeBatchVideoProgress progress;
+progress.numberOfFramesProcessed = summary.numberOfFrames + summary.numberOfUnreadableFrames;
+progress.totalNumberOfFrames = totalNumberOfFrames;
+progress.numberOfPoses = summary.numberOfPoses;
+progress.elapsedSeconds = summary.elapsedSeconds;
+progress.framesPerSecond = summary.framesPerSecond;
+inputProgressCallback(progress);
+}
+}
+
+if(totalNumberOfFrames > 0 && nextFrameIndexToWrite != totalNumberOfFrames)
+{
+throw SOMException(std::string("Video chunks covered ") + std::to_string(nextFrameIndexToWrite) + " of " + std::to_string(totalNumberOfFrames) + " frames\n", AN_ASSUMPTION_WAS_VIOLATED_ERROR, __FILE__, __LINE__);
+}
+
+return summary;
+}
+
+/*
+This function decodes and estimates one chunk.  It is run by the workers and stores any exception in the chunk rather than throwing it.
+@param inputVideoPath: The video file to process
+@param inputFirstFrameIndex: The first frame of the chunk
+@param inputNumberOfFrames: How many frames are in the chunk (-1 means until the end of the video)
+@param inputFramesPerSecond: The frame rate of the video (0 if unknown)
+@param inputChunkResult: The chunk to store the results in
+*/
+void QRCodeBatchVideoProcessor::processChunk(const std::string &inputVideoPath, int64_t inputFirstFrameIndex, int64_t inputNumberOfFrames, double inputFramesPerSecond, chunkResult &inputChunkResult)
+{
+inputChunkResult.numberOfFrames = 0;
+inputChunkResult.numberOfFramesWithPoses = 0;
+inputChunkResult.numberOfUnreadableFrames = 0;
+inputChunkResult.numberOfFramesWithErrors = 0;
+inputChunkResult.firstFrameIndex = inputFirstFrameIndex;
+inputChunkResult.endFrameIndex = inputFirstFrameIndex;
+
+try
+{
+std::unique_ptr<QRCodeStateEstimator> estimator = acquireEstimator();
+QRCodeStateEstimator *estimatorPointer = estimator.get();
+SOMScopeGuard estimatorGuard([&](){releaseEstimator(std::move(estimator));});
+
+cv::VideoCapture video(inputVideoPath);
+if(!video.isOpened())
+{
+throw SOMException(std::string("Unable to open video ") + inputVideoPath + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+if(inputFirstFrameIndex > 0)
+{
+if(!video.set(CV_CAP_PROP_POS_FRAMES, (double) inputFirstFrameIndex))
+{
+throw SOMException(std::string("Unable to seek to frame ") + std::to_string(inputFirstFrameIndex) + " of " + inputVideoPath + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+//Many backends land on the keyframe before the frame that was asked for, so decode forward from wherever the seek ended up
+int64_t landedFrameIndex = llround(video.get(CV_CAP_PROP_POS_FRAMES));
+for(int64_t frameIndex = std::max<int64_t>(landedFrameIndex, 0); frameIndex < inputFirstFrameIndex; frameIndex++)
+{
+if(!video.grab())
+{
+throw SOMException(std::string("Unable to decode forward to frame ") + std::to_string(inputFirstFrameIndex) + " of " + inputVideoPath + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+//Labeling frames from a position the decoder doesn't confirm would silently shift the log
+int64_t startFrameIndex = llround(video.get(CV_CAP_PROP_POS_FRAMES));
+if(startFrameIndex != inputFirstFrameIndex)
+{
+throw SOMException(std::string("Seeking to frame ") + std::to_string(inputFirstFrameIndex) + " of " + inputVideoPath + " ended up at frame " + std::to_string(startFrameIndex) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+cv::Mat frame;
+QRCodeDetection detections[QRCodeMaximumDetectionsPerFrame];
+bool allFramesWereRead = true;
+for(int64_t frameIndex = inputFirstFrameIndex; inputNumberOfFrames < 0 || frameIndex < inputFirstFrameIndex + inputNumberOfFrames; frameIndex++)
+{
+if(!video.read(frame) || frame.empty())
+{
+if(inputNumberOfFrames >= 0)
+{
+//The container promised more frames than could be decoded (often a truncated recording)
+inputChunkResult.numberOfUnreadableFrames += inputFirstFrameIndex + inputNumberOfFrames - frameIndex;
+}
+allFramesWereRead = false;
+break;
+}
+inputChunkResult.numberOfFrames++;
+
+//Use the nominal frame rate so the times don't depend on how the decoder reports positions after a seek
+double frameTime = inputFramesPerSecond > 0.0 ? frameIndex / inputFramesPerSecond : video.get(CV_CAP_PROP_POS_MSEC) / 1000.0;
+
+int numberOfDetections = 0;
+QRCodeEstimationStatus status = estimatorPointer->tryEstimateStatesFromBGRFrame(frame, detections, QRCodeMaximumDetectionsPerFrame, numberOfDetections);
+if(status == QRCODE_STATUS_NO_QR_CODES)
+{
+continue;
+}
+if(status != QRCODE_STATUS_OK)
+{
+inputChunkResult.numberOfFramesWithErrors++;
+continue;
+}
+
+inputChunkResult.numberOfFramesWithPoses++;
+for(int i=0; i < numberOfDetections; i++)
+{
+inputChunkResult.detections.push_back(detections[i]);
+inputChunkResult.detectionFrameIndices.push_back(frameIndex);
+inputChunkResult.detectionFrameTimes.push_back(frameTime);
+}
+}
+
+inputChunkResult.endFrameIndex = inputFirstFrameIndex + inputChunkResult.numberOfFrames + inputChunkResult.numberOfUnreadableFrames;
+
+//A decoder that skipped or repeated frames would leave the next chunk's first frame unaccounted for or counted twice
+if(allFramesWereRead && inputNumberOfFrames >= 0)
+{
+int64_t decoderFrameIndex = llround(video.get(CV_CAP_PROP_POS_FRAMES));
+if(decoderFrameIndex != inputChunkResult.endFrameIndex)
+{
+throw SOMException(std::string("Decoder reported frame ") + std::to_string(decoderFrameIndex) + " at the end of the chunk starting at frame " + std::to_string(inputFirstFrameIndex) + " of " + inputVideoPath + " instead of frame " + std::to_string(inputChunkResult.endFrameIndex) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+}
+catch(...)
+{
+inputChunkResult.exception = std::current_exception();
+}
+}
+
+/*
+This function takes an idle estimator, making a new one if there aren't any.
+@return: The estimator, to be given back with releaseEstimator
+
+@exceptions: This function can throw exceptions
+*/
+std::unique_ptr<QRCodeStateEstimator> QRCodeBatchVideoProcessor::acquireEstimator()
+{
+{
+std::lock_guard<std::mutex> lock(estimatorsMutex);
+if(idleEstimators.size() > 0)
+{
+std::unique_ptr<QRCodeStateEstimator> estimator = std::move(idleEstimators.back());
+idleEstimators.pop_back();
+return estimator;
+}
+}
+
+//Made by the worker that will use it, so its buffers are local to that worker
+std::unique_ptr<QRCodeStateEstimator> estimator;
+SOM_TRY
+estimator.reset(new QRCodeStateEstimator(cameraCalibration, false));
+SOM_CATCH("Error creating estimator for batch video processor\n")
+
+return estimator;
+}
+
+/*
+This function gives an estimator back so that later chunks can reuse it.  It is called from scope guards, so it does not throw.
+@param inputEstimator: The estimator to give back
+*/
+void QRCodeBatchVideoProcessor::releaseEstimator(std::unique_ptr<QRCodeStateEstimator> inputEstimator) noexcept
+{
+try
+{
+std::lock_guard<std::mutex> lock(estimatorsMutex);
+idleEstimators.push_back(std::move(inputEstimator));
+}
+catch(const std::exception &inputException)
+{
+//Out of memory, so let the estimator be deleted and a new one be made next time
+}
+}
@@ -0,0 +1,146 @@
+#ifndef QRCODEBATCHVIDEOPROCESSORHPP
+#define QRCODEBATCHVIDEOPROCESSORHPP
+
+#include<string>
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<exception>
+#include<cstdint>
+
+#include "SOMException.hpp"
+#include "SOMScopeGuard.hpp"
+#include "SOMWorkerPool.hpp"
+#include "QRCodeCameraCalibration.hpp"
+#include "QRCodeStateEstimator.hpp"
+#include "QRCodePoseLog.hpp"
+
+//Declare handy constants
+static constexpr int QRCodeBatchDefaultNumberOfFramesPerChunk = 300; //Big enough that seeking is a small part of a chunk's work
+static constexpr int QRCodeBatchChunksInFlightPerWorker = 2; //Chunks queued or running per worker, which bounds the memory used by unwritten results
+
+/*
+This struct is given to the progress callback after each chunk is written to the log.
+*/
+struct QRCodeBatchVideoProgress
+{
+int64_t numberOfFramesProcessed;
+int64_t totalNumberOfFrames; //-1 if the video does not say how many frames it has
+int64_t numberOfPoses; //Poses written to the log so far
+double elapsedSeconds;
+double framesPerSecond; //Average throughput so far
+};
+
+/*
+This struct summarizes a finished video.
+*/
+struct QRCodeBatchVideoSummary
+{
+int64_t numberOfFrames; //Frames which were decoded
+int64_t numberOfFramesWithPoses;
+int64_t numberOfPoses;
+int64_t numberOfUnreadableFrames; //Frames the video said it had but which could not be decoded
+int64_t numberOfFramesWithErrors; //Frames the estimator rejected (such as an unsupported size)
+double elapsedSeconds;
+double framesPerSecond;
+};
+
+/*
+This class estimates the poses in every frame of a recorded video as fast as the machine allows.  The video is split into chunks of consecutive frames, and each chunk is decoded (with its own cv::VideoCapture) and estimated by a worker with an estimator of its own.  Finished chunks are written to a QRCodePoseLogWriter in frame order by the thread that called processVideo, so the log is the same no matter how many workers are used.
+
+Seeks are checked against the position the decoder reports (decoding forward from the keyframe many backends land on), and the frames each chunk accounts for are checked to follow on from the chunk before, so an inexact seek fails the video rather than shifting the log.  Estimators are reused between chunks, but each chunk starts with a seek, so anything an estimator carries from frame to frame (such as its adaptive scan density) restarts at chunk boundaries.  Videos which do not report their frame count are processed as one chunk.
+*/
+class QRCodeBatchVideoProcessor
+{
+public:
+/*
+This function initializes the processor with its own worker pool.
+@param inputCameraCalibration: The calibration of the camera that recorded the videos
+@param inputNumberOfWorkers: How many threads to decode and estimate with (0 means one per hardware thread)
+@param inputNumberOfFramesPerChunk: How many consecutive frames each job decodes
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeBatchVideoProcessor(const QRCodeCameraCalibration &inputCameraCalibration, int inputNumberOfWorkers = 0, int inputNumberOfFramesPerChunk = QRCodeBatchDefaultNumberOfFramesPerChunk);
+
+/*
+This function initializes the processor so that it runs its chunks on a worker pool that is shared with other users.
+@param inputCameraCalibration: The calibration of the camera that recorded the videos
+@param inputWorkerPool: The pool to run the chunk jobs on
+@param inputNumberOfFramesPerChunk: How many consecutive frames each job decodes
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeBatchVideoProcessor(const QRCodeCameraCalibration &inputCameraCalibration, const std::shared_ptr<SOMWorkerPool> &inputWorkerPool, int inputNumberOfFramesPerChunk = QRCodeBatchDefaultNumberOfFramesPerChunk);
+
+/*
+This function estimates the poses in every frame of a video and writes them to the log in frame order.  It returns once the whole video has been written.
+@param inputVideoPath: The video file to process
+@param inputPoseLog: The log to write the poses to
+@param inputProgressCallback: A function to call (from this thread) after each chunk is written, or nullptr
+
+@return: A summary of the video
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeBatchVideoSummary processVideo(const std::string &inputVideoPath, QRCodePoseLogWriter &inputPoseLog, std::function<void(const QRCodeBatchVideoProgress &)> inputProgressCallback = nullptr);
+
+private:
+QRCodeBatchVideoProcessor(const QRCodeBatchVideoProcessor &inputQRCodeBatchVideoProcessor) = delete; //Disable copying of the object
+
+/*
+This struct holds the results of one chunk until it is written.
+*/
+struct chunkResult
+{
+std::vector<QRCodeDetection> detections;
+std::vector<int64_t> detectionFrameIndices; //Frame each detection came from
+std::vector<double> detectionFrameTimes;
+int64_t numberOfFrames;
+int64_t numberOfFramesWithPoses;
+int64_t numberOfUnreadableFrames;
+int64_t numberOfFramesWithErrors;
+int64_t firstFrameIndex; //The frame the decoder confirmed the chunk started at
+int64_t endFrameIndex; //One past the last frame the chunk accounted for (decoded or unreadable)
+bool isFinished;
+std::exception_ptr exception;
+};
+
+/*
+This function decodes and estimates one chunk.  It is run by the workers and stores any exception in the chunk rather than throwing it.
+@param inputVideoPath: The video file to process
+@param inputFirstFrameIndex: The first frame of the chunk
+@param inputNumberOfFrames: How many frames are in the chunk (-1 means until the end of the video)
+@param inputFramesPerSecond: The frame rate of the video (0 if unknown)
+@param inputChunkResult: The chunk to store the results in
+*/
+void processChunk(const std::string &inputVideoPath, int64_t inputFirstFrameIndex, int64_t inputNumberOfFrames, double inputFramesPerSecond, chunkResult &inputChunkResult);
+
+/*
+This function takes an idle estimator, making a new one if there aren't any.
+@return: The estimator, to be given back with releaseEstimator
+
+@exceptions: This function can throw exceptions
+*/
+std::unique_ptr<QRCodeStateEstimator> acquireEstimator();
+
+/*
+This function gives an estimator back so that later chunks can reuse it.  It is called from scope guards, so it does not throw.
+@param inputEstimator: The estimator to give back
+*/
+void releaseEstimator(std::unique_ptr<QRCodeStateEstimator> inputEstimator) noexcept;
+
+QRCodeCameraCalibration cameraCalibration;
+std::shared_ptr<SOMWorkerPool> workerPool;
+int numberOfFramesPerChunk;
+
+std::mutex estimatorsMutex;
+std::vector<std::unique_ptr<QRCodeStateEstimator> > idleEstimators; //At most one per worker is ever made
+
+std::mutex chunksMutex;
+std::condition_variable chunkFinishedCondition;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "QRCodeCameraCalibration.hpp"
+
+#include<cstdio>
+#include<cstddef>
+#include<cstring>
+#include<cerrno>
+#include<sys/stat.h>
+#include<unistd.h>
+
+/*
+This function reads the first of two alternative names for a node (the OpenCV calibration samples have used both capitalizations).
+@param inputFileStorage: The opened calibration file
+@param inputName: The preferred node name
+@param inputAlternativeName: The name to try if the first is missing
+@return: The node (empty if neither exists)
+*/
+static cv::FileNode getCalibrationNode(const cv::FileStorage &inputFileStorage, const std::string &inputName, const std::string &inputAlternativeName)
+{
+cv::FileNode node = inputFileStorage[inputName];
+if(node.empty())
+{
+node = inputFileStorage[inputAlternativeName];
+}
+return node;
+}
+
+/*
+This function parses an OpenCV XML/YAML calibration file.
+@param inputCalibrationFilePath: The XML/YAML calibration file
+@param inputCalibrationBuffer: The buffer to store the calibration in
+
+@exceptions: This function can throw exceptions
+*/
+static void parseCameraCalibrationFile(const std::string &inputCalibrationFilePath, QRCodeCameraCalibration &inputCalibrationBuffer)
+{
+cv::FileStorage calibrationFile(inputCalibrationFilePath, cv::FileStorage::READ);
+if(!calibrationFile.isOpened())
+{
+throw SOMException(std::string("Unable to open calibration file ") + inputCalibrationFilePath + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+cv::FileNode widthNode = getCalibrationNode(calibrationFile, "image_Width", "image_width");
+cv::FileNode heightNode = getCalibrationNode(calibrationFile, "image_Height", "image_height");
+cv::FileNode cameraMatrixNode = getCalibrationNode(calibrationFile, "Camera_Matrix", "camera_matrix");
+cv::FileNode distortionNode = getCalibrationNode(calibrationFile, "Distortion_Coefficients", "distortion_coefficients");
+if(widthNode.empty() || heightNode.empty() || cameraMatrixNode.empty() || distortionNode.empty())
+{
+throw SOMException(std::string("Calibration file is missing the image size, camera matrix or distortion coefficients\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+cv::Mat cameraMatrix;
+cv::Mat distortionParameters;
+inputCalibrationBuffer.imageWidth = (int) widthNode;
+inputCalibrationBuffer.imageHeight = (int) heightNode;
+cameraMatrixNode >> cameraMatrix;
+distortionNode >> distortionParameters;
+
+if(cameraMatrix.rows != 3 || cameraMatrix.cols != 3)
+{
+throw SOMException(std::string("Calibration file camera matrix is not 3x3\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//The calibration program writes a 5x1 column, the estimator wants a 1x5 row (4 coefficients means k3 was not estimated)
+if(distortionParameters.total() != 4 && distortionParameters.total() != 5)
+{
+throw SOMException(std::string("Calibration file must have 4 or 5 distortion coefficients\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+cv::Mat_<double> doubleCameraMatrix;
+cv::Mat_<double> doubleDistortionParameters;
+cameraMatrix.convertTo(doubleCameraMatrix, CV_64F);
+distortionParameters.reshape(1, 1).convertTo(doubleDistortionParameters, CV_64F);
+
+inputCalibrationBuffer.cameraMatrix = doubleCameraMatrix;
+inputCalibrationBuffer.distortionParameters = cv::Mat_<double>::zeros(1, 5);
+for(int i=0; i < doubleDistortionParameters.cols; i++)
+{
+inputCalibrationBuffer.distortionParameters.at<double>(0, i) = doubleDistortionParameters.at<double>(0, i);
+}
+
+if(inputCalibrationBuffer.imageWidth <= 0 || inputCalibrationBuffer.imageHeight <= 0)
+{
+throw SOMException(std::string("Calibration file image dimensions invalid\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+}
+
+/*
+This function tries to load a calibration from its binary cache.
+@param inputCachePath: The cache file
+@param inputSourceFileStatus: The stat() of the calibration file the cache should have been made from
+@param inputCalibrationBuffer: The buffer to store the calibration in
+@return: true if the cache exists, matches the calibration file and is intact
+*/
+static bool readCalibrationCache(const std::string &inputCachePath, const struct stat &inputSourceFileStatus, QRCodeCameraCalibration &inputCalibrationBuffer)
+{
+FILE *cacheFile = fopen(inputCachePath.c_str(), "rb");
+if(cacheFile == NULL)
+{
+return false;
+}
+SOMScopeGuard cacheFileGuard([&](){fclose(cacheFile);});
+
+QRCodeCalibrationCacheFile cache;
+if(fread(&cache, sizeof(cache), 1, cacheFile) != 1)
+{
+return false;
+}
+
+int64_t sourceModificationTime = ((int64_t) inputSourceFileStatus.st_mtim.tv_sec) * 1000000000LL + inputSourceFileStatus.st_mtim.tv_nsec;
+if(cache.magicNumber != QRCodeCalibrationCacheMagicNumber || cache.version != QRCodeCalibrationCacheVersion || cache.sourceFileSize != (uint64_t) inputSourceFileStatus.st_size || cache.sourceModificationTime != sourceModificationTime || cache.checksum != hashQRCodeIdentifier(reinterpret_cast<const char *>(&cache), offsetof(QRCodeCalibrationCacheFile, checksum)))
+{
+return false;
+}
+
+if(cache.imageWidth <= 0 || cache.imageHeight <= 0)
+{
+return false;
+}
+
+inputCalibrationBuffer.imageWidth = cache.imageWidth;
+inputCalibrationBuffer.imageHeight = cache.imageHeight;
+inputCalibrationBuffer.cameraMatrix = cv::Mat_<double>(3, 3);
+inputCalibrationBuffer.distortionParameters = cv::Mat_<double>(1, 5);
+for(int i=0; i < 9; i++)
+{
+inputCalibrationBuffer.cameraMatrix.at<double>(i / 3, i % 3) = cache.cameraMatrix[i];
+}
+for(int i=0; i < 5; i++)
+{
+inputCalibrationBuffer.distortionParameters.at<double>(0, i) = cache.distortionParameters[i];
+}
+
+return true;
+}
+
+/*
+This function writes the binary cache for a calibration.  It writes to a temporary file and renames it, so a reader never sees a partial cache.
+@param inputCachePath: The cache file
+@param inputSourceFileStatus: The stat() of the calibration file the calibration was parsed from
+@param inputCalibration: The calibration to store
+@return: true if the cache was written
+*/
+static bool writeCalibrationCache(const std::string &inputCachePath, const struct stat &inputSourceFileStatus, const QRCodeCameraCalibration &inputCalibration)
+{
+QRCodeCalibrationCacheFile cache;
+memset(&cache, 0, sizeof(cache));
+cache.magicNumber = QRCodeCalibrationCacheMagicNumber;
+cache.version = QRCodeCalibrationCacheVersion;
+cache.sourceFileSize = inputSourceFileStatus.st_size;
+cache.sourceModificationTime = ((int64_t) inputSourceFileStatus.st_mtim.tv_sec) * 1000000000LL + inputSourceFileStatus.st_mtim.tv_nsec;
+cache.imageWidth = inputCalibration.imageWidth;
+cache.imageHeight = inputCalibration.imageHeight;
+for(int i=0; i < 9; i++)
+{
+cache.cameraMatrix[i] = inputCalibration.cameraMatrix.at<double>(i / 3, i % 3);
+}
+for(int i=0; i < 5; i++)
+{
+cache.distortionParameters[i] = inputCalibration.distortionParameters.at<double>(0, i);
+}
+cache.checksum = hashQRCodeIdentifier(reinterpret_cast<const char *>(&cache), offsetof(QRCodeCalibrationCacheFile, checksum));
+
+std::string temporaryPath = inputCachePath + "." + std::to_string(getpid());
+FILE *cacheFile = fopen(temporaryPath.c_str(), "wb");
+if(cacheFile == NULL)
+{
+return false;
+}
+
+bool writeSucceeded = fwrite(&cache, sizeof(cache), 1, cacheFile) == 1;
+writeSucceeded = (fclose(cacheFile) == 0) && writeSucceeded;
+
+if(!writeSucceeded || rename(temporaryPath.c_str(), inputCachePath.c_str()) != 0)
+{
+unlink(temporaryPath.c_str());
+return false;
+}
+
+return true;
+}
+
+/*
+This function loads a camera calibration in the format written by the OpenCV camera calibration tutorial program (XML or YAML with image_Width, image_Height, Camera_Matrix and Distortion_Coefficients entries).  Parsing the XML/YAML is slow on small boards, so if inputUseBinaryCache is true the result is also written to a small binary file next to the calibration file (calibration path + ".qrcache") and later calls load that instead, as long as the calibration file has not changed since.  Failing to write the cache (such as on a read only file system) is not an error.
+@param inputCalibrationFilePath: The XML/YAML calibration file
+@param inputCalibrationBuffer: The buffer to store the calibration in
+@param inputUseBinaryCache: True if the binary cache should be used/created
+@return: true if the calibration came from the binary cache and false if the XML/YAML file was parsed
+
+@exceptions: This function can throw exceptions
+*/
+bool loadCameraCalibration(const std::string &inputCalibrationFilePath, QRCodeCameraCalibration &inputCalibrationBuffer, bool inputUseBinaryCache)
+{
+struct stat sourceFileStatus;
+if(stat(inputCalibrationFilePath.c_str(), &sourceFileStatus) != 0)
+{
+throw SOMException(std::string("Unable to find calibration file ") + inputCalibrationFilePath + ": " + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+std::string cachePath = inputCalibrationFilePath + QRCodeCalibrationCacheExtension;
+if(inputUseBinaryCache && readCalibrationCache(cachePath, sourceFileStatus, inputCalibrationBuffer))
+{
+return true;
+}
+
+SOM_TRY
+parseCameraCalibrationFile(inputCalibrationFilePath, inputCalibrationBuffer);
+SOM_CATCH("Error parsing calibration file\n")
+
+if(inputUseBinaryCache)
+{
+writeCalibrationCache(cachePath, sourceFileStatus, inputCalibrationBuffer);
+}
+
+return false;
+}
@@ -0,0 +1,55 @@
+#ifndef QRCODECAMERACALIBRATIONHPP
+#define QRCODECAMERACALIBRATIONHPP
+
+#include<string>
+#include<cstdint>
+
+#include "SOMException.hpp"
+#include "SOMScopeGuard.hpp"
+#include "QRCodeIdentifierHash.hpp"
+#include <opencv2/core/core.hpp>
+
+//Declare handy constants
+static const uint32_t QRCodeCalibrationCacheMagicNumber = 0x43435251; //"QRCC"
+static const uint32_t QRCodeCalibrationCacheVersion = 1;
+static const std::string QRCodeCalibrationCacheExtension = ".qrcache";
+
+/*
+This struct holds everything the state estimator needs to know about a camera.
+*/
+struct QRCodeCameraCalibration
+{
+int imageWidth; //The width of camera images used in the camera calibration
+int imageHeight; //The height of camera images used in the camera calibration
+cv::Mat_<double> cameraMatrix; //3x3 matrix
+cv::Mat_<double> distortionParameters; //1x5 matrix (k1, k2, p1, p2, k3)
+};
+
+/*
+This struct is the binary cache file written next to a calibration file.  It records the size and modification time of the file it was made from, so it is ignored as soon as the calibration file changes, and it ends with a hash of everything before it to catch truncated or corrupt caches.
+*/
+struct QRCodeCalibrationCacheFile
+{
+uint32_t magicNumber;
+uint32_t version;
+uint64_t sourceFileSize;
+int64_t sourceModificationTime; //Nanoseconds since the epoch
+int32_t imageWidth;
+int32_t imageHeight;
+double cameraMatrix[9]; //Row major
+double distortionParameters[5];
+uint64_t checksum; //hashQRCodeIdentifier() of all of the bytes before this field
+};
+
+/*
+This function loads a camera calibration in the format written by the OpenCV camera calibration tutorial program (XML or YAML with image_Width, image_Height, Camera_Matrix and Distortion_Coefficients entries).  Parsing the XML/YAML is slow on small boards, so if inputUseBinaryCache is true the result is also written to a small binary file next to the calibration file (calibration path + ".qrcache") and later calls load that instead, as long as the calibration file has not changed since.  Failing to write the cache (such as on a read only file system) is not an error.
+@param inputCalibrationFilePath: The XML/YAML calibration file
+@param inputCalibrationBuffer: The buffer to store the calibration in
+@param inputUseBinaryCache: True if the binary cache should be used/created
+@return: true if the calibration came from the binary cache and false if the XML/YAML file was parsed
+
+@exceptions: This function can throw exceptions
+*/
+bool loadCameraCalibration(const std::string &inputCalibrationFilePath, QRCodeCameraCalibration &inputCalibrationBuffer, bool inputUseBinaryCache = true);
+
+#endif
@@ -0,0 +1,416 @@
+#include "QRCodeCameraRig.hpp"
+
+/*
+This function initializes the rig with its own worker pool.
+@param inputNumberOfWorkers: How many worker threads to use (0 means one per hardware thread)
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeCameraRig::QRCodeCameraRig(int inputNumberOfWorkers) : camerasArePinnedToWorkers(false)
+{
+SOM_TRY
+workerPool.reset(new SOMWorkerPool(inputNumberOfWorkers));
+SOM_CATCH("Error creating worker pool for camera rig\n")
+}
+
+/*
+This function initializes the rig so that it schedules its frames on a worker pool that is shared with other users.
+@param inputWorkerPool: The pool to run the per camera jobs on
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeCameraRig::QRCodeCameraRig(const std::shared_ptr<SOMWorkerPool> &inputWorkerPool) : camerasArePinnedToWorkers(false)
+{
+if(!inputWorkerPool)
+{
+throw SOMException(std::string("Worker pool is NULL\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+workerPool = inputWorkerPool;
+}
+
+/*
+This function initializes the rig with its own worker pool made of configured threads (pinned to cores, SCHED_FIFO and/or bound to their NUMA node) and pins each camera to one of them (camera i goes to worker i modulo the number of workers).  Each camera's estimator, with its zbar scanner and buffers, is created and always run by its worker, so it stays in that core's caches and in that node's memory.
+@param inputWorkerConfigurations: The configuration of each worker
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeCameraRig::QRCodeCameraRig(const std::vector<SOMThreadConfiguration> &inputWorkerConfigurations) : camerasArePinnedToWorkers(true)
+{
+SOM_TRY
+workerPool.reset(new SOMWorkerPool(inputWorkerConfigurations));
+SOM_CATCH("Error creating configured worker pool for camera rig\n")
+}
+
+/*
+This function adds a camera to the rig.
+@param inputCameraImageWidth: The width of camera images used in the camera calibration
+@param inputCameraImageHeight: The height of the camera images used in the camera calibration
+@param inputCameraCalibrationMatrix: This is a 3x3 matrix that describes the camera transform (taking the distortion into account) in opencv format
+@param inputDistortionParameters: a 1x5 matrix which has the distortion parameters k1, k2, p1, p2, k3
+@param inputCameraToBodyTransform: a 4x4 matrix which maps points in the camera's (OpenCV) coordinate system to the body coordinate system (the pose of the camera in the body frame)
+@return: The index of the camera, which is the position its frames should be given in
+
+@exceptions: This function can throw exceptions
+*/
+int QRCodeCameraRig::addCamera(int inputCameraImageWidth, int inputCameraImageHeight, const cv::Mat_<double> &inputCameraCalibrationMatrix, const cv::Mat_<double> &inputCameraDistortionParameters, const cv::Mat_<double> &inputCameraToBodyTransform)
+{
+if(inputCameraToBodyTransform.rows != 4 || inputCameraToBodyTransform.cols != 4)
+{
+throw SOMException(std::string("Camera to body transform is not 4x4\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+cv::Mat bodyToCameraTransform;
+if(!cv::invert(inputCameraToBodyTransform, bodyToCameraTransform))
+{
+throw SOMException(std::string("Camera to body transform is not invertible\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//Results are never shown in a window, since the estimators run on worker threads
+std::unique_ptr<QRCodeStateEstimator> estimator;
+auto createEstimator = [&]()
+{
+estimator.reset(new QRCodeStateEstimator(inputCameraImageWidth, inputCameraImageHeight, inputCameraCalibrationMatrix, inputCameraDistortionParameters, false));
+};
+
+if(camerasArePinnedToWorkers)
+{
+//Let the camera's worker allocate it, so its memory comes from that worker's node
+std::mutex creationMutex;
+std::condition_variable creationFinishedCondition;
+bool creationIsFinished = false;
+std::exception_ptr creationException;
+
+workerPool->submitToWorker(cameraEstimators.size() % workerPool->getNumberOfWorkers(), [&]()
+{
+try
+{
+createEstimator();
+}
+catch(...)
+{
+creationException = std::current_exception();
+}
+
+std::lock_guard<std::mutex> lock(creationMutex);
+creationIsFinished = true;
+creationFinishedCondition.notify_all();
+});
+
+{
+std::unique_lock<std::mutex> lock(creationMutex);
+creationFinishedCondition.wait(lock, [&](){return creationIsFinished;});
+}
+
+if(creationException)
+{
+SOM_TRY
+std::rethrow_exception(creationException);
+SOM_CATCH("Error initializing state estimator for rig camera\n")
+}
+}
+else
+{
+SOM_TRY
+createEstimator();
+SOM_CATCH("Error initializing state estimator for rig camera\n")
+}
+
+cameraEstimators.push_back(std::move(estimator));
+bodyToCameraTransforms.push_back(bodyToCameraTransform);
+perCameraPosesBuffers.push_back(std::vector<cv::Mat>());
+perCameraIdentifiersBuffers.push_back(std::vector<std::string>());
+perCameraDimensionsBuffers.push_back(std::vector<double>());
+perCameraFrameTimestamps.push_back(QRCodeFrameTimestamps());
+cameraEstimators.back()->latencyTracer = latencyTracer;
+cameraEstimators.back()->latencyTraceTrackIndex = cameraEstimators.size() - 1;
+
+return cameraEstimators.size() - 1;
+}
+
+/*
+This function makes every camera's estimator (including ones added later) record its frame timestamps in the given tracer, on a track per camera.
+@param inputLatencyTracer: The tracer to use (NULL to stop tracing)
+*/
+void QRCodeCameraRig::setLatencyTracer(const std::shared_ptr<QRCodeLatencyTracer> &inputLatencyTracer)
+{
+latencyTracer = inputLatencyTracer;
+for(int cameraIndex = 0; cameraIndex < cameraEstimators.size(); cameraIndex++)
+{
+cameraEstimators[cameraIndex]->latencyTracer = latencyTracer;
+cameraEstimators[cameraIndex]->latencyTraceTrackIndex = cameraIndex;
+}
+}
+
+/*
+This function returns the number of cameras that have been added to the rig.
+@return: The number of cameras
+*/
+int QRCodeCameraRig::getNumberOfCameras() const
+{
+return cameraEstimators.size();
+}
+
+/*
+This function takes one grayscale frame per camera (all captured at the same moment), scans them in parallel and stores the pose of the body relative to each QR code that was seen by each camera.  An empty cv::Mat can be given for any camera that did not produce a frame.
+@param inputGrayscaleFrames: The frames to process, in camera index order
+@param inputBodyPosesBuffer: The buffer to store one detection per camera/QR code pair in
+@param inputCaptureTimestamps: When each frame was captured (getQRCodeTimestamp() clock), in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool QRCodeCameraRig::estimateBodyStatesFromGrayscaleFrames(const std::vector<cv::Mat> &inputGrayscaleFrames, std::vector<QRCodeRigDetection> &inputBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps)
+{
+SOM_TRY
+return estimateBodyStatesFromFrames(inputGrayscaleFrames, false, inputBodyPosesBuffer, inputCaptureTimestamps);
+SOM_CATCH("Error estimating body states from rig frames\n")
+}
+
+/*
+This function takes one BGR frame per camera (all captured at the same moment), scans them in parallel and stores the pose of the body relative to each QR code that was seen by each camera.  An empty cv::Mat can be given for any camera that did not produce a frame.
+@param inputBGRFrames: The frames to process, in camera index order
+@param inputBodyPosesBuffer: The buffer to store one detection per camera/QR code pair in
+@param inputCaptureTimestamps: When each frame was captured (getQRCodeTimestamp() clock), in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool QRCodeCameraRig::estimateBodyStatesFromBGRFrames(const std::vector<cv::Mat> &inputBGRFrames, std::vector<QRCodeRigDetection> &inputBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps)
+{
+SOM_TRY
+return estimateBodyStatesFromFrames(inputBGRFrames, true, inputBodyPosesBuffer, inputCaptureTimestamps);
+SOM_CATCH("Error estimating body states from rig frames\n")
+}
+
+/*
+This function is the same as estimateBodyStatesFromGrayscaleFrames, except that detections of the same QR code by more than one camera are fused into a single body pose (translations are averaged and the averaged rotation is projected back onto a rotation matrix).
+@param inputGrayscaleFrames: The frames to process, in camera index order
+@param inputFusedBodyPosesBuffer: The buffer to store one detection per QR code in
+@param inputCaptureTimestamps: When each frame was captured (getQRCodeTimestamp() clock), in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool QRCodeCameraRig::estimateFusedBodyStatesFromGrayscaleFrames(const std::vector<cv::Mat> &inputGrayscaleFrames, std::vector<QRCodeRigDetection> &inputFusedBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps)
+{
+std::vector<QRCodeRigDetection> perCameraDetections;
+
+SOM_TRY
+estimateBodyStatesFromFrames(inputGrayscaleFrames, false, perCameraDetections, inputCaptureTimestamps);
+SOM_CATCH("Error estimating body states from rig frames\n")
+
+inputFusedBodyPosesBuffer.clear();
+
+//Group the detections by QR code identifier (rigs see a handful of tags, so a linear search is fine)
+std::vector<bool> detectionHasBeenUsed(perCameraDetections.size(), false);
+for(int i=0; i < perCameraDetections.size(); i++)
+{
+if(detectionHasBeenUsed[i])
+{
+continue;
+}
+
+std::vector<cv::Mat> posesOfSameTag;
+QRCodeRigDetection fusedDetection = perCameraDetections[i];
+for(int j=i; j < perCameraDetections.size(); j++)
+{
+if(detectionHasBeenUsed[j] || perCameraDetections[j].QRCodeIdentifier != fusedDetection.QRCodeIdentifier)
+{
+continue;
+}
+
+posesOfSameTag.push_back(perCameraDetections[j].bodyPose);
+detectionHasBeenUsed[j] = true;
+}
+
+if(posesOfSameTag.size() > 1)
+{
+SOM_TRY
+fusedDetection.bodyPose = fuseBodyPoses(posesOfSameTag);
+SOM_CATCH("Error fusing body poses\n")
+fusedDetection.cameraIndex = -1;
+fusedDetection.numberOfContributingCameras = posesOfSameTag.size();
+}
+
+inputFusedBodyPosesBuffer.push_back(fusedDetection);
+}
+
+return inputFusedBodyPosesBuffer.size() > 0;
+}
+
+/*
+This function runs one job per camera on the worker pool and waits for all of them to finish.
+@param inputFrames: The frames to process, in camera index order
+@param inputFramesAreBGR: True if the frames need to be converted from BGR
+@param inputBodyPosesBuffer: The buffer to store one detection per camera/QR code pair in
+@param inputCaptureTimestamps: When each frame was captured, in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool QRCodeCameraRig::estimateBodyStatesFromFrames(const std::vector<cv::Mat> &inputFrames, bool inputFramesAreBGR, std::vector<QRCodeRigDetection> &inputBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps)
+{
+if(inputFrames.size() != cameraEstimators.size())
+{
+throw SOMException(std::string("Number of frames does not match number of rig cameras\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(inputCaptureTimestamps.size() != 0 && inputCaptureTimestamps.size() != cameraEstimators.size())
+{
+throw SOMException(std::string("Number of capture timestamps does not match number of rig cameras\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//The pool may be shared, so wait on a count of this call's jobs rather than on the whole pool
+std::mutex jobsMutex;
+std::condition_variable jobsFinishedCondition;
+int numberOfUnfinishedJobs = 0;
+std::vector<std::exception_ptr> jobExceptions(cameraEstimators.size());
+
+for(int cameraIndex = 0; cameraIndex < cameraEstimators.size(); cameraIndex++)
+{
+perCameraPosesBuffers[cameraIndex].clear();
+perCameraIdentifiersBuffers[cameraIndex].clear();
+perCameraDimensionsBuffers[cameraIndex].clear();
+perCameraFrameTimestamps[cameraIndex] = QRCodeFrameTimestamps();
+perCameraFrameTimestamps[cameraIndex].captureTimestamp = inputCaptureTimestamps.size() > 0 ? inputCaptureTimestamps[cameraIndex] : 0;
+
+if(inputFrames[cameraIndex].empty())
+{
+//No frame from this camera this time, which the trace shows as a dropped frame (stamped now if the capture time is unknown)
+if(latencyTracer)
+{
+int64_t captureTimestamp = perCameraFrameTimestamps[cameraIndex].captureTimestamp;
+latencyTracer->recordDroppedFrame(captureTimestamp != 0 ? captureTimestamp : getQRCodeTimestamp(), cameraIndex);
+}
+continue;
+}
+
+{
+std::lock_guard<std::mutex> lock(jobsMutex);
+numberOfUnfinishedJobs++;
+}
+
+auto cameraJob = [&, cameraIndex]()
+{
+try
+{
+if(inputFramesAreBGR)
+{
+cameraEstimators[cameraIndex]->estimateOneOrMoreStatesFromBGRFrame(inputFrames[cameraIndex], perCameraPosesBuffers[cameraIndex], perCameraIdentifiersBuffers[cameraIndex], perCameraDimensionsBuffers[cameraIndex], &perCameraFrameTimestamps[cameraIndex]);
+}
+else
+{
+cameraEstimators[cameraIndex]->estimateOneOrMoreStatesFromGrayscaleFrame(inputFrames[cameraIndex], perCameraPosesBuffers[cameraIndex], perCameraIdentifiersBuffers[cameraIndex], perCameraDimensionsBuffers[cameraIndex], &perCameraFrameTimestamps[cameraIndex]);
+}
+}
+catch(...)
+{
+jobExceptions[cameraIndex] = std::current_exception();
+}
+
+std::lock_guard<std::mutex> lock(jobsMutex);
+numberOfUnfinishedJobs--;
+if(numberOfUnfinishedJobs == 0)
+{
+jobsFinishedCondition.notify_all();
+}
+};
+
+if(camerasArePinnedToWorkers)
+{
+workerPool->submitToWorker(cameraIndex % workerPool->getNumberOfWorkers(), cameraJob);
+}
+else
+{
+workerPool->submit(cameraJob);
+}
+}
+
+{
+std::unique_lock<std::mutex> lock(jobsMutex);
+jobsFinishedCondition.wait(lock, [&](){return numberOfUnfinishedJobs == 0;});
+}
+
+for(int cameraIndex = 0; cameraIndex < jobExceptions.size(); cameraIndex++)
+{
+if(jobExceptions[cameraIndex])
+{
+SOM_TRY
+std::rethrow_exception(jobExceptions[cameraIndex]);
+SOM_CATCH("Error estimating state for rig camera " + std::to_string(cameraIndex) + "\n")
+}
+}
+
+//Convert camera poses to body poses
+inputBodyPosesBuffer.clear();
+for(int cameraIndex = 0; cameraIndex < cameraEstimators.size(); cameraIndex++)
+{
+for(int i=0; i < perCameraPosesBuffers[cameraIndex].size(); i++)
+{
+QRCodeRigDetection detection;
+detection.cameraIndex = cameraIndex;
+detection.numberOfContributingCameras = 1;
+detection.bodyPose = perCameraPosesBuffers[cameraIndex][i] * bodyToCameraTransforms[cameraIndex];
+detection.QRCodeIdentifier = perCameraIdentifiersBuffers[cameraIndex][i];
+detection.QRCodeDimension = perCameraDimensionsBuffers[cameraIndex][i];
+detection.frameTimestamps = perCameraFrameTimestamps[cameraIndex];
+inputBodyPosesBuffer.push_back(detection);
+}
+}
+
+return inputBodyPosesBuffer.size() > 0;
+}
+
+/*
+This function averages a set of body poses that are relative to the same QR code.
+@param inputBodyPoses: The 4x4 poses to average
+@return: The averaged 4x4 pose
+
+@exceptions: This function can throw exceptions
+*/
+cv::Mat fuseBodyPoses(const std::vector<cv::Mat> &inputBodyPoses)
+{
+if(inputBodyPoses.size() == 0)
+{
+throw SOMException(std::string("No poses to fuse\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+cv::Mat_<double> rotationSum = cv::Mat::zeros(3, 3, CV_64F);
+cv::Mat_<double> fusedPose = cv::Mat::eye(4, 4, CV_64F);
+
+for(int i=0; i < inputBodyPoses.size(); i++)
+{
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+rotationSum.at<double>(row, col) += inputBodyPoses[i].at<double>(row, col);
+}
+fusedPose.at<double>(row, 3) += inputBodyPoses[i].at<double>(row, 3) / inputBodyPoses.size();
+}
+}
+
+//Project the summed rotations onto the closest rotation matrix
+cv::Mat singularValues, U, Vt;
+cv::SVD::compute(rotationSum, singularValues, U, Vt);
+cv::Mat_<double> fusedRotation = U * Vt;
+if(cv::determinant(fusedRotation) < 0.0)
+{
+for(int col = 0; col < 3; col++)
+{
+U.at<double>(col, 2) = -U.at<double>(col, 2);
+}
+fusedRotation = U * Vt;
+}
+
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+fusedPose.at<double>(row, col) = fusedRotation.at<double>(row, col);
+}
+}
+
+return fusedPose;
+}
@@ -0,0 +1,150 @@
+#ifndef QRCODECAMERARIGHPP
+#define QRCODECAMERARIGHPP
+
+#include<string>
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<condition_variable>
+
+#include "SOMException.hpp"
+#include "SOMScopeGuard.hpp"
+#include "SOMWorkerPool.hpp"
+#include "QRCodeStateEstimator.hpp"
+
+/*
+This struct holds the pose of the vehicle body relative to one QR code, as seen by one camera (or by several cameras if it is the result of fusion).
+*/
+struct QRCodeRigDetection
+{
+int cameraIndex; //Index of the camera that saw the tag (-1 if fused from more than one camera)
+int numberOfContributingCameras; //How many cameras were used to make this pose
+cv::Mat bodyPose; //4x4 pose of the body in the coordinate system of the QR code
+std::string QRCodeIdentifier; //Text left from the QR code after the dimension information has been removed
+double QRCodeDimension; //Size of the QR code in meters
+QRCodeFrameTimestamps frameTimestamps; //Timestamps of the frame the pose came from (the first contributing camera's for fused poses)
+};
+
+/*
+This class manages several calibrated cameras which are rigidly attached to one vehicle body.  Each camera gets its own QRCodeStateEstimator, and the frames from all of the cameras are processed in parallel on a worker pool which can be shared with the rest of the process (so several rigs/cameras do not each start a thread per core).  The camera poses are converted to the pose of the body using the camera to body transforms given when the cameras were added.
+*/
+class QRCodeCameraRig
+{
+public:
+/*
+This function initializes the rig with its own worker pool.
+@param inputNumberOfWorkers: How many worker threads to use (0 means one per hardware thread)
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeCameraRig(int inputNumberOfWorkers = 0);
+
+/*
+This function initializes the rig so that it schedules its frames on a worker pool that is shared with other users.
+@param inputWorkerPool: The pool to run the per camera jobs on
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeCameraRig(const std::shared_ptr<SOMWorkerPool> &inputWorkerPool);
+
+/*
+This function initializes the rig with its own worker pool made of configured threads (pinned to cores, SCHED_FIFO and/or bound to their NUMA node) and pins each camera to one of them (camera i goes to worker i modulo the number of workers).  Each camera's estimator, with its zbar scanner and buffers, is created and always run by its worker, so it stays in that core's caches and in that node's memory.
+@param inputWorkerConfigurations: The configuration of each worker
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeCameraRig(const std::vector<SOMThreadConfiguration> &inputWorkerConfigurations);
+
+/*
+This function adds a camera to the rig.
+@param inputCameraImageWidth: The width of camera images used in the camera calibration
+@param inputCameraImageHeight: The height of the camera images used in the camera calibration
+@param inputCameraCalibrationMatrix: This is a 3x3 matrix that describes the camera transform (taking the distortion into account) in opencv format
+@param inputDistortionParameters: a 1x5 matrix which has the distortion parameters k1, k2, p1, p2, k3
+@param inputCameraToBodyTransform: a 4x4 matrix which maps points in the camera's (OpenCV) coordinate system to the body coordinate system (the pose of the camera in the body frame)
+@return: The index of the camera, which is the position its frames should be given in
+
+@exceptions: This function can throw exceptions
+*/
+int addCamera(int inputCameraImageWidth, int inputCameraImageHeight, const cv::Mat_<double> &inputCameraCalibrationMatrix, const cv::Mat_<double> &inputCameraDistortionParameters, const cv::Mat_<double> &inputCameraToBodyTransform);
+
+/*
+This function returns the number of cameras that have been added to the rig.
+@return: The number of cameras
+*/
+int getNumberOfCameras() const;
+
+/*
+This function takes one grayscale frame per camera (all captured at the same moment), scans them in parallel and stores the pose of the body relative to each QR code that was seen by each camera.  An empty cv::Mat can be given for any camera that did not produce a frame.
+@param inputGrayscaleFrames: The frames to process, in camera index order
+@param inputBodyPosesBuffer: The buffer to store one detection per camera/QR code pair in
+@param inputCaptureTimestamps: When each frame was captured (getQRCodeTimestamp() clock), in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool estimateBodyStatesFromGrayscaleFrames(const std::vector<cv::Mat> &inputGrayscaleFrames, std::vector<QRCodeRigDetection> &inputBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps = std::vector<int64_t>());
+
+/*
+This function takes one BGR frame per camera (all captured at the same moment), scans them in parallel and stores the pose of the body relative to each QR code that was seen by each camera.  An empty cv::Mat can be given for any camera that did not produce a frame.
+@param inputBGRFrames: The frames to process, in camera index order
+@param inputBodyPosesBuffer: The buffer to store one detection per camera/QR code pair in
+@param inputCaptureTimestamps: When each frame was captured (getQRCodeTimestamp() clock), in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool estimateBodyStatesFromBGRFrames(const std::vector<cv::Mat> &inputBGRFrames, std::vector<QRCodeRigDetection> &inputBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps = std::vector<int64_t>());
+
+/*
+This function is the same as estimateBodyStatesFromGrayscaleFrames, except that detections of the same QR code by more than one camera are fused into a single body pose (translations are averaged and the averaged rotation is projected back onto a rotation matrix).
+@param inputGrayscaleFrames: The frames to process, in camera index order
+@param inputFusedBodyPosesBuffer: The buffer to store one detection per QR code in
+@param inputCaptureTimestamps: When each frame was captured (getQRCodeTimestamp() clock), in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool estimateFusedBodyStatesFromGrayscaleFrames(const std::vector<cv::Mat> &inputGrayscaleFrames, std::vector<QRCodeRigDetection> &inputFusedBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps = std::vector<int64_t>());
+
+/*
+This function makes every camera's estimator (including ones added later) record its frame timestamps in the given tracer, on a track per camera.
+@param inputLatencyTracer: The tracer to use (NULL to stop tracing)
+*/
+void setLatencyTracer(const std::shared_ptr<QRCodeLatencyTracer> &inputLatencyTracer);
+
+std::shared_ptr<SOMWorkerPool> workerPool;
+bool camerasArePinnedToWorkers; //True if each camera's estimator is created and run by one worker (set before adding cameras)
+std::shared_ptr<QRCodeLatencyTracer> latencyTracer;
+std::vector<std::unique_ptr<QRCodeStateEstimator> > cameraEstimators;
+std::vector<cv::Mat_<double> > bodyToCameraTransforms; //Inverse of the camera to body transforms, so the body pose is cameraPose * bodyToCamera
+
+private:
+/*
+This function runs one job per camera on the worker pool and waits for all of them to finish.
+@param inputFrames: The frames to process, in camera index order
+@param inputFramesAreBGR: True if the frames need to be converted from BGR
+@param inputBodyPosesBuffer: The buffer to store one detection per camera/QR code pair in
+@param inputCaptureTimestamps: When each frame was captured, in camera index order (empty if unknown)
+@return: true if any camera was able to estimate a pose and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool estimateBodyStatesFromFrames(const std::vector<cv::Mat> &inputFrames, bool inputFramesAreBGR, std::vector<QRCodeRigDetection> &inputBodyPosesBuffer, const std::vector<int64_t> &inputCaptureTimestamps);
+
+std::vector<std::vector<cv::Mat> > perCameraPosesBuffers;
+std::vector<std::vector<std::string> > perCameraIdentifiersBuffers;
+std::vector<std::vector<double> > perCameraDimensionsBuffers;
+std::vector<QRCodeFrameTimestamps> perCameraFrameTimestamps;
+};
+
+/*
+This function averages a set of body poses that are relative to the same QR code.
+@param inputBodyPoses: The 4x4 poses to average
+@return: The averaged 4x4 pose
+
+@exceptions: This function can throw exceptions
+*/
+cv::Mat fuseBodyPoses(const std::vector<cv::Mat> &inputBodyPoses);
+
+#endif
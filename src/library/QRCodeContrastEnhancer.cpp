@@ -0,0 +1,247 @@
+#include "QRCodeContrastEnhancer.hpp"
+
+#include<algorithm>
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#endif
+
+/*
+This function enhances one pixel given the sum of the window around it (the scalar version of what the SSE2 loop does, so both give the same result).
+@param inputMode: The enhancement to apply
+@param inputPixel: The value of the pixel
+@param inputWindowSum: The sum of the pixels in the window
+@param inputInverseArea: 1 divided by the number of pixels in the window
+@param inputThresholdScale: The fraction of the local mean a pixel has to reach to be white
+@param inputGain: The local contrast gain
+@return: The enhanced value
+*/
+static inline uint8_t enhancePixel(QRCodeContrastEnhancementMode inputMode, uint8_t inputPixel, uint32_t inputWindowSum, float inputInverseArea, float inputThresholdScale, float inputGain)
+{
+float mean = ((float) (int32_t) inputWindowSum) * inputInverseArea;
+if(inputMode == CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD)
+{
+return ((float) inputPixel) >= mean*inputThresholdScale ? 255 : 0;
+}
+
+float value = 128.0f + inputGain*(((float) inputPixel) - mean);
+value = std::min(std::max(value, 0.0f), 255.0f);
+return (uint8_t) (int32_t) (value + .5f);
+}
+
+/*
+This function initializes the enhancer with the default settings and CONTRAST_ENHANCEMENT_NONE.
+*/
+QRCodeContrastEnhancer::QRCodeContrastEnhancer() : mode(CONTRAST_ENHANCEMENT_NONE), windowRadius(QRCodeDefaultContrastWindowRadius), thresholdOffsetPercent(QRCodeDefaultThresholdOffsetPercent), localContrastGain(QRCodeDefaultLocalContrastGain)
+{
+}
+
+/*
+This function enhances a whole frame.
+@param inputGrayscaleFrame: The 8 bit grayscale frame to enhance
+@param inputEnhancedFrameBuffer: The buffer to store the (continuous) enhanced frame in
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeContrastEnhancer::enhanceFrame(const cv::Mat &inputGrayscaleFrame, cv::Mat &inputEnhancedFrameBuffer)
+{
+if(inputGrayscaleFrame.type() != CV_8UC1 || inputGrayscaleFrame.dims != 2)
+{
+throw SOMException(std::string("Contrast enhancement needs an 8 bit grayscale frame\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+inputEnhancedFrameBuffer.create(inputGrayscaleFrame.rows, inputGrayscaleFrame.cols, CV_8UC1);
+
+SOM_TRY
+enhanceRegion(inputGrayscaleFrame, cv::Rect(0, 0, inputGrayscaleFrame.cols, inputGrayscaleFrame.rows), inputEnhancedFrameBuffer);
+SOM_CATCH("Error enhancing frame\n")
+}
+
+/*
+This function copies a frame and enhances only the given regions of the copy.
+@param inputGrayscaleFrame: The 8 bit grayscale frame to enhance
+@param inputRegions: The regions to enhance (clipped to the frame, and allowed to overlap)
+@param inputNumberOfRegions: The number of regions
+@param inputEnhancedFrameBuffer: The buffer to store the (continuous) enhanced frame in
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeContrastEnhancer::enhanceRegions(const cv::Mat &inputGrayscaleFrame, const cv::Rect *inputRegions, int inputNumberOfRegions, cv::Mat &inputEnhancedFrameBuffer)
+{
+if(inputGrayscaleFrame.type() != CV_8UC1 || inputGrayscaleFrame.dims != 2)
+{
+throw SOMException(std::string("Contrast enhancement needs an 8 bit grayscale frame\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(inputRegions == NULL && inputNumberOfRegions > 0)
+{
+throw SOMException(std::string("Regions are NULL\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+inputEnhancedFrameBuffer.create(inputGrayscaleFrame.rows, inputGrayscaleFrame.cols, CV_8UC1);
+inputGrayscaleFrame.copyTo(inputEnhancedFrameBuffer);
+
+//Each region reads from the original frame, so overlapping regions just write the same values twice
+cv::Rect frameRectangle(0, 0, inputGrayscaleFrame.cols, inputGrayscaleFrame.rows);
+for(int i=0; i < inputNumberOfRegions; i++)
+{
+cv::Rect region = inputRegions[i] & frameRectangle;
+if(region.width <= 0 || region.height <= 0)
+{
+continue;
+}
+
+SOM_TRY
+enhanceRegion(inputGrayscaleFrame, region, inputEnhancedFrameBuffer);
+SOM_CATCH("Error enhancing frame region\n")
+}
+}
+
+/*
+This function enhances one region of a frame, writing the result into the same region of the buffer.
+@param inputGrayscaleFrame: The 8 bit grayscale frame to enhance
+@param inputRegion: The region to enhance (already clipped to the frame)
+@param inputEnhancedFrameBuffer: The buffer (the same size as the frame) to write the region into
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeContrastEnhancer::enhanceRegion(const cv::Mat &inputGrayscaleFrame, const cv::Rect &inputRegion, cv::Mat &inputEnhancedFrameBuffer)
+{
+if(mode != CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD && mode != CONTRAST_ENHANCEMENT_LOCAL_CONTRAST)
+{
+throw SOMException(std::string("Unknown contrast enhancement mode\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(windowRadius < 1 || windowRadius > QRCodeMaximumContrastWindowRadius)
+{
+throw SOMException(std::string("Contrast window radius out of range\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//The integral image covers the region grown by the window radius (clipped to the frame), with a leading row and column of zeros
+const int radius = windowRadius;
+const int left = std::max(inputRegion.x - radius, 0);
+const int top = std::max(inputRegion.y - radius, 0);
+const int right = std::min(inputRegion.x + inputRegion.width + radius, inputGrayscaleFrame.cols);
+const int bottom = std::min(inputRegion.y + inputRegion.height + radius, inputGrayscaleFrame.rows);
+const int integralWidth = right - left + 1;
+const int integralHeight = bottom - top + 1;
+integralImage.resize(((size_t) integralWidth) * integralHeight);
+
+uint32_t *integral = integralImage.data();
+std::fill(integral, integral + integralWidth, 0);
+for(int y = 0; y < integralHeight - 1; y++)
+{
+const uint8_t *source = inputGrayscaleFrame.ptr<uint8_t>(top + y) + left;
+const uint32_t *previousRow = integral + ((size_t) y)*integralWidth;
+uint32_t *currentRow = integral + ((size_t) y + 1)*integralWidth;
+uint32_t rowSum = 0;
+currentRow[0] = 0;
+for(int x = 0; x < integralWidth - 1; x++)
+{
+rowSum += source[x];
+currentRow[x + 1] = previousRow[x + 1] + rowSum;
+}
+}
+
+const float thresholdScale = (float) (1.0 - thresholdOffsetPercent / 100.0);
+const float gain = (float) localContrastGain;
+
+//Columns whose window is entirely inside the integral image all have the same width, which is the part done 16 at a time
+const int firstInteriorX = std::max(inputRegion.x, left + radius);
+const int lastInteriorX = std::min(inputRegion.x + inputRegion.width, right - radius); //One past the end
+
+for(int y = inputRegion.y; y < inputRegion.y + inputRegion.height; y++)
+{
+const int windowTop = std::max(y - radius, top) - top;
+const int windowBottom = std::min(y + radius + 1, bottom) - top;
+const uint32_t *topRow = integral + ((size_t) windowTop)*integralWidth;
+const uint32_t *bottomRow = integral + ((size_t) windowBottom)*integralWidth;
+const uint8_t *source = inputGrayscaleFrame.ptr<uint8_t>(y);
+uint8_t *destination = inputEnhancedFrameBuffer.ptr<uint8_t>(y);
+
+int x = inputRegion.x;
+for(; x < inputRegion.x + inputRegion.width; x++)
+{
+if(x == firstInteriorX && firstInteriorX < lastInteriorX)
+{
+//Windows are 2*radius+1 wide from here until lastInteriorX
+const float inverseArea = 1.0f / ((float) ((2*radius + 1)*(windowBottom - windowTop)));
+const uint32_t *bottomRight = bottomRow + (x + radius + 1 - left);
+const uint32_t *bottomLeft = bottomRow + (x - radius - left);
+const uint32_t *topRight = topRow + (x + radius + 1 - left);
+const uint32_t *topLeft = topRow + (x - radius - left);
+int offset = 0;
+
+#if defined(__SSE2__)
+const __m128 inverseAreaVector = _mm_set1_ps(inverseArea);
+const __m128 thresholdScaleVector = _mm_set1_ps(thresholdScale);
+const __m128 gainVector = _mm_set1_ps(gain);
+const __m128 midGrayVector = _mm_set1_ps(128.0f);
+const __m128 zeroVector = _mm_setzero_ps();
+const __m128 whiteVector = _mm_set1_ps(255.0f);
+const __m128 halfVector = _mm_set1_ps(.5f);
+const __m128i zeroIntegerVector = _mm_setzero_si128();
+for(; x + offset + 16 <= lastInteriorX; offset += 16)
+{
+__m128i pixels = _mm_loadu_si128((const __m128i *) (source + x + offset));
+__m128i lowPixels = _mm_unpacklo_epi8(pixels, zeroIntegerVector);
+__m128i highPixels = _mm_unpackhi_epi8(pixels, zeroIntegerVector);
+__m128i pixelQuarters[4] = {_mm_unpacklo_epi16(lowPixels, zeroIntegerVector), _mm_unpackhi_epi16(lowPixels, zeroIntegerVector), _mm_unpacklo_epi16(highPixels, zeroIntegerVector), _mm_unpackhi_epi16(highPixels, zeroIntegerVector)};
+
+__m128i results[4];
+for(int quarter = 0; quarter < 4; quarter++)
+{
+int quarterOffset = offset + 4*quarter;
+__m128i windowSum = _mm_sub_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *) (bottomRight + quarterOffset)), _mm_loadu_si128((const __m128i *) (topLeft + quarterOffset))), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (bottomLeft + quarterOffset)), _mm_loadu_si128((const __m128i *) (topRight + quarterOffset))));
+__m128 mean = _mm_mul_ps(_mm_cvtepi32_ps(windowSum), inverseAreaVector);
+__m128 pixel = _mm_cvtepi32_ps(pixelQuarters[quarter]);
+
+if(mode == CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD)
+{
+//All ones where white, which packs down to 255
+results[quarter] = _mm_castps_si128(_mm_cmpge_ps(pixel, _mm_mul_ps(mean, thresholdScaleVector)));
+}
+else
+{
+__m128 value = _mm_add_ps(midGrayVector, _mm_mul_ps(gainVector, _mm_sub_ps(pixel, mean)));
+value = _mm_min_ps(_mm_max_ps(value, zeroVector), whiteVector);
+results[quarter] = _mm_cvttps_epi32(_mm_add_ps(value, halfVector));
+}
+}
+
+__m128i packed;
+if(mode == CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD)
+{
+packed = _mm_packs_epi16(_mm_packs_epi32(results[0], results[1]), _mm_packs_epi32(results[2], results[3]));
+}
+else
+{
+packed = _mm_packus_epi16(_mm_packs_epi32(results[0], results[1]), _mm_packs_epi32(results[2], results[3]));
+}
+_mm_storeu_si128((__m128i *) (destination + x + offset), packed);
+}
+#endif
+
+//The rest of the interior (all of it without SSE2, where the compiler can vectorize this instead)
+for(; x + offset < lastInteriorX; offset++)
+{
+uint32_t windowSum = bottomRight[offset] - bottomLeft[offset] - topRight[offset] + topLeft[offset];
+destination[x + offset] = enhancePixel(mode, source[x + offset], windowSum, inverseArea, thresholdScale, gain);
+}
+
+x = lastInteriorX;
+if(x >= inputRegion.x + inputRegion.width)
+{
+break;
+}
+}
+
+//Columns near the edges of the frame have narrower windows
+const int windowLeft = std::max(x - radius, left) - left;
+const int windowRight = std::min(x + radius + 1, right) - left;
+uint32_t windowSum = bottomRow[windowRight] - bottomRow[windowLeft] - topRow[windowRight] + topRow[windowLeft];
+const float inverseArea = 1.0f / ((float) ((windowRight - windowLeft)*(windowBottom - windowTop)));
+destination[x] = enhancePixel(mode, source[x], windowSum, inverseArea, thresholdScale, gain);
+}
+}
+}
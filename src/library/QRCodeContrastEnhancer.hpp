@@ -0,0 +1,78 @@
+#ifndef QRCODECONTRASTENHANCERHPP
+#define QRCODECONTRASTENHANCERHPP
+
+#include<vector>
+#include<cstdint>
+
+#include "SOMException.hpp"
+#include <opencv2/core/core.hpp>
+
+//Declare handy constants
+static constexpr int QRCodeDefaultContrastWindowRadius = 12; //Pixels on each side of the center, so a 25x25 window
+static constexpr int QRCodeMaximumContrastWindowRadius = 127; //Keeps window sums below 2^24, so they are exact as floats
+static constexpr double QRCodeDefaultThresholdOffsetPercent = 15.0; //How far below the local mean a pixel has to be to count as dark
+static constexpr double QRCodeDefaultLocalContrastGain = 4.0;
+
+/*
+This enum selects what the contrast enhancer does to each pixel.
+*/
+enum QRCodeContrastEnhancementMode
+{
+CONTRAST_ENHANCEMENT_NONE, //Frames are scanned as they are
+CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD, //Pixels darker than the local mean (less the offset) become black and the rest white
+CONTRAST_ENHANCEMENT_LOCAL_CONTRAST //Each pixel's difference from the local mean is multiplied by the gain (around mid gray)
+};
+
+/*
+This class boosts the local contrast of grayscale frames before zbar scans them, which helps in dim or unevenly lit scenes where zbar's edge detector misses the modules of a tag.  Both modes compare each pixel with the mean of the window around it, which is found from an integral image in constant time per pixel no matter how big the window is.  The per pixel work is done 16 pixels at a time with SSE2 where it is available (and left to the compiler's vectorizer elsewhere, such as NEON at -O3).
+
+Only the given regions are enhanced (plus the window around them when building the integral image), so while tags are being tracked the cost follows the size of the tags rather than the size of the frame.
+*/
+class QRCodeContrastEnhancer
+{
+public:
+/*
+This function initializes the enhancer with the default settings and CONTRAST_ENHANCEMENT_NONE.
+*/
+QRCodeContrastEnhancer();
+
+/*
+This function enhances a whole frame.
+@param inputGrayscaleFrame: The 8 bit grayscale frame to enhance
+@param inputEnhancedFrameBuffer: The buffer to store the (continuous) enhanced frame in
+
+@exceptions: This function can throw exceptions
+*/
+void enhanceFrame(const cv::Mat &inputGrayscaleFrame, cv::Mat &inputEnhancedFrameBuffer);
+
+/*
+This function copies a frame and enhances only the given regions of the copy.
+@param inputGrayscaleFrame: The 8 bit grayscale frame to enhance
+@param inputRegions: The regions to enhance (clipped to the frame, and allowed to overlap)
+@param inputNumberOfRegions: The number of regions
+@param inputEnhancedFrameBuffer: The buffer to store the (continuous) enhanced frame in
+
+@exceptions: This function can throw exceptions
+*/
+void enhanceRegions(const cv::Mat &inputGrayscaleFrame, const cv::Rect *inputRegions, int inputNumberOfRegions, cv::Mat &inputEnhancedFrameBuffer);
+
+QRCodeContrastEnhancementMode mode;
+int windowRadius; //Half the width of the square window the local mean is taken over (1 to QRCodeMaximumContrastWindowRadius)
+double thresholdOffsetPercent; //Used by CONTRAST_ENHANCEMENT_ADAPTIVE_THRESHOLD
+double localContrastGain; //Used by CONTRAST_ENHANCEMENT_LOCAL_CONTRAST
+
+private:
+/*
+This function enhances one region of a frame, writing the result into the same region of the buffer.
+@param inputGrayscaleFrame: The 8 bit grayscale frame to enhance
+@param inputRegion: The region to enhance (already clipped to the frame)
+@param inputEnhancedFrameBuffer: The buffer (the same size as the frame) to write the region into
+
+@exceptions: This function can throw exceptions
+*/
+void enhanceRegion(const cv::Mat &inputGrayscaleFrame, const cv::Rect &inputRegion, cv::Mat &inputEnhancedFrameBuffer);
+
+std::vector<uint32_t> integralImage; //Sums wrap around for very large frames, but the window sums taken from them are still exact
+};
+
+#endif
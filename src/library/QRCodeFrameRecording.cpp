@@ -0,0 +1,649 @@
+#include "QRCodeFrameRecording.hpp"
+
+#include<chrono>
+#include<thread>
+#include<cmath>
+#include<cstring>
+#include<cerrno>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+/*
+This function rounds an offset up to the next QRCodeRecordingAlignment boundary.
+@param inputOffset: The offset to round
+@return: The rounded offset
+*/
+static uint64_t alignRecordingOffset(uint64_t inputOffset)
+{
+return (inputOffset + QRCodeRecordingAlignment - 1) / QRCodeRecordingAlignment * QRCodeRecordingAlignment;
+}
+
+/*
+This function creates the recording file.
+@param inputFilePath: Where to write the recording
+@param inputCompressFrames: True if frames should be delta/run length coded (frames that do not shrink are stored uncompressed)
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeFrameRecorder::QRCodeFrameRecorder(const std::string &inputFilePath, bool inputCompressFrames)
+{
+static_assert(sizeof(QRCodeRecordingFileHeader) == QRCodeRecordingAlignment, "Recording file header must be one alignment block");
+static_assert(sizeof(QRCodeRecordingFrameHeader) == QRCodeRecordingAlignment, "Recording frame header must be one alignment block");
+
+file = fopen(inputFilePath.c_str(), "wb");
+if(file == NULL)
+{
+throw SOMException(std::string("Unable to create recording file ") + inputFilePath + ": " + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+compressFrames = inputCompressFrames;
+currentOffset = 0;
+
+QRCodeRecordingFileHeader fileHeader;
+memset(&fileHeader, 0, sizeof(fileHeader));
+fileHeader.magicNumber = QRCodeRecordingFileMagicNumber;
+fileHeader.version = QRCodeRecordingVersion;
+
+SOM_TRY
+writePadded(&fileHeader, sizeof(fileHeader));
+SOM_CATCH("Error writing recording file header\n")
+}
+
+/*
+This function appends one frame and the estimator output for it.
+@param inputFrame: A grayscale (CV_8UC1) or YUYV (CV_8UC2) frame
+@param inputCaptureTimestamp: Monotonic clock nanoseconds when the frame was captured
+@param inputCameraPoses: The 4x4 camera poses the estimator returned for the frame
+@param inputQRCodeIdentifiers: The identifiers the estimator returned for the frame
+@param inputQRCodeDimensions: The dimensions the estimator returned for the frame
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeFrameRecorder::recordFrame(const cv::Mat &inputFrame, int64_t inputCaptureTimestamp, const std::vector<cv::Mat> &inputCameraPoses, const std::vector<std::string> &inputQRCodeIdentifiers, const std::vector<double> &inputQRCodeDimensions)
+{
+if(file == NULL)
+{
+throw SOMException(std::string("Recording has already been closed\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(inputFrame.type() != CV_8UC1 && inputFrame.type() != CV_8UC2)
+{
+throw SOMException(std::string("Recorded frames must be grayscale or YUYV\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(inputCameraPoses.size() != inputQRCodeIdentifiers.size() || inputCameraPoses.size() != inputQRCodeDimensions.size())
+{
+throw SOMException(std::string("Detection buffers are not the same size\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//Make the frame contiguous so it can be written in one go
+cv::Mat contiguousFrame = inputFrame.isContinuous() ? inputFrame : inputFrame.clone();
+uint64_t rowLength = contiguousFrame.cols * contiguousFrame.elemSize();
+uint64_t rawFrameSize = rowLength * contiguousFrame.rows;
+
+QRCodeRecordingFrameHeader frameHeader;
+memset(&frameHeader, 0, sizeof(frameHeader));
+frameHeader.magicNumber = QRCodeRecordingFrameMagicNumber;
+frameHeader.pixelFormat = (contiguousFrame.type() == CV_8UC1) ? RECORDING_GRAY8 : RECORDING_YUYV;
+frameHeader.compression = RECORDING_UNCOMPRESSED;
+frameHeader.width = contiguousFrame.cols;
+frameHeader.height = contiguousFrame.rows;
+frameHeader.numberOfDetections = inputCameraPoses.size();
+frameHeader.captureTimestamp = inputCaptureTimestamp;
+frameHeader.frameDataSize = rawFrameSize;
+
+const uint8_t *frameData = contiguousFrame.data;
+if(compressFrames)
+{
+compressFrameData(contiguousFrame.data, rowLength, contiguousFrame.rows, compressionBuffer);
+if(compressionBuffer.size() < rawFrameSize)
+{
+frameHeader.compression = RECORDING_DELTA_RLE;
+frameHeader.frameDataSize = compressionBuffer.size();
+frameData = compressionBuffer.data();
+}
+}
+
+//Serialize the detections
+detectionBuffer.clear();
+for(int i=0; i < inputCameraPoses.size(); i++)
+{
+if(inputCameraPoses[i].rows != 4 || inputCameraPoses[i].cols != 4 || inputCameraPoses[i].type() != CV_64F)
+{
+throw SOMException(std::string("Camera pose is not a 4x4 double matrix\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+QRCodeRecordingDetection detection;
+memset(&detection, 0, sizeof(detection));
+for(int row = 0; row < 4; row++)
+{
+for(int col = 0; col < 4; col++)
+{
+detection.cameraPose[row*4 + col] = inputCameraPoses[i].at<double>(row, col);
+}
+}
+detection.QRCodeDimension = inputQRCodeDimensions[i];
+detection.identifierLength = inputQRCodeIdentifiers[i].size();
+
+const uint8_t *detectionBytes = reinterpret_cast<const uint8_t *>(&detection);
+detectionBuffer.insert(detectionBuffer.end(), detectionBytes, detectionBytes + sizeof(detection));
+detectionBuffer.insert(detectionBuffer.end(), inputQRCodeIdentifiers[i].begin(), inputQRCodeIdentifiers[i].end());
+detectionBuffer.resize((detectionBuffer.size() + 7) / 8 * 8, 0);
+}
+frameHeader.detectionDataSize = detectionBuffer.size();
+
+SOM_TRY
+frameOffsets.push_back(currentOffset);
+writePadded(&frameHeader, sizeof(frameHeader));
+writePadded(frameData, frameHeader.frameDataSize);
+writePadded(detectionBuffer.data(), detectionBuffer.size());
+SOM_CATCH("Error writing frame to recording\n")
+}
+
+/*
+This function writes the index footer and closes the file.  It is called by the destructor if it has not been called already.
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeFrameRecorder::close()
+{
+if(file == NULL)
+{
+return;
+}
+SOMScopeGuard fileGuard([&](){fclose(file); file = NULL;});
+
+QRCodeRecordingFileFooter footer;
+memset(&footer, 0, sizeof(footer));
+footer.indexOffset = currentOffset;
+footer.numberOfFrames = frameOffsets.size();
+footer.magicNumber = QRCodeRecordingFooterMagicNumber;
+
+if(fwrite(frameOffsets.data(), sizeof(uint64_t), frameOffsets.size(), file) != frameOffsets.size() || fwrite(&footer, sizeof(footer), 1, file) != 1 || fflush(file) != 0)
+{
+throw SOMException(std::string("Unable to write recording index: ") + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+/*
+This destructor finishes the file (ignoring any errors).
+*/
+QRCodeFrameRecorder::~QRCodeFrameRecorder()
+{
+try
+{
+close();
+}
+catch(const std::exception &inputException)
+{
+}
+}
+
+/*
+This function writes bytes and then zero padding up to the next QRCodeRecordingAlignment boundary.
+@param inputData: The bytes to write
+@param inputSize: The number of bytes
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeFrameRecorder::writePadded(const void *inputData, uint64_t inputSize)
+{
+static const uint8_t padding[QRCodeRecordingAlignment] = {0};
+uint64_t paddingSize = alignRecordingOffset(inputSize) - inputSize;
+
+if((inputSize > 0 && fwrite(inputData, 1, inputSize, file) != inputSize) || (paddingSize > 0 && fwrite(padding, 1, paddingSize, file) != paddingSize))
+{
+throw SOMException(std::string("Unable to write to recording: ") + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+currentOffset += inputSize + paddingSize;
+}
+
+/*
+This function maps the recording and loads (or rebuilds) its index.
+@param inputFilePath: The recording to open
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeFrameRecording::QRCodeFrameRecording(const std::string &inputFilePath)
+{
+int fileDescriptor = open(inputFilePath.c_str(), O_RDONLY);
+if(fileDescriptor < 0)
+{
+throw SOMException(std::string("Unable to open recording file ") + inputFilePath + ": " + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+SOMScopeGuard fileDescriptorGuard([&](){::close(fileDescriptor);});
+
+struct stat fileStatus;
+if(fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size < (off_t) sizeof(QRCodeRecordingFileHeader))
+{
+throw SOMException(std::string("Recording file is too small\n"), FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+fileSize = fileStatus.st_size;
+
+void *mappedFile = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+if(mappedFile == MAP_FAILED)
+{
+throw SOMException(std::string("Unable to map recording file: ") + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+fileData = reinterpret_cast<const uint8_t *>(mappedFile);
+SOMScopeGuard mappingGuard([&](){munmap(mappedFile, fileSize);});
+
+const QRCodeRecordingFileHeader *fileHeader = reinterpret_cast<const QRCodeRecordingFileHeader *>(fileData);
+if(fileHeader->magicNumber != QRCodeRecordingFileMagicNumber || fileHeader->version != QRCodeRecordingVersion)
+{
+throw SOMException(std::string("File is not a supported frame recording\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//Try to use the index footer
+bool indexIsValid = false;
+if(fileSize >= sizeof(QRCodeRecordingFileHeader) + sizeof(QRCodeRecordingFileFooter))
+{
+const QRCodeRecordingFileFooter *footer = reinterpret_cast<const QRCodeRecordingFileFooter *>(fileData + fileSize - sizeof(QRCodeRecordingFileFooter));
+if(footer->magicNumber == QRCodeRecordingFooterMagicNumber && footer->indexOffset <= fileSize - sizeof(QRCodeRecordingFileFooter) && footer->numberOfFrames == (fileSize - sizeof(QRCodeRecordingFileFooter) - footer->indexOffset) / sizeof(uint64_t))
+{
+const uint64_t *index = reinterpret_cast<const uint64_t *>(fileData + footer->indexOffset);
+frameOffsets.assign(index, index + footer->numberOfFrames);
+
+indexIsValid = true;
+for(int i=0; i < frameOffsets.size(); i++)
+{
+uint64_t endOfChunk = validateChunk(frameOffsets[i]);
+if(endOfChunk == 0 || endOfChunk > footer->indexOffset)
+{
+indexIsValid = false;
+break;
+}
+}
+}
+}
+
+//Rebuild it by walking the chunks if the recording was not closed properly
+if(!indexIsValid)
+{
+frameOffsets.clear();
+uint64_t offset = sizeof(QRCodeRecordingFileHeader);
+while(true)
+{
+uint64_t nextOffset = validateChunk(offset);
+if(nextOffset == 0)
+{
+break;
+}
+frameOffsets.push_back(offset);
+offset = nextOffset;
+}
+}
+
+mappingGuard.dismiss();
+}
+
+/*
+This function returns the number of frames in the recording.
+@return: The number of frames
+*/
+int QRCodeFrameRecording::getNumberOfFrames() const
+{
+return frameOffsets.size();
+}
+
+/*
+This function reads one frame.  Uncompressed frames point directly into the mapped file; compressed ones are decoded into a buffer owned by the given frame.
+@param inputFrameIndex: Which frame to read
+@param inputFrameBuffer: Where to store the frame and its recorded detections
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeFrameRecording::getFrame(int inputFrameIndex, QRCodeRecordedFrame &inputFrameBuffer) const
+{
+if(inputFrameIndex < 0 || inputFrameIndex >= frameOffsets.size())
+{
+throw SOMException(std::string("Frame index out of range\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+const QRCodeRecordingFrameHeader *frameHeader = reinterpret_cast<const QRCodeRecordingFrameHeader *>(fileData + frameOffsets[inputFrameIndex]);
+const uint8_t *frameData = reinterpret_cast<const uint8_t *>(frameHeader) + sizeof(QRCodeRecordingFrameHeader);
+const uint8_t *detectionData = frameData + alignRecordingOffset(frameHeader->frameDataSize);
+
+int frameType = (frameHeader->pixelFormat == RECORDING_GRAY8) ? CV_8UC1 : CV_8UC2;
+inputFrameBuffer.pixelFormat = (QRCodeRecordingPixelFormat) frameHeader->pixelFormat;
+inputFrameBuffer.captureTimestamp = frameHeader->captureTimestamp;
+
+if(frameHeader->compression == RECORDING_UNCOMPRESSED)
+{
+//The mapping is read only, so the frame must not be written to
+inputFrameBuffer.frame = cv::Mat(frameHeader->height, frameHeader->width, frameType, const_cast<uint8_t *>(frameData));
+}
+else
+{
+if(inputFrameBuffer.frame.data == NULL || inputFrameBuffer.frame.rows != frameHeader->height || inputFrameBuffer.frame.cols != frameHeader->width || inputFrameBuffer.frame.type() != frameType || inputFrameBuffer.frame.data == frameData || !inputFrameBuffer.frame.isContinuous())
+{
+inputFrameBuffer.frame = cv::Mat(frameHeader->height, frameHeader->width, frameType);
+}
+
+uint64_t rowLength = inputFrameBuffer.frame.cols * inputFrameBuffer.frame.elemSize();
+if(!decompressFrameData(frameData, frameHeader->frameDataSize, rowLength, frameHeader->height, inputFrameBuffer.frame.data))
+{
+throw SOMException(std::string("Recorded frame data is corrupt\n"), FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+//Read the detections
+inputFrameBuffer.cameraPoses.clear();
+inputFrameBuffer.QRCodeIdentifiers.clear();
+inputFrameBuffer.QRCodeDimensions.clear();
+
+uint64_t detectionOffset = 0;
+for(int i=0; i < frameHeader->numberOfDetections; i++)
+{
+const QRCodeRecordingDetection *detection = reinterpret_cast<const QRCodeRecordingDetection *>(detectionData + detectionOffset);
+
+cv::Mat cameraPose(4, 4, CV_64F);
+for(int row = 0; row < 4; row++)
+{
+for(int col = 0; col < 4; col++)
+{
+cameraPose.at<double>(row, col) = detection->cameraPose[row*4 + col];
+}
+}
+
+const char *identifier = reinterpret_cast<const char *>(detection) + sizeof(QRCodeRecordingDetection);
+inputFrameBuffer.cameraPoses.push_back(cameraPose);
+inputFrameBuffer.QRCodeIdentifiers.push_back(std::string(identifier, detection->identifierLength));
+inputFrameBuffer.QRCodeDimensions.push_back(detection->QRCodeDimension);
+
+detectionOffset += (sizeof(QRCodeRecordingDetection) + detection->identifierLength + 7) / 8 * 8;
+}
+}
+
+/*
+This destructor unmaps the file.
+*/
+QRCodeFrameRecording::~QRCodeFrameRecording()
+{
+munmap(const_cast<uint8_t *>(fileData), fileSize);
+}
+
+/*
+This function checks that a frame chunk starting at the given offset fits in the file and returns the offset just past it.
+@param inputOffset: The offset of the chunk
+@return: The offset of the next chunk, or 0 if the chunk is invalid or truncated
+*/
+uint64_t QRCodeFrameRecording::validateChunk(uint64_t inputOffset) const
+{
+if(inputOffset % QRCodeRecordingAlignment != 0 || inputOffset < sizeof(QRCodeRecordingFileHeader) || inputOffset > fileSize || fileSize - inputOffset < sizeof(QRCodeRecordingFrameHeader))
+{
+return 0;
+}
+
+const QRCodeRecordingFrameHeader *frameHeader = reinterpret_cast<const QRCodeRecordingFrameHeader *>(fileData + inputOffset);
+if(frameHeader->magicNumber != QRCodeRecordingFrameMagicNumber || frameHeader->pixelFormat > RECORDING_YUYV || frameHeader->compression > RECORDING_DELTA_RLE)
+{
+return 0;
+}
+
+uint64_t bytesPerPixel = (frameHeader->pixelFormat == RECORDING_GRAY8) ? 1 : 2;
+uint64_t rawFrameSize = bytesPerPixel * frameHeader->width * frameHeader->height;
+if(frameHeader->compression == RECORDING_UNCOMPRESSED && frameHeader->frameDataSize != rawFrameSize)
+{
+return 0;
+}
+
+//Each detection takes at least the fixed size struct
+uint64_t remainingSize = fileSize - inputOffset - sizeof(QRCodeRecordingFrameHeader);
+if(frameHeader->frameDataSize > remainingSize || frameHeader->detectionDataSize > remainingSize || frameHeader->numberOfDetections > frameHeader->detectionDataSize / sizeof(QRCodeRecordingDetection))
+{
+return 0;
+}
+
+uint64_t chunkSize = sizeof(QRCodeRecordingFrameHeader) + alignRecordingOffset(frameHeader->frameDataSize) + alignRecordingOffset(frameHeader->detectionDataSize);
+if(chunkSize > fileSize - inputOffset)
+{
+return 0;
+}
+
+//Make sure the identifiers stay inside the detection data
+const uint8_t *detectionData = fileData + inputOffset + sizeof(QRCodeRecordingFrameHeader) + alignRecordingOffset(frameHeader->frameDataSize);
+uint64_t detectionOffset = 0;
+for(uint32_t i=0; i < frameHeader->numberOfDetections; i++)
+{
+if(frameHeader->detectionDataSize - detectionOffset < sizeof(QRCodeRecordingDetection))
+{
+return 0;
+}
+
+const QRCodeRecordingDetection *detection = reinterpret_cast<const QRCodeRecordingDetection *>(detectionData + detectionOffset);
+uint64_t detectionSize = (sizeof(QRCodeRecordingDetection) + (uint64_t) detection->identifierLength + 7) / 8 * 8;
+if(detectionSize > frameHeader->detectionDataSize - detectionOffset)
+{
+return 0;
+}
+detectionOffset += detectionSize;
+}
+
+return inputOffset + chunkSize;
+}
+
+/*
+This function streams every frame of a recording through a state estimator and compares the results with what was recorded.
+@param inputRecording: The recording to replay
+@param inputEstimator: The estimator to replay the frames through (it should use the same calibration as when the recording was made)
+@param inputPlayAtRecordedSpeed: True to wait between frames so they are given at the rate they were captured, false to run as fast as possible
+@param inputPoseTolerance: The largest difference in any pose element that is still considered a match
+@param inputSummaryBuffer: The buffer to store the replay summary in
+@return: true if every frame matched the recording and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool replayFrameRecording(const QRCodeFrameRecording &inputRecording, QRCodeStateEstimator &inputEstimator, bool inputPlayAtRecordedSpeed, double inputPoseTolerance, QRCodeReplaySummary &inputSummaryBuffer)
+{
+inputSummaryBuffer.numberOfFramesReplayed = 0;
+inputSummaryBuffer.numberOfMismatchedFrames = 0;
+inputSummaryBuffer.largestPoseDifference = 0.0;
+inputSummaryBuffer.totalEstimationSeconds = 0.0;
+
+QRCodeRecordedFrame recordedFrame;
+cv::Mat grayscaleFrame;
+std::vector<cv::Mat> cameraPoses;
+std::vector<std::string> QRCodeIdentifiers;
+std::vector<double> QRCodeDimensions;
+
+std::chrono::steady_clock::time_point replayStartTime = std::chrono::steady_clock::now();
+int64_t firstCaptureTimestamp = 0;
+
+for(int frameIndex = 0; frameIndex < inputRecording.getNumberOfFrames(); frameIndex++)
+{
+SOM_TRY
+inputRecording.getFrame(frameIndex, recordedFrame);
+SOM_CATCH("Error reading recorded frame " + std::to_string(frameIndex) + "\n")
+
+if(frameIndex == 0)
+{
+firstCaptureTimestamp = recordedFrame.captureTimestamp;
+}
+
+if(inputPlayAtRecordedSpeed)
+{
+std::this_thread::sleep_until(replayStartTime + std::chrono::nanoseconds(recordedFrame.captureTimestamp - firstCaptureTimestamp));
+}
+
+//The luma channel of YUYV is every other byte
+if(recordedFrame.pixelFormat == RECORDING_YUYV)
+{
+grayscaleFrame.create(recordedFrame.frame.rows, recordedFrame.frame.cols, CV_8UC1);
+for(int row = 0; row < recordedFrame.frame.rows; row++)
+{
+const uint8_t *source = recordedFrame.frame.ptr(row);
+uint8_t *destination = grayscaleFrame.ptr(row);
+for(int col = 0; col < recordedFrame.frame.cols; col++)
+{
+destination[col] = source[2*col];
+}
+}
+}
+else
+{
+grayscaleFrame = recordedFrame.frame;
+}
+
+std::chrono::steady_clock::time_point estimationStartTime = std::chrono::steady_clock::now();
+SOM_TRY
+inputEstimator.estimateOneOrMoreStatesFromGrayscaleFrame(grayscaleFrame, cameraPoses, QRCodeIdentifiers, QRCodeDimensions);
+SOM_CATCH("Error estimating state from recorded frame " + std::to_string(frameIndex) + "\n")
+inputSummaryBuffer.totalEstimationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - estimationStartTime).count();
+inputSummaryBuffer.numberOfFramesReplayed++;
+
+//Compare with the recording
+bool frameMatches = cameraPoses.size() == recordedFrame.cameraPoses.size();
+for(int i=0; frameMatches && i < cameraPoses.size(); i++)
+{
+if(QRCodeIdentifiers[i] != recordedFrame.QRCodeIdentifiers[i] || fabs(QRCodeDimensions[i] - recordedFrame.QRCodeDimensions[i]) > inputPoseTolerance)
+{
+frameMatches = false;
+break;
+}
+
+for(int row = 0; row < 4; row++)
+{
+for(int col = 0; col < 4; col++)
+{
+double difference = fabs(cameraPoses[i].at<double>(row, col) - recordedFrame.cameraPoses[i].at<double>(row, col));
+inputSummaryBuffer.largestPoseDifference = std::max(inputSummaryBuffer.largestPoseDifference, difference);
+if(!(difference <= inputPoseTolerance))
+{
+frameMatches = false;
+}
+}
+}
+}
+
+if(!frameMatches)
+{
+inputSummaryBuffer.numberOfMismatchedFrames++;
+}
+}
+
+return inputSummaryBuffer.numberOfMismatchedFrames == 0;
+}
+
+/*
+This function delta and run length codes an image.  The output is only useful if it is smaller than the input.
+@param inputData: The image rows (packed, no stride)
+@param inputRowLength: The number of bytes per row
+@param inputNumberOfRows: The number of rows
+@param inputOutputBuffer: The buffer to store the coded bytes in
+*/
+void compressFrameData(const uint8_t *inputData, uint64_t inputRowLength, uint64_t inputNumberOfRows, std::vector<uint8_t> &inputOutputBuffer)
+{
+inputOutputBuffer.clear();
+std::vector<uint8_t> deltaRow(inputRowLength);
+
+for(uint64_t row = 0; row < inputNumberOfRows; row++)
+{
+//Delta code the row so smooth gradients become runs
+const uint8_t *rowData = inputData + row * inputRowLength;
+if(inputRowLength > 0)
+{
+deltaRow[0] = rowData[0];
+}
+for(uint64_t i=1; i < inputRowLength; i++)
+{
+deltaRow[i] = rowData[i] - rowData[i-1];
+}
+
+//PackBits: 0-127 means n+1 literal bytes follow, 129-255 means the next byte is repeated 257-n times
+uint64_t i = 0;
+while(i < inputRowLength)
+{
+uint64_t runLength = 1;
+while(i + runLength < inputRowLength && runLength < 128 && deltaRow[i + runLength] == deltaRow[i])
+{
+runLength++;
+}
+
+if(runLength >= 3)
+{
+inputOutputBuffer.push_back(257 - runLength);
+inputOutputBuffer.push_back(deltaRow[i]);
+i += runLength;
+continue;
+}
+
+uint64_t literalStart = i;
+uint64_t literalLength = 0;
+while(i < inputRowLength && literalLength < 128)
+{
+if(i + 2 < inputRowLength && deltaRow[i] == deltaRow[i+1] && deltaRow[i] == deltaRow[i+2])
+{
+break; //A run starts here
+}
+i++;
+literalLength++;
+}
+
+inputOutputBuffer.push_back(literalLength - 1);
+inputOutputBuffer.insert(inputOutputBuffer.end(), deltaRow.begin() + literalStart, deltaRow.begin() + literalStart + literalLength);
+}
+}
+}
+
+/*
+This function reverses compressFrameData.
+@param inputData: The coded bytes
+@param inputSize: The number of coded bytes
+@param inputRowLength: The number of bytes per row
+@param inputNumberOfRows: The number of rows
+@param inputOutputBuffer: Where to write the decoded rows (inputRowLength * inputNumberOfRows bytes)
+@return: true if the data decoded to exactly the expected size and false if it is corrupt
+*/
+bool decompressFrameData(const uint8_t *inputData, uint64_t inputSize, uint64_t inputRowLength, uint64_t inputNumberOfRows, uint8_t *inputOutputBuffer)
+{
+uint64_t position = 0;
+
+for(uint64_t row = 0; row < inputNumberOfRows; row++)
+{
+uint8_t *rowData = inputOutputBuffer + row * inputRowLength;
+uint64_t rowPosition = 0;
+
+while(rowPosition < inputRowLength)
+{
+if(position >= inputSize)
+{
+return false;
+}
+
+uint8_t controlByte = inputData[position++];
+if(controlByte < 128)
+{
+uint64_t literalLength = controlByte + 1;
+if(literalLength > inputSize - position || literalLength > inputRowLength - rowPosition)
+{
+return false;
+}
+memcpy(rowData + rowPosition, inputData + position, literalLength);
+position += literalLength;
+rowPosition += literalLength;
+}
+else if(controlByte > 128)
+{
+uint64_t runLength = 257 - controlByte;
+if(position >= inputSize || runLength > inputRowLength - rowPosition)
+{
+return false;
+}
+memset(rowData + rowPosition, inputData[position++], runLength);
+rowPosition += runLength;
+}
+}
+
+//Undo the delta coding
+for(uint64_t i=1; i < inputRowLength; i++)
+{
+rowData[i] += rowData[i-1];
+}
+}
+
+return position == inputSize;
+}
@@ -0,0 +1,237 @@
+#ifndef QRCODEFRAMERECORDINGHPP
+#define QRCODEFRAMERECORDINGHPP
+
+#include<string>
+#include<vector>
+#include<cstdio>
+#include<cstdint>
+
+#include "SOMException.hpp"
+#include "SOMScopeGuard.hpp"
+#include "QRCodeStateEstimator.hpp"
+
+//Declare handy constants
+static const uint32_t QRCodeRecordingFileMagicNumber = 0x52465251; //"QRFR"
+static const uint32_t QRCodeRecordingFrameMagicNumber = 0x4D465251; //"QRFM"
+static const uint32_t QRCodeRecordingFooterMagicNumber = 0x49465251; //"QRFI"
+static const uint32_t QRCodeRecordingVersion = 1;
+static const uint64_t QRCodeRecordingAlignment = 64; //Frame data is aligned to this so it can be used straight from the mapped file
+
+enum QRCodeRecordingPixelFormat
+{
+RECORDING_GRAY8 = 0, //One byte per pixel (CV_8UC1)
+RECORDING_YUYV = 1 //YUV 4:2:2 packed, two bytes per pixel (CV_8UC2)
+};
+
+enum QRCodeRecordingCompression
+{
+RECORDING_UNCOMPRESSED = 0,
+RECORDING_DELTA_RLE = 1 //Each row is delta coded from its left neighbor and then run length (PackBits) coded
+};
+
+/*
+A recording is a 64 byte file header, followed by one chunk per frame and an index footer.  Each chunk is a 64 byte frame header, the frame data (padded to 64 bytes) and the estimator's detections for that frame (padded to 64 bytes).  The footer is an array of chunk offsets followed by a QRCodeRecordingFileFooter, so a reader can map the file and jump to any frame.  If the footer is missing (the recorder was killed), the reader rebuilds the index by walking the chunks.
+*/
+struct QRCodeRecordingFileHeader
+{
+uint32_t magicNumber;
+uint32_t version;
+uint32_t reserved[14];
+};
+
+struct QRCodeRecordingFrameHeader
+{
+uint32_t magicNumber;
+uint32_t pixelFormat; //QRCodeRecordingPixelFormat
+uint32_t compression; //QRCodeRecordingCompression
+uint32_t width;
+uint32_t height;
+uint32_t numberOfDetections;
+int64_t captureTimestamp; //Nanoseconds on the monotonic clock
+uint64_t frameDataSize; //Bytes of (possibly compressed) frame data, before padding
+uint64_t detectionDataSize; //Bytes of detection data, before padding
+uint8_t reserved[16];
+};
+
+struct QRCodeRecordingDetection
+{
+double cameraPose[16]; //Row major 4x4 camera pose
+double QRCodeDimension;
+uint32_t identifierLength; //Number of identifier bytes that follow this struct (padded to 8 bytes)
+uint32_t reserved;
+};
+
+struct QRCodeRecordingFileFooter
+{
+uint64_t indexOffset;
+uint64_t numberOfFrames;
+uint32_t magicNumber;
+uint32_t reserved;
+};
+
+/*
+This struct holds one frame read back from a recording, along with what the estimator found in it when it was recorded.
+*/
+struct QRCodeRecordedFrame
+{
+cv::Mat frame; //CV_8UC1 or CV_8UC2, points into the mapped file when the frame is not compressed (do not write to it)
+QRCodeRecordingPixelFormat pixelFormat;
+int64_t captureTimestamp;
+std::vector<cv::Mat> cameraPoses;
+std::vector<std::string> QRCodeIdentifiers;
+std::vector<double> QRCodeDimensions;
+};
+
+/*
+This class appends frames and the estimator's results for them to a recording file.
+*/
+class QRCodeFrameRecorder
+{
+public:
+/*
+This function creates the recording file.
+@param inputFilePath: Where to write the recording
+@param inputCompressFrames: True if frames should be delta/run length coded (frames that do not shrink are stored uncompressed)
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeFrameRecorder(const std::string &inputFilePath, bool inputCompressFrames = false);
+
+/*
+This function appends one frame and the estimator output for it.
+@param inputFrame: A grayscale (CV_8UC1) or YUYV (CV_8UC2) frame
+@param inputCaptureTimestamp: Monotonic clock nanoseconds when the frame was captured
+@param inputCameraPoses: The 4x4 camera poses the estimator returned for the frame
+@param inputQRCodeIdentifiers: The identifiers the estimator returned for the frame
+@param inputQRCodeDimensions: The dimensions the estimator returned for the frame
+
+@exceptions: This function can throw exceptions
+*/
+void recordFrame(const cv::Mat &inputFrame, int64_t inputCaptureTimestamp, const std::vector<cv::Mat> &inputCameraPoses, const std::vector<std::string> &inputQRCodeIdentifiers, const std::vector<double> &inputQRCodeDimensions);
+
+/*
+This function writes the index footer and closes the file.  It is called by the destructor if it has not been called already.
+
+@exceptions: This function can throw exceptions
+*/
+void close();
+
+/*
+This destructor finishes the file (ignoring any errors).
+*/
+~QRCodeFrameRecorder();
+
+private:
+QRCodeFrameRecorder(const QRCodeFrameRecorder &inputQRCodeFrameRecorder) = delete; //Disable copying of the object
+
+/*
+This function writes bytes and then zero padding up to the next QRCodeRecordingAlignment boundary.
+@param inputData: The bytes to write
+@param inputSize: The number of bytes
+
+@exceptions: This function can throw exceptions
+*/
+void writePadded(const void *inputData, uint64_t inputSize);
+
+FILE *file;
+bool compressFrames;
+uint64_t currentOffset;
+std::vector<uint64_t> frameOffsets;
+std::vector<uint8_t> compressionBuffer;
+std::vector<uint8_t> detectionBuffer;
+};
+
+/*
+This class maps a recording file into memory so that frames can be read back without copying.
+*/
+class QRCodeFrameRecording
+{
+public:
+/*
+This function maps the recording and loads (or rebuilds) its index.
+@param inputFilePath: The recording to open
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeFrameRecording(const std::string &inputFilePath);
+
+/*
+This function returns the number of frames in the recording.
+@return: The number of frames
+*/
+int getNumberOfFrames() const;
+
+/*
+This function reads one frame.  Uncompressed frames point directly into the mapped file; compressed ones are decoded into a buffer owned by the given frame.
+@param inputFrameIndex: Which frame to read
+@param inputFrameBuffer: Where to store the frame and its recorded detections
+
+@exceptions: This function can throw exceptions
+*/
+void getFrame(int inputFrameIndex, QRCodeRecordedFrame &inputFrameBuffer) const;
+
+/*
+This destructor unmaps the file.
+*/
+~QRCodeFrameRecording();
+
+private:
+QRCodeFrameRecording(const QRCodeFrameRecording &inputQRCodeFrameRecording) = delete; //Disable copying of the object
+
+/*
+This function checks that a frame chunk starting at the given offset fits in the file and returns the offset just past it.
+@param inputOffset: The offset of the chunk
+@return: The offset of the next chunk, or 0 if the chunk is invalid or truncated
+*/
+uint64_t validateChunk(uint64_t inputOffset) const;
+
+const uint8_t *fileData;
+uint64_t fileSize;
+std::vector<uint64_t> frameOffsets;
+};
+
+/*
+This struct summarizes a replay.
+*/
+struct QRCodeReplaySummary
+{
+int numberOfFramesReplayed;
+int numberOfMismatchedFrames; //Frames where the number of detections, identifiers, dimensions or poses differed from the recording
+double largestPoseDifference; //Largest absolute difference of any pose element
+double totalEstimationSeconds; //Time spent inside the estimator
+};
+
+/*
+This function streams every frame of a recording through a state estimator and compares the results with what was recorded.
+@param inputRecording: The recording to replay
+@param inputEstimator: The estimator to replay the frames through (it should use the same calibration as when the recording was made)
+@param inputPlayAtRecordedSpeed: True to wait between frames so they are given at the rate they were captured, false to run as fast as possible
+@param inputPoseTolerance: The largest difference in any pose element that is still considered a match
+@param inputSummaryBuffer: The buffer to store the replay summary in
+@return: true if every frame matched the recording and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool replayFrameRecording(const QRCodeFrameRecording &inputRecording, QRCodeStateEstimator &inputEstimator, bool inputPlayAtRecordedSpeed, double inputPoseTolerance, QRCodeReplaySummary &inputSummaryBuffer);
+
+/*
+This function delta and run length codes an image.  The output is only useful if it is smaller than the input.
+@param inputData: The image rows (packed, no stride)
+@param inputRowLength: The number of bytes per row
+@param inputNumberOfRows: The number of rows
+@param inputOutputBuffer: The buffer to store the coded bytes in
+*/
+void compressFrameData(const uint8_t *inputData, uint64_t inputRowLength, uint64_t inputNumberOfRows, std::vector<uint8_t> &inputOutputBuffer);
+
+/*
+This function reverses compressFrameData.
+@param inputData: The coded bytes
+@param inputSize: The number of coded bytes
+@param inputRowLength: The number of bytes per row
+@param inputNumberOfRows: The number of rows
+@param inputOutputBuffer: Where to write the decoded rows (inputRowLength * inputNumberOfRows bytes)
+@return: true if the data decoded to exactly the expected size and false if it is corrupt
+*/
+bool decompressFrameData(const uint8_t *inputData, uint64_t inputSize, uint64_t inputRowLength, uint64_t inputNumberOfRows, uint8_t *inputOutputBuffer);
+
+#endif
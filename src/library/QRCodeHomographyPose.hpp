@@ -0,0 +1,97 @@
+#ifndef QRCODEHOMOGRAPHYPOSEHPP
+#define QRCODEHOMOGRAPHYPOSEHPP
+
+#include<cmath>
+#include<limits>
+
+/*
+This function finds the pose of a square tag relative to the camera in closed form.  The homography from the square to its quad (Heckbert's square to quad mapping) is decomposed into a rotation and translation, and the rotation is orthonormalized.  It is shared by QRCodePoseCore (one tag at a time) and QRCodeBatchPoseSolver (inlined into a loop over many tags), so every check is a select between values that have already been computed: there is no control flow to stop the loop from vectorizing, and degenerate quads go through the math with harmless stand in values and are only marked invalid at the end.  Validity is returned as 1 or 0 in ScalarType rather than as a bool, since SSE2 has no way to narrow double compare masks.
+@param inputCornerX: The x coordinates of the 4 undistorted corners in normalized image coordinates (in zbar order)
+@param inputCornerY: The y coordinates of the 4 corners
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputRotationColumnsBuffer: The buffer to store the columns of the rotation (tag -> camera) in, one after the other (which is the camera pose's rotation in row major order)
+@param inputTranslationBuffer: The buffer to store the position of the tag center in camera coordinates in
+@return: 1 if the quad described a tag in front of the camera and 0 otherwise
+*/
+template<typename ScalarType>
+inline ScalarType computeHomographyTagPose(const ScalarType (&inputCornerX)[4], const ScalarType (&inputCornerY)[4], ScalarType inputQRCodeDimension, ScalarType (&inputRotationColumnsBuffer)[9], ScalarType (&inputTranslationBuffer)[3])
+{
+const ScalarType tinyValue = std::numeric_limits<ScalarType>::epsilon() * std::numeric_limits<ScalarType>::epsilon();
+const ScalarType zero = ScalarType(0);
+const ScalarType one = ScalarType(1);
+const ScalarType *x = inputCornerX;
+const ScalarType *y = inputCornerY;
+
+//Homography from the unit square to the quad: (0,0)->0, (1,0)->1, (1,1)->2, (0,1)->3
+ScalarType sumX = x[0] - x[1] + x[2] - x[3];
+ScalarType sumY = y[0] - y[1] + y[2] - y[3];
+ScalarType dx1 = x[1] - x[2];
+ScalarType dx2 = x[3] - x[2];
+ScalarType dy1 = y[1] - y[2];
+ScalarType dy2 = y[3] - y[2];
+ScalarType denominator = dx1*dy2 - dx2*dy1;
+ScalarType validity = std::fabs(denominator) > tinyValue ? one : zero;
+validity = inputQRCodeDimension > zero ? validity : zero;
+denominator = validity != zero ? denominator : one;
+ScalarType dimension = validity != zero ? inputQRCodeDimension : one;
+
+ScalarType g = (sumX*dy2 - dx2*sumY) / denominator;
+ScalarType h = (dx1*sumY - sumX*dy1) / denominator;
+ScalarType a = x[1] - x[0] + g*x[1];
+ScalarType b = x[3] - x[0] + h*x[3];
+ScalarType c = x[0];
+ScalarType d = y[1] - y[0] + g*y[1];
+ScalarType e = y[3] - y[0] + h*y[3];
+ScalarType f = y[0];
+
+//Change to tag coordinates (corners at +-dimension/2), giving columns proportional to [r1 r2 t]
+ScalarType inverseDimension = one / dimension;
+ScalarType h1x = a*inverseDimension, h1y = d*inverseDimension, h1z = g*inverseDimension;
+ScalarType h2x = b*inverseDimension, h2y = e*inverseDimension, h2z = h*inverseDimension;
+ScalarType h3x = ScalarType(.5)*(a + b) + c, h3y = ScalarType(.5)*(d + e) + f, h3z = ScalarType(.5)*(g + h) + one;
+
+ScalarType norm1 = std::sqrt(h1x*h1x + h1y*h1y + h1z*h1z);
+ScalarType norm2 = std::sqrt(h2x*h2x + h2y*h2y + h2z*h2z);
+validity = norm1 > tinyValue ? validity : zero;
+validity = norm2 > tinyValue ? validity : zero;
+norm1 = validity != zero ? norm1 : one;
+norm2 = validity != zero ? norm2 : one;
+
+//The tag has to be in front of the camera
+ScalarType sign = h3z < zero ? -one : one;
+ScalarType scale = sign * ScalarType(2) / (norm1 + norm2);
+
+//Normalize the first two rotation columns, then make them orthogonal by spreading the error evenly between them
+ScalarType r1x = h1x*sign/norm1, r1y = h1y*sign/norm1, r1z = h1z*sign/norm1;
+ScalarType r2x = h2x*sign/norm2, r2y = h2y*sign/norm2, r2z = h2z*sign/norm2;
+ScalarType sumRx = r1x + r2x, sumRy = r1y + r2y, sumRz = r1z + r2z;
+ScalarType differenceRx = r1x - r2x, differenceRy = r1y - r2y, differenceRz = r1z - r2z;
+ScalarType sumNorm = std::sqrt(sumRx*sumRx + sumRy*sumRy + sumRz*sumRz);
+ScalarType differenceNorm = std::sqrt(differenceRx*differenceRx + differenceRy*differenceRy + differenceRz*differenceRz);
+validity = sumNorm > tinyValue ? validity : zero;
+validity = differenceNorm > tinyValue ? validity : zero;
+sumNorm = validity != zero ? sumNorm : one;
+differenceNorm = validity != zero ? differenceNorm : one;
+sumNorm = sumNorm * ScalarType(M_SQRT2);
+differenceNorm = differenceNorm * ScalarType(M_SQRT2);
+
+r1x = sumRx/sumNorm + differenceRx/differenceNorm;
+r1y = sumRy/sumNorm + differenceRy/differenceNorm;
+r1z = sumRz/sumNorm + differenceRz/differenceNorm;
+r2x = sumRx/sumNorm - differenceRx/differenceNorm;
+r2y = sumRy/sumNorm - differenceRy/differenceNorm;
+r2z = sumRz/sumNorm - differenceRz/differenceNorm;
+
+inputRotationColumnsBuffer[0] = r1x; inputRotationColumnsBuffer[1] = r1y; inputRotationColumnsBuffer[2] = r1z;
+inputRotationColumnsBuffer[3] = r2x; inputRotationColumnsBuffer[4] = r2y; inputRotationColumnsBuffer[5] = r2z;
+inputRotationColumnsBuffer[6] = r1y*r2z - r1z*r2y;
+inputRotationColumnsBuffer[7] = r1z*r2x - r1x*r2z;
+inputRotationColumnsBuffer[8] = r1x*r2y - r1y*r2x;
+inputTranslationBuffer[0] = h3x*scale;
+inputTranslationBuffer[1] = h3y*scale;
+inputTranslationBuffer[2] = h3z*scale;
+
+return inputTranslationBuffer[2] > zero ? validity : zero;
+}
+
+#endif
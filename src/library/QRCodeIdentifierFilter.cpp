@@ -0,0 +1,142 @@
+#include "QRCodeIdentifierFilter.hpp"
+
+#include<cstring>
+#include<algorithm>
+
+/*
+This function initializes the filter with no rules and no limit on the number of poses.
+*/
+QRCodeIdentifierFilter::QRCodeIdentifierFilter() : maximumNumberOfPosesPerFrame(0)
+{
+}
+
+/*
+This function allows an identifier that matches exactly.
+@param inputIdentifier: The identifier to allow
+@param inputPriority: The priority of the identifier (higher is more important)
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeIdentifierFilter::addExactIdentifier(const std::string &inputIdentifier, int inputPriority)
+{
+uint64_t identifierHash = hashQRCodeIdentifier(inputIdentifier);
+auto ruleIterator = exactIdentifierRules.find(identifierHash);
+if(ruleIterator == exactIdentifierRules.end())
+{
+QRCodeIdentifierRule rule;
+rule.identifier = inputIdentifier;
+rule.priority = inputPriority;
+exactIdentifierRules[identifierHash] = rule;
+return;
+}
+
+if(ruleIterator->second.identifier != inputIdentifier)
+{
+throw SOMException(std::string("Identifier ") + inputIdentifier + " has the same hash as " + ruleIterator->second.identifier + " (allow one of them by prefix instead)\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+ruleIterator->second.priority = inputPriority;
+}
+
+/*
+This function allows every identifier that starts with the given text.
+@param inputIdentifierPrefix: The prefix to allow
+@param inputPriority: The priority of the identifiers (higher is more important)
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeIdentifierFilter::addIdentifierPrefix(const std::string &inputIdentifierPrefix, int inputPriority)
+{
+for(QRCodeIdentifierRule &rule : identifierPrefixRules)
+{
+if(rule.identifier == inputIdentifierPrefix)
+{
+rule.priority = inputPriority;
+return;
+}
+}
+
+QRCodeIdentifierRule rule;
+rule.identifier = inputIdentifierPrefix;
+rule.priority = inputPriority;
+identifierPrefixRules.push_back(rule);
+}
+
+/*
+This function allows any identifier with the given hash.
+@param inputIdentifierHash: The hashQRCodeIdentifier() value of the identifier to allow
+@param inputPriority: The priority of the identifier (higher is more important)
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeIdentifierFilter::addIdentifierHash(uint64_t inputIdentifierHash, int inputPriority)
+{
+identifierHashPriorities[inputIdentifierHash] = inputPriority;
+}
+
+/*
+This function removes all of the rules, so that everything is allowed again.  The pose limit is left alone.
+*/
+void QRCodeIdentifierFilter::clear()
+{
+exactIdentifierRules.clear();
+identifierPrefixRules.clear();
+identifierHashPriorities.clear();
+}
+
+/*
+This function returns true if the filter has any rules.
+@return: true if identifiers which match no rule are rejected
+*/
+bool QRCodeIdentifierFilter::hasRules() const
+{
+return exactIdentifierRules.size() > 0 || identifierPrefixRules.size() > 0 || identifierHashPriorities.size() > 0;
+}
+
+/*
+This function checks an identifier against the rules.
+@param inputIdentifier: The identifier text (does not need to be null terminated)
+@param inputIdentifierLength: The number of bytes in the identifier
+@param inputIdentifierHash: The hashQRCodeIdentifier() value of the identifier
+@param inputPriorityBuffer: The buffer to store the priority of the identifier in
+@return: true if the identifier is allowed and false otherwise
+*/
+bool QRCodeIdentifierFilter::checkIdentifier(const char *inputIdentifier, size_t inputIdentifierLength, uint64_t inputIdentifierHash, int &inputPriorityBuffer) const noexcept
+{
+inputPriorityBuffer = 0;
+if(!hasRules())
+{
+return true;
+}
+
+bool isAllowed = false;
+
+auto exactRuleIterator = exactIdentifierRules.find(inputIdentifierHash);
+if(exactRuleIterator != exactIdentifierRules.end())
+{
+const std::string &ruleIdentifier = exactRuleIterator->second.identifier;
+if(ruleIdentifier.size() == inputIdentifierLength && memcmp(ruleIdentifier.data(), inputIdentifier, inputIdentifierLength) == 0)
+{
+inputPriorityBuffer = exactRuleIterator->second.priority;
+isAllowed = true;
+}
+}
+
+auto hashIterator = identifierHashPriorities.find(inputIdentifierHash);
+if(hashIterator != identifierHashPriorities.end())
+{
+inputPriorityBuffer = isAllowed ? std::max(inputPriorityBuffer, hashIterator->second) : hashIterator->second;
+isAllowed = true;
+}
+
+for(const QRCodeIdentifierRule &rule : identifierPrefixRules)
+{
+if(rule.identifier.size() <= inputIdentifierLength && memcmp(rule.identifier.data(), inputIdentifier, rule.identifier.size()) == 0)
+{
+inputPriorityBuffer = isAllowed ? std::max(inputPriorityBuffer, rule.priority) : rule.priority;
+isAllowed = true;
+}
+}
+
+return isAllowed;
+}
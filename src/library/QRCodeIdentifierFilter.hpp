@@ -0,0 +1,89 @@
+#ifndef QRCODEIDENTIFIERFILTERHPP
+#define QRCODEIDENTIFIERFILTERHPP
+
+#include<string>
+#include<vector>
+#include<unordered_map>
+#include<cstdint>
+#include<cstddef>
+
+#include "SOMException.hpp"
+#include "QRCodeIdentifierHash.hpp"
+
+/*
+This struct holds one identifier (or identifier prefix) allowed by a QRCodeIdentifierFilter.
+*/
+struct QRCodeIdentifierRule
+{
+std::string identifier;
+int priority;
+};
+
+/*
+This class decides which QR codes an estimator spends pose work on.  Identifiers can be allowed exactly, by prefix (such as "cell3-") or by hashQRCodeIdentifier() value (so a large set can be shipped without the identifiers themselves), each with a priority.  A filter without any rules allows everything at priority 0.  Once a rule has been added, identifiers which match no rule are rejected, and an identifier matching more than one rule gets the highest of their priorities.  Checking an identifier does not allocate memory or throw exceptions.
+*/
+class QRCodeIdentifierFilter
+{
+public:
+/*
+This function initializes the filter with no rules and no limit on the number of poses.
+*/
+QRCodeIdentifierFilter();
+
+/*
+This function allows an identifier that matches exactly.
+@param inputIdentifier: The identifier to allow
+@param inputPriority: The priority of the identifier (higher is more important)
+
+@exceptions: This function can throw exceptions
+*/
+void addExactIdentifier(const std::string &inputIdentifier, int inputPriority = 0);
+
+/*
+This function allows every identifier that starts with the given text.
+@param inputIdentifierPrefix: The prefix to allow
+@param inputPriority: The priority of the identifiers (higher is more important)
+
+@exceptions: This function can throw exceptions
+*/
+void addIdentifierPrefix(const std::string &inputIdentifierPrefix, int inputPriority = 0);
+
+/*
+This function allows any identifier with the given hash.
+@param inputIdentifierHash: The hashQRCodeIdentifier() value of the identifier to allow
+@param inputPriority: The priority of the identifier (higher is more important)
+
+@exceptions: This function can throw exceptions
+*/
+void addIdentifierHash(uint64_t inputIdentifierHash, int inputPriority = 0);
+
+/*
+This function removes all of the rules, so that everything is allowed again.  The pose limit is left alone.
+*/
+void clear();
+
+/*
+This function returns true if the filter has any rules.
+@return: true if identifiers which match no rule are rejected
+*/
+bool hasRules() const;
+
+/*
+This function checks an identifier against the rules.
+@param inputIdentifier: The identifier text (does not need to be null terminated)
+@param inputIdentifierLength: The number of bytes in the identifier
+@param inputIdentifierHash: The hashQRCodeIdentifier() value of the identifier
+@param inputPriorityBuffer: The buffer to store the priority of the identifier in
+@return: true if the identifier is allowed and false otherwise
+*/
+bool checkIdentifier(const char *inputIdentifier, size_t inputIdentifierLength, uint64_t inputIdentifierHash, int &inputPriorityBuffer) const noexcept;
+
+int maximumNumberOfPosesPerFrame; //The most tags per frame that get their pose solved (the highest priority ones are kept), 0 for no limit
+
+private:
+std::unordered_map<uint64_t, QRCodeIdentifierRule> exactIdentifierRules; //Keyed by the hash of the identifier
+std::vector<QRCodeIdentifierRule> identifierPrefixRules;
+std::unordered_map<uint64_t, int> identifierHashPriorities;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef QRCODEIDENTIFIERHASHHPP
+#define QRCODEIDENTIFIERHASHHPP
+
+#include<string>
+#include<cstdint>
+#include<cstddef>
+
+/*
+This function computes the 64 bit FNV-1a hash of a block of text.  It is used wherever a QR code identifier or payload needs to be referred to by a fixed size value (shared memory records, caches, filters), so it must stay stable between releases.
+@param inputData: The text to hash
+@param inputLength: The number of bytes of text
+@return: The hash value
+*/
+inline uint64_t hashQRCodeIdentifier(const char *inputData, size_t inputLength)
+{
+uint64_t hash = 14695981039346656037ULL;
+for(size_t i=0; i < inputLength; i++)
+{
+hash ^= (unsigned char) inputData[i];
+hash *= 1099511628211ULL;
+}
+return hash;
+}
+
+/*
+This function computes the 64 bit FNV-1a hash of a QR code identifier.
+@param inputIdentifier: The identifier to hash
+@return: The hash value
+*/
+inline uint64_t hashQRCodeIdentifier(const std::string &inputIdentifier)
+{
+return hashQRCodeIdentifier(inputIdentifier.data(), inputIdentifier.size());
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "QRCodeLatencyTrace.hpp"
+
+#include<cstdio>
+#include<cstring>
+#include<cerrno>
+#include<chrono>
+#include<set>
+#include<algorithm>
+
+#include "SOMScopeGuard.hpp"
+
+/*
+This function returns the current time in nanoseconds on the monotonic clock, which is the clock all of the frame timestamps use.  Capture timestamps given to the estimators should come from it (or from a camera driver using CLOCK_MONOTONIC).
+@return: The current time in nanoseconds
+*/
+int64_t getQRCodeTimestamp()
+{
+return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+This function initializes the tracer.
+@param inputMaximumNumberOfFrames: The number of most recent frames to keep
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeLatencyTracer::QRCodeLatencyTracer(int inputMaximumNumberOfFrames) : numberOfEntriesAdded(0), numberOfFramesRecorded(0), numberOfDroppedFrames(0)
+{
+if(inputMaximumNumberOfFrames <= 0)
+{
+throw SOMException(std::string("Latency trace capacity must be positive\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+entries.resize(inputMaximumNumberOfFrames);
+}
+
+/*
+This function adds a processed frame to the trace.
+@param inputFrameTimestamps: The timestamps of the frame
+@param inputTrackIndex: Which camera/thread the frame belonged to
+*/
+void QRCodeLatencyTracer::recordFrame(const QRCodeFrameTimestamps &inputFrameTimestamps, int inputTrackIndex) noexcept
+{
+QRCodeLatencyTraceEntry entry;
+entry.frameTimestamps = inputFrameTimestamps;
+entry.trackIndex = inputTrackIndex;
+entry.frameWasDropped = false;
+addEntry(entry);
+}
+
+/*
+This function adds a frame that was captured but never processed (such as when a queue was full) to the trace.
+@param inputCaptureTimestamp: When the frame was captured
+@param inputTrackIndex: Which camera/thread the frame belonged to
+*/
+void QRCodeLatencyTracer::recordDroppedFrame(int64_t inputCaptureTimestamp, int inputTrackIndex) noexcept
+{
+QRCodeLatencyTraceEntry entry;
+entry.frameTimestamps.captureTimestamp = inputCaptureTimestamp;
+entry.trackIndex = inputTrackIndex;
+entry.frameWasDropped = true;
+addEntry(entry);
+}
+
+/*
+This function stores an entry in the ring.
+@param inputEntry: The entry to store
+*/
+void QRCodeLatencyTracer::addEntry(const QRCodeLatencyTraceEntry &inputEntry) noexcept
+{
+try
+{
+std::lock_guard<std::mutex> lock(entriesMutex);
+entries[numberOfEntriesAdded % entries.size()] = inputEntry;
+numberOfEntriesAdded++;
+if(inputEntry.frameWasDropped)
+{
+numberOfDroppedFrames++;
+}
+else
+{
+numberOfFramesRecorded++;
+}
+}
+catch(...)
+{
+//Tracing is best effort and must never break estimation
+}
+}
+
+/*
+This function writes one complete ("X") event if the stage has both ends.
+@param inputFile: The file to write to
+@param inputIsFirstEvent: True until the first event has been written (used for the commas), updated by this function
+@param inputName: The name of the stage
+@param inputStartTimestamp: When the stage started (0 if unknown)
+@param inputEndTimestamp: When the stage finished (0 if unknown)
+@param inputTimestampOrigin: The timestamp that becomes 0 in the trace
+@param inputEntry: The frame the stage belongs to
+*/
+static void writeChromeTraceStage(FILE *inputFile, bool &inputIsFirstEvent, const char *inputName, int64_t inputStartTimestamp, int64_t inputEndTimestamp, int64_t inputTimestampOrigin, const QRCodeLatencyTraceEntry &inputEntry)
+{
+if(inputStartTimestamp == 0 || inputEndTimestamp == 0 || inputEndTimestamp <= inputStartTimestamp)
+{
+return;
+}
+
+fprintf(inputFile, "%s\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu,\"detections\":%d,\"status\":%d}}", inputIsFirstEvent ? "" : ",", inputName, inputEntry.trackIndex, (inputStartTimestamp - inputTimestampOrigin) / 1000.0, (inputEndTimestamp - inputStartTimestamp) / 1000.0, (unsigned long long) inputEntry.frameTimestamps.frameNumber, inputEntry.frameTimestamps.numberOfDetections, inputEntry.frameTimestamps.status);
+inputIsFirstEvent = false;
+}
+
+/*
+This function writes the frames currently held by the tracer to a Chrome trace event JSON file.
+@param inputFilePath: The file to write
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodeLatencyTracer::exportChromeTrace(const std::string &inputFilePath)
+{
+//Copy the ring (oldest first) so the estimators aren't held up while the file is written
+std::vector<QRCodeLatencyTraceEntry> entriesToWrite;
+{
+std::lock_guard<std::mutex> lock(entriesMutex);
+uint64_t numberOfEntries = std::min<uint64_t>(numberOfEntriesAdded, entries.size());
+for(uint64_t i = numberOfEntriesAdded - numberOfEntries; i < numberOfEntriesAdded; i++)
+{
+entriesToWrite.push_back(entries[i % entries.size()]);
+}
+}
+
+//Trace times are microseconds from the earliest timestamp
+int64_t timestampOrigin = 0;
+std::set<int> trackIndices;
+for(const QRCodeLatencyTraceEntry &entry : entriesToWrite)
+{
+int64_t firstTimestamp = entry.frameTimestamps.captureTimestamp != 0 ? entry.frameTimestamps.captureTimestamp : entry.frameTimestamps.estimationStartTimestamp;
+if(firstTimestamp != 0 && (timestampOrigin == 0 || firstTimestamp < timestampOrigin))
+{
+timestampOrigin = firstTimestamp;
+}
+trackIndices.insert(entry.trackIndex);
+}
+
+FILE *traceFile = fopen(inputFilePath.c_str(), "w");
+if(traceFile == NULL)
+{
+throw SOMException(std::string("Unable to open trace file ") + inputFilePath + ": " + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+SOMScopeGuard traceFileGuard([&](){if(traceFile != NULL) fclose(traceFile);});
+
+bool isFirstEvent = true;
+fprintf(traceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+for(int trackIndex : trackIndices)
+{
+fprintf(traceFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"camera %d\"}}", isFirstEvent ? "" : ",", trackIndex, trackIndex);
+isFirstEvent = false;
+}
+
+for(const QRCodeLatencyTraceEntry &entry : entriesToWrite)
+{
+const QRCodeFrameTimestamps &timestamps = entry.frameTimestamps;
+if(entry.frameWasDropped)
+{
+if(timestamps.captureTimestamp != 0)
+{
+fprintf(traceFile, "%s\n{\"name\":\"dropped\",\"cat\":\"frame\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", isFirstEvent ? "" : ",", entry.trackIndex, (timestamps.captureTimestamp - timestampOrigin) / 1000.0);
+isFirstEvent = false;
+}
+continue;
+}
+
+writeChromeTraceStage(traceFile, isFirstEvent, "queued", timestamps.captureTimestamp, timestamps.estimationStartTimestamp, timestampOrigin, entry);
+writeChromeTraceStage(traceFile, isFirstEvent, "grayscale", timestamps.estimationStartTimestamp, timestamps.grayscaleConversionFinishedTimestamp, timestampOrigin, entry);
+writeChromeTraceStage(traceFile, isFirstEvent, "scan", timestamps.grayscaleConversionFinishedTimestamp, timestamps.scanFinishedTimestamp, timestampOrigin, entry);
+writeChromeTraceStage(traceFile, isFirstEvent, "solve", timestamps.scanFinishedTimestamp, timestamps.poseSolveFinishedTimestamp, timestampOrigin, entry);
+writeChromeTraceStage(traceFile, isFirstEvent, "results", timestamps.poseSolveFinishedTimestamp != 0 ? timestamps.poseSolveFinishedTimestamp : timestamps.grayscaleConversionFinishedTimestamp, timestamps.estimationFinishedTimestamp, timestampOrigin, entry);
+writeChromeTraceStage(traceFile, isFirstEvent, "publish", timestamps.estimationFinishedTimestamp, timestamps.publishTimestamp, timestampOrigin, entry);
+}
+
+fprintf(traceFile, "\n]}\n");
+
+bool writeFailed = ferror(traceFile) != 0;
+int closeResult = fclose(traceFile);
+traceFile = NULL;
+if(writeFailed || closeResult != 0)
+{
+throw SOMException(std::string("Error writing trace file ") + inputFilePath + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+/*
+This function returns how many processed frames have been recorded since the tracer was made (including ones that have since been overwritten).
+@return: The number of frames
+*/
+uint64_t QRCodeLatencyTracer::getNumberOfFramesRecorded()
+{
+std::lock_guard<std::mutex> lock(entriesMutex);
+return numberOfFramesRecorded;
+}
+
+/*
+This function returns how many dropped frames have been recorded since the tracer was made.
+@return: The number of dropped frames
+*/
+uint64_t QRCodeLatencyTracer::getNumberOfDroppedFrames()
+{
+std::lock_guard<std::mutex> lock(entriesMutex);
+return numberOfDroppedFrames;
+}
@@ -0,0 +1,111 @@
+#ifndef QRCODELATENCYTRACEHPP
+#define QRCODELATENCYTRACEHPP
+
+#include<cstdint>
+#include<string>
+#include<vector>
+#include<mutex>
+
+#include "SOMException.hpp"
+
+//Declare handy constants
+static constexpr int QRCodeDefaultLatencyTraceCapacity = 100000; //Number of frames kept by default (the oldest are overwritten)
+
+/*
+This function returns the current time in nanoseconds on the monotonic clock, which is the clock all of the frame timestamps use.  Capture timestamps given to the estimators should come from it (or from a camera driver using CLOCK_MONOTONIC).
+@return: The current time in nanoseconds
+*/
+int64_t getQRCodeTimestamp();
+
+/*
+This struct follows one frame through the estimator.  The caller fills in captureTimestamp (and publishTimestamp once the poses have been handed on) and the estimator stamps each stage boundary as the frame passes it.  Stages that were not reached (such as the scan for an invalid frame) are left at 0.
+*/
+struct QRCodeFrameTimestamps
+{
+int64_t captureTimestamp = 0; //When the frame was captured (0 if unknown)
+int64_t estimationStartTimestamp = 0; //When the estimator was given the frame
+int64_t grayscaleConversionFinishedTimestamp = 0; //When the BGR to grayscale conversion finished (the start time for grayscale frames)
+int64_t scanFinishedTimestamp = 0; //When zbar finished and the payloads had been parsed
+int64_t poseSolveFinishedTimestamp = 0; //When the tag poses had been solved
+int64_t estimationFinishedTimestamp = 0; //When the results were ready for the caller
+int64_t publishTimestamp = 0; //When the caller handed the poses on (0 if it didn't say)
+uint64_t frameNumber = 0; //Number of frames the estimator had processed before this one
+int numberOfDetections = 0;
+int status = 0; //The QRCodeEstimationStatus of the frame
+};
+
+/*
+This struct is one entry in the latency trace.
+*/
+struct QRCodeLatencyTraceEntry
+{
+QRCodeFrameTimestamps frameTimestamps;
+int trackIndex; //Which camera/thread the frame belonged to
+bool frameWasDropped; //True if the frame was never given to an estimator (only captureTimestamp is valid)
+};
+
+/*
+This class collects the timestamps of recent frames from any number of estimators (it is thread safe) and writes them out as a Chrome trace (load it in chrome://tracing or ui.perfetto.dev).  Each track shows one bar per stage of each frame: the queueing delay from capture to estimation, the grayscale conversion, the scan, the pose solve, building the results and the delay until the poses were published.  Dropped frames are shown as instant events.  The entries are kept in a fixed size ring, so recording never allocates memory.
+*/
+class QRCodeLatencyTracer
+{
+public:
+/*
+This function initializes the tracer.
+@param inputMaximumNumberOfFrames: The number of most recent frames to keep
+
+@exceptions: This function can throw exceptions
+*/
+QRCodeLatencyTracer(int inputMaximumNumberOfFrames = QRCodeDefaultLatencyTraceCapacity);
+
+/*
+This function adds a processed frame to the trace.
+@param inputFrameTimestamps: The timestamps of the frame
+@param inputTrackIndex: Which camera/thread the frame belonged to
+*/
+void recordFrame(const QRCodeFrameTimestamps &inputFrameTimestamps, int inputTrackIndex) noexcept;
+
+/*
+This function adds a frame that was captured but never processed (such as when a queue was full) to the trace.
+@param inputCaptureTimestamp: When the frame was captured
+@param inputTrackIndex: Which camera/thread the frame belonged to
+*/
+void recordDroppedFrame(int64_t inputCaptureTimestamp, int inputTrackIndex) noexcept;
+
+/*
+This function writes the frames currently held by the tracer to a Chrome trace event JSON file.
+@param inputFilePath: The file to write
+
+@exceptions: This function can throw exceptions
+*/
+void exportChromeTrace(const std::string &inputFilePath);
+
+/*
+This function returns how many processed frames have been recorded since the tracer was made (including ones that have since been overwritten).
+@return: The number of frames
+*/
+uint64_t getNumberOfFramesRecorded();
+
+/*
+This function returns how many dropped frames have been recorded since the tracer was made.
+@return: The number of dropped frames
+*/
+uint64_t getNumberOfDroppedFrames();
+
+private:
+QRCodeLatencyTracer(const QRCodeLatencyTracer &inputQRCodeLatencyTracer) = delete; //Disable copying of the object
+
+/*
+This function stores an entry in the ring.
+@param inputEntry: The entry to store
+*/
+void addEntry(const QRCodeLatencyTraceEntry &inputEntry) noexcept;
+
+std::mutex entriesMutex;
+std::vector<QRCodeLatencyTraceEntry> entries;
+uint64_t numberOfEntriesAdded;
+uint64_t numberOfFramesRecorded;
+uint64_t numberOfDroppedFrames;
+};
+
+#endif
@@ -0,0 +1,458 @@
+#include "QRCodePayloadParser.hpp"
+
+#include<cmath>
+#include<cstring>
+
+//Powers of ten that are exactly representable as doubles
+static const double exactPowersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/*
+This function converts an ASCII letter to lower case and leaves everything else alone.
+@param inputCharacter: The character to convert
+@return: The converted character
+*/
+static inline char asciiToLower(char inputCharacter)
+{
+return (inputCharacter >= 'A' && inputCharacter <= 'Z') ? inputCharacter + ('a' - 'A') : inputCharacter;
+}
+
+/*
+This function checks if a character is a decimal digit.
+@param inputCharacter: The character to check
+@return: true if it is '0' through '9'
+*/
+static inline bool isDecimalDigit(char inputCharacter)
+{
+return inputCharacter >= '0' && inputCharacter <= '9';
+}
+
+/*
+This function moves a position past any spaces or tabs.
+@param inputData: The text
+@param inputLength: The length of the text
+@param inputPosition: The position to advance
+*/
+static inline void skipSpaces(const char *inputData, size_t inputLength, size_t &inputPosition)
+{
+while(inputPosition < inputLength && (inputData[inputPosition] == ' ' || inputData[inputPosition] == '\t'))
+{
+inputPosition++;
+}
+}
+
+/*
+This function parses a decimal number (optional sign, digits with an optional decimal point and an optional exponent) starting at a position, and moves the position past it.
+@param inputData: The text
+@param inputLength: The length of the text
+@param inputPosition: Where the number starts (moved to just past it if successful)
+@param inputNumberBuffer: The buffer to store the number in
+@return: true if there was a finite number at the position
+*/
+static bool parseDecimalNumber(const char *inputData, size_t inputLength, size_t &inputPosition, double &inputNumberBuffer)
+{
+size_t position = inputPosition;
+bool isNegative = false;
+if(position < inputLength && (inputData[position] == '+' || inputData[position] == '-'))
+{
+isNegative = inputData[position] == '-';
+position++;
+}
+
+uint64_t mantissa = 0;
+int exponent = 0;
+bool foundDigit = false;
+
+//Digits past the 18th cannot change a double, so they only move the exponent
+while(position < inputLength && isDecimalDigit(inputData[position]))
+{
+if(mantissa < 100000000000000000ULL)
+{
+mantissa = mantissa * 10 + (inputData[position] - '0');
+}
+else
+{
+exponent++;
+}
+foundDigit = true;
+position++;
+}
+
+if(position < inputLength && inputData[position] == '.')
+{
+position++;
+while(position < inputLength && isDecimalDigit(inputData[position]))
+{
+if(mantissa < 100000000000000000ULL)
+{
+mantissa = mantissa * 10 + (inputData[position] - '0');
+exponent--;
+}
+foundDigit = true;
+position++;
+}
+}
+
+if(!foundDigit)
+{
+return false;
+}
+
+//Only treat an 'e' as an exponent if digits follow it
+if(position < inputLength && (inputData[position] == 'e' || inputData[position] == 'E'))
+{
+size_t exponentPosition = position + 1;
+bool exponentIsNegative = false;
+if(exponentPosition < inputLength && (inputData[exponentPosition] == '+' || inputData[exponentPosition] == '-'))
+{
+exponentIsNegative = inputData[exponentPosition] == '-';
+exponentPosition++;
+}
+
+if(exponentPosition < inputLength && isDecimalDigit(inputData[exponentPosition]))
+{
+int explicitExponent = 0;
+while(exponentPosition < inputLength && isDecimalDigit(inputData[exponentPosition]))
+{
+if(explicitExponent < 10000)
+{
+explicitExponent = explicitExponent * 10 + (inputData[exponentPosition] - '0');
+}
+exponentPosition++;
+}
+exponent += exponentIsNegative ? -explicitExponent : explicitExponent;
+position = exponentPosition;
+}
+}
+
+double value = (double) mantissa;
+if(exponent >= 0 && exponent <= 22)
+{
+value *= exactPowersOfTen[exponent];
+}
+else if(exponent < 0 && exponent >= -22)
+{
+value /= exactPowersOfTen[-exponent];
+}
+else
+{
+value *= std::pow(10.0, (double) exponent);
+}
+
+if(!std::isfinite(value))
+{
+return false;
+}
+
+inputNumberBuffer = isNegative ? -value : value;
+inputPosition = position;
+return true;
+}
+
+/*
+This function parses a dimension with a unit suffix (such as "6.5in") starting at a position, and moves the position past the unit.
+@param inputData: The text
+@param inputLength: The length of the text
+@param inputPosition: Where the dimension starts (moved to just past the unit if successful)
+@param inputDimensionBuffer: The buffer to store the dimension in meters in
+@return: true if there was a positive dimension with a known unit at the position
+*/
+static bool parseDimensionWithUnit(const char *inputData, size_t inputLength, size_t &inputPosition, double &inputDimensionBuffer)
+{
+size_t position = inputPosition;
+skipSpaces(inputData, inputLength, position);
+
+double dimensionInOriginalUnits;
+if(!parseDecimalNumber(inputData, inputLength, position, dimensionInOriginalUnits))
+{
+return false;
+}
+skipSpaces(inputData, inputLength, position);
+
+for(int unitIndex = 0; unitIndex < QRCodeNumberOfUnitIdentifiers; unitIndex++)
+{
+const QRCodeUnitIdentifier &unit = QRCodeUnitIdentifiers[unitIndex];
+if(inputLength - position < unit.length)
+{
+continue;
+}
+
+bool unitMatches = true;
+for(size_t i=0; i < unit.length; i++)
+{
+if(asciiToLower(inputData[position + i]) != unit.text[i])
+{
+unitMatches = false;
+break;
+}
+}
+
+if(unitMatches)
+{
+double dimensionInMeters = dimensionInOriginalUnits * unit.metersPerUnit;
+if(!(dimensionInMeters > 0.0))
+{
+return false;
+}
+
+inputDimensionBuffer = dimensionInMeters;
+inputPosition = position + unit.length;
+return true;
+}
+}
+
+return false;
+}
+
+/*
+This function compares a key from a key/value payload with a lower case name, ignoring case.
+@param inputData: The payload text
+@param inputKeyStart: Where the key starts
+@param inputKeyLength: The length of the key
+@param inputName: The lower case name to compare with
+@return: true if they are the same
+*/
+static bool keyEquals(const char *inputData, size_t inputKeyStart, size_t inputKeyLength, const char *inputName)
+{
+size_t i = 0;
+for(; i < inputKeyLength; i++)
+{
+if(inputName[i] == '\0' || asciiToLower(inputData[inputKeyStart + i]) != inputName[i])
+{
+return false;
+}
+}
+return inputName[i] == '\0';
+}
+
+/*
+This function parses a "key=value;key=value" payload.
+@param inputData: The payload text
+@param inputLength: The number of bytes of payload text
+@param inputPayloadBuffer: The buffer to store the parsed payload in
+@return: true if the payload was valid and false otherwise
+*/
+static bool parseKeyValuePayload(const char *inputData, size_t inputLength, QRCodePayload &inputPayloadBuffer)
+{
+bool foundDimension = false;
+size_t position = 0;
+
+while(position < inputLength)
+{
+//Find the end of the field and the equals sign in it
+size_t fieldEnd = position;
+size_t equalsPosition = inputLength;
+while(fieldEnd < inputLength && inputData[fieldEnd] != ';')
+{
+if(equalsPosition == inputLength && inputData[fieldEnd] == '=')
+{
+equalsPosition = fieldEnd;
+}
+fieldEnd++;
+}
+
+skipSpaces(inputData, fieldEnd, position);
+if(position == fieldEnd)
+{
+position = fieldEnd + 1;
+continue; //Empty field, such as a trailing ';'
+}
+
+if(equalsPosition >= fieldEnd)
+{
+return false; //Field without a value
+}
+
+size_t keyEnd = equalsPosition;
+while(keyEnd > position && (inputData[keyEnd - 1] == ' ' || inputData[keyEnd - 1] == '\t'))
+{
+keyEnd--;
+}
+size_t keyLength = keyEnd - position;
+
+size_t valueStart = equalsPosition + 1;
+skipSpaces(inputData, fieldEnd, valueStart);
+size_t valueEnd = fieldEnd;
+while(valueEnd > valueStart && (inputData[valueEnd - 1] == ' ' || inputData[valueEnd - 1] == '\t'))
+{
+valueEnd--;
+}
+
+if(keyEquals(inputData, position, keyLength, "v"))
+{
+double version;
+size_t versionPosition = valueStart;
+if(!parseDecimalNumber(inputData, valueEnd, versionPosition, version) || versionPosition != valueEnd || version < 1.0 || version != std::floor(version) || version > QRCodePayloadSchemaVersion)
+{
+return false;
+}
+inputPayloadBuffer.version = (int) version;
+}
+else if(keyEquals(inputData, position, keyLength, "id"))
+{
+inputPayloadBuffer.identifierOffset = valueStart;
+inputPayloadBuffer.identifierLength = valueEnd - valueStart;
+}
+else if(keyEquals(inputData, position, keyLength, "size"))
+{
+size_t dimensionPosition = valueStart;
+if(!parseDimensionWithUnit(inputData, valueEnd, dimensionPosition, inputPayloadBuffer.QRCodeDimension))
+{
+return false;
+}
+skipSpaces(inputData, valueEnd, dimensionPosition);
+if(dimensionPosition != valueEnd)
+{
+return false;
+}
+foundDimension = true;
+}
+else if(keyEquals(inputData, position, keyLength, "pose"))
+{
+size_t posePosition = valueStart;
+for(int i=0; i < 6; i++)
+{
+skipSpaces(inputData, valueEnd, posePosition);
+if(!parseDecimalNumber(inputData, valueEnd, posePosition, inputPayloadBuffer.worldPoseHint[i]))
+{
+return false;
+}
+skipSpaces(inputData, valueEnd, posePosition);
+
+if(i < 5)
+{
+if(posePosition >= valueEnd || inputData[posePosition] != ',')
+{
+return false;
+}
+posePosition++;
+}
+}
+
+if(posePosition != valueEnd)
+{
+return false;
+}
+inputPayloadBuffer.hasWorldPoseHint = true;
+}
+//Unknown keys are skipped so payloads can gain optional keys without a new version
+
+position = fieldEnd + 1;
+}
+
+return foundDimension;
+}
+
+/*
+This function parses a QR code payload in a single pass without allocating memory or throwing exceptions.  Two formats are accepted:
+
+"dimension-identifier" (the original format), such as "6.5in-IdentString".  The unit is case insensitive and may be "m", "cm", "mm", "ft" or "in".  It has to follow the number directly and be followed directly by "-" (unlike the old std::stod based parsing, which would read "6min-x" as 6 inches).
+
+Semicolon separated key=value pairs, such as "v=1;id=dock3;size=6in;pose=1.0,2.0,0.0,0,0,1.57".  "size" is required and uses the same units, "id" is the identifier, "v" is the schema version and "pose" is an optional world pose hint (x,y,z in meters then roll,pitch,yaw in radians).  Payloads with a version above QRCodePayloadSchemaVersion are rejected, since a newer schema may change what the known keys mean, while unknown keys are skipped so payloads can gain optional fields without a new version.  A payload is treated as key/value if it starts with a letter.
+
+The dimension must be a finite number greater than zero.
+@param inputData: The payload text (does not need to be null terminated)
+@param inputLength: The number of bytes of payload text
+@param inputPayloadBuffer: The buffer to store the parsed payload in
+@return: true if the payload was valid and false otherwise
+*/
+bool parseQRCodePayload(const char *inputData, size_t inputLength, QRCodePayload &inputPayloadBuffer) noexcept
+{
+if(inputData == NULL)
+{
+return false;
+}
+
+QRCodePayload payload;
+payload.QRCodeDimension = 0.0;
+payload.identifierOffset = inputLength;
+payload.identifierLength = 0;
+payload.version = 0;
+payload.hasWorldPoseHint = false;
+for(int i=0; i < 6; i++)
+{
+payload.worldPoseHint[i] = 0.0;
+}
+
+size_t position = 0;
+skipSpaces(inputData, inputLength, position);
+char firstCharacter = (position < inputLength) ? asciiToLower(inputData[position]) : '\0';
+
+if(firstCharacter >= 'a' && firstCharacter <= 'z')
+{
+payload.version = 1;
+if(!parseKeyValuePayload(inputData, inputLength, payload))
+{
+return false;
+}
+}
+else
+{
+//"dimension-identifier"
+if(!parseDimensionWithUnit(inputData, inputLength, position, payload.QRCodeDimension) || position >= inputLength || inputData[position] != '-')
+{
+return false;
+}
+
+payload.identifierOffset = position + 1;
+payload.identifierLength = inputLength - payload.identifierOffset;
+}
+
+inputPayloadBuffer = payload;
+return true;
+}
+
+/*
+This function initializes the cache to empty.
+*/
+QRCodePayloadCache::QRCodePayloadCache()
+{
+static_assert((QRCodePayloadCacheSize & (QRCodePayloadCacheSize - 1)) == 0, "Payload cache size must be a power of two");
+
+numberOfHits = 0;
+numberOfMisses = 0;
+for(int i=0; i < QRCodePayloadCacheSize; i++)
+{
+entries[i].isOccupied = false;
+}
+}
+
+/*
+This function returns the parsed form of a payload, parsing it with parseQRCodePayload if it is not already cached.  It never allocates memory or throws exceptions.
+@param inputData: The payload text
+@param inputLength: The number of bytes of payload text
+@param inputPayloadBuffer: The buffer to store the parsed payload in
+@return: true if the payload was valid and false otherwise
+*/
+bool QRCodePayloadCache::parse(const char *inputData, size_t inputLength, QRCodePayload &inputPayloadBuffer) noexcept
+{
+if(inputData == NULL || inputLength > QRCodePayloadCacheMaximumPayloadLength)
+{
+return parseQRCodePayload(inputData, inputLength, inputPayloadBuffer);
+}
+
+uint64_t payloadHash = hashQRCodeIdentifier(inputData, inputLength);
+QRCodePayloadCacheEntry &entry = entries[payloadHash & (QRCodePayloadCacheSize - 1)];
+
+if(entry.isOccupied && entry.payloadHash == payloadHash && entry.payloadLength == inputLength && memcmp(entry.payloadText, inputData, inputLength) == 0)
+{
+numberOfHits++;
+if(entry.parseSucceeded)
+{
+inputPayloadBuffer = entry.payload;
+}
+return entry.parseSucceeded;
+}
+
+numberOfMisses++;
+entry.isOccupied = true;
+entry.payloadHash = payloadHash;
+entry.payloadLength = inputLength;
+memcpy(entry.payloadText, inputData, inputLength);
+entry.parseSucceeded = parseQRCodePayload(inputData, inputLength, entry.payload);
+
+if(entry.parseSucceeded)
+{
+inputPayloadBuffer = entry.payload;
+}
+return entry.parseSucceeded;
+}
@@ -0,0 +1,94 @@
+#ifndef QRCODEPAYLOADPARSERHPP
+#define QRCODEPAYLOADPARSERHPP
+
+#include<cstddef>
+#include<cstdint>
+
+#include "QRCodeIdentifierHash.hpp"
+
+/*
+This struct describes one unit suffix that can follow the QR code dimension.
+*/
+struct QRCodeUnitIdentifier
+{
+const char *text; //Lower case suffix
+size_t length;
+double metersPerUnit;
+};
+
+//Declare handy constants (longer suffixes come first so "mm" is tried before "m")
+static constexpr QRCodeUnitIdentifier QRCodeUnitIdentifiers[] = {{"mm", 2, .001}, {"cm", 2, .01}, {"ft", 2, .3048}, {"in", 2, .0254}, {"m", 1, 1.0}};
+static constexpr int QRCodeNumberOfUnitIdentifiers = sizeof(QRCodeUnitIdentifiers) / sizeof(QRCodeUnitIdentifier);
+static constexpr int QRCodePayloadSchemaVersion = 1; //Highest key/value payload version this parser knows about (higher versions are rejected)
+static constexpr int QRCodePayloadCacheSize = 64; //Number of entries in the parsed payload cache (a power of two)
+static constexpr size_t QRCodePayloadCacheMaximumPayloadLength = 128; //Longer payloads are parsed every time
+
+/*
+This struct holds everything parsed out of a QR code payload.  It never owns memory: the identifier is given as an offset and length into the payload text, so it stays valid for a cached copy of the same text.
+*/
+struct QRCodePayload
+{
+double QRCodeDimension; //Length of one side of the QR code in meters
+size_t identifierOffset; //Where the identifier starts in the payload text
+size_t identifierLength; //How many bytes long the identifier is
+int version; //0 for "dimension-identifier" payloads, otherwise the "v" key of a key/value payload (1 if missing)
+bool hasWorldPoseHint; //True if the payload gave the pose of the tag in the world
+double worldPoseHint[6]; //x, y, z (meters) and roll, pitch, yaw (radians) of the tag in the world
+};
+
+/*
+This function parses a QR code payload in a single pass without allocating memory or throwing exceptions.  Two formats are accepted:
+
+"dimension-identifier" (the original format), such as "6.5in-IdentString".  The unit is case insensitive and may be "m", "cm", "mm", "ft" or "in".  It has to follow the number directly and be followed directly by "-" (unlike the old std::stod based parsing, which would read "6min-x" as 6 inches).
+
+Semicolon separated key=value pairs, such as "v=1;id=dock3;size=6in;pose=1.0,2.0,0.0,0,0,1.57".  "size" is required and uses the same units, "id" is the identifier, "v" is the schema version and "pose" is an optional world pose hint (x,y,z in meters then roll,pitch,yaw in radians).  Payloads with a version above QRCodePayloadSchemaVersion are rejected, since a newer schema may change what the known keys mean, while unknown keys are skipped so payloads can gain optional fields without a new version.  A payload is treated as key/value if it starts with a letter.
+
+The dimension must be a finite number greater than zero.
+@param inputData: The payload text (does not need to be null terminated)
+@param inputLength: The number of bytes of payload text
+@param inputPayloadBuffer: The buffer to store the parsed payload in
+@return: true if the payload was valid and false otherwise
+*/
+bool parseQRCodePayload(const char *inputData, size_t inputLength, QRCodePayload &inputPayloadBuffer) noexcept;
+
+/*
+This struct is one slot of the parsed payload cache.
+*/
+struct QRCodePayloadCacheEntry
+{
+uint64_t payloadHash;
+size_t payloadLength;
+bool isOccupied;
+bool parseSucceeded; //Undecodable payloads are cached too, so repeated garbage is rejected cheaply
+QRCodePayload payload;
+char payloadText[QRCodePayloadCacheMaximumPayloadLength];
+};
+
+/*
+This class remembers the result of parsing recently seen payloads, so tags which stay in view from frame to frame are only parsed once.  It is a fixed size direct mapped table keyed by the payload hash, and the stored text is compared before a hit is used, so hash collisions cannot return the wrong result.
+*/
+class QRCodePayloadCache
+{
+public:
+/*
+This function initializes the cache to empty.
+*/
+QRCodePayloadCache();
+
+/*
+This function returns the parsed form of a payload, parsing it with parseQRCodePayload if it is not already cached.  It never allocates memory or throws exceptions.
+@param inputData: The payload text
+@param inputLength: The number of bytes of payload text
+@param inputPayloadBuffer: The buffer to store the parsed payload in
+@return: true if the payload was valid and false otherwise
+*/
+bool parse(const char *inputData, size_t inputLength, QRCodePayload &inputPayloadBuffer) noexcept;
+
+uint64_t numberOfHits;
+uint64_t numberOfMisses;
+
+private:
+QRCodePayloadCacheEntry entries[QRCodePayloadCacheSize];
+};
+
+#endif
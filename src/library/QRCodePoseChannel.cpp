@@ -0,0 +1,286 @@
+#include "QRCodePoseChannel.hpp"
+#include "QRCodeLatencyTrace.hpp"
+
+#include<new>
+#include<cstring>
+#include<cerrno>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+/*
+This function creates (or replaces) the shared memory region for the channel.
+@param inputChannelName: The POSIX shared memory name (for example "/qrcode_poses")
+@param inputNumberOfSlots: How many records the ring holds before the oldest is overwritten
+
+@exceptions: This function can throw exceptions
+*/
+QRCodePosePublisher::QRCodePosePublisher(const std::string &inputChannelName, uint32_t inputNumberOfSlots) : channelName(inputChannelName)
+{
+if(inputNumberOfSlots == 0)
+{
+throw SOMException(std::string("Pose channel needs at least one slot\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+regionSize = sizeof(QRCodePoseChannelHeader) + sizeof(QRCodePoseChannelSlot) * inputNumberOfSlots;
+
+//Replace any channel left over from a previous run so subscribers never see a stale layout
+shm_unlink(channelName.c_str());
+int fileDescriptor = shm_open(channelName.c_str(), O_CREAT | O_RDWR | O_EXCL, 0644);
+if(fileDescriptor < 0)
+{
+throw SOMException(std::string("Unable to create pose channel shared memory: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+SOMScopeGuard fileDescriptorGuard([&](){close(fileDescriptor);});
+
+if(ftruncate(fileDescriptor, regionSize) != 0)
+{
+shm_unlink(channelName.c_str());
+throw SOMException(std::string("Unable to size pose channel shared memory: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+void *region = mmap(NULL, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+if(region == MAP_FAILED)
+{
+shm_unlink(channelName.c_str());
+throw SOMException(std::string("Unable to map pose channel shared memory: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+header = new (region) QRCodePoseChannelHeader;
+slots = reinterpret_cast<QRCodePoseChannelSlot *>(reinterpret_cast<char *>(region) + sizeof(QRCodePoseChannelHeader));
+for(uint32_t i=0; i < inputNumberOfSlots; i++)
+{
+new (&slots[i]) QRCodePoseChannelSlot;
+slots[i].slotVersion.store(0, std::memory_order_relaxed);
+}
+
+header->version = QRCodePoseChannelVersion;
+header->numberOfSlots = inputNumberOfSlots;
+header->recordSize = sizeof(QRCodePoseRecord);
+header->nextSequenceNumber.store(0, std::memory_order_relaxed);
+
+//Write the magic number last so a subscriber that maps the region early never sees a half initialized header
+std::atomic_thread_fence(std::memory_order_release);
+header->magicNumber = QRCodePoseChannelMagicNumber;
+}
+
+/*
+This function writes one pose record to the ring.
+@param inputCameraPose: The 4x4 camera pose matrix (CV_64F)
+@param inputQRCodeIdentifier: The identifier of the QR code the pose is relative to
+@param inputQRCodeDimension: The size of the QR code in meters
+@param inputCaptureTimestamp: Monotonic clock nanoseconds when the frame was captured (0 if unknown)
+@param inputComputeTimestamp: Monotonic clock nanoseconds when the pose was computed (0 means now)
+@return: The sequence number of the record that was written
+
+@exceptions: This function can throw exceptions
+*/
+uint64_t QRCodePosePublisher::publish(const cv::Mat &inputCameraPose, const std::string &inputQRCodeIdentifier, double inputQRCodeDimension, int64_t inputCaptureTimestamp, int64_t inputComputeTimestamp)
+{
+if(inputCameraPose.rows != 4 || inputCameraPose.cols != 4 || inputCameraPose.type() != CV_64F)
+{
+throw SOMException(std::string("Camera pose is not a 4x4 double matrix\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+QRCodePoseRecord record;
+record.sequenceNumber = 0;
+record.QRCodeIdentifierHash = hashQRCodeIdentifier(inputQRCodeIdentifier);
+record.captureTimestamp = inputCaptureTimestamp;
+record.computeTimestamp = (inputComputeTimestamp == 0) ? getPoseChannelTimestamp() : inputComputeTimestamp;
+record.QRCodeDimension = inputQRCodeDimension;
+
+for(int row = 0; row < 4; row++)
+{
+for(int col = 0; col < 4; col++)
+{
+record.cameraPose[row*4 + col] = inputCameraPose.at<double>(row, col);
+}
+}
+
+return publish(record);
+}
+
+/*
+This function writes one pose record to the ring.  The sequence number field of the given record is ignored and replaced.
+@param inputRecord: The record to write
+@return: The sequence number of the record that was written
+*/
+uint64_t QRCodePosePublisher::publish(const QRCodePoseRecord &inputRecord)
+{
+//Only the publisher writes the sequence number, so a relaxed load is enough
+uint64_t sequenceNumber = header->nextSequenceNumber.load(std::memory_order_relaxed);
+QRCodePoseChannelSlot &slot = slots[sequenceNumber % header->numberOfSlots];
+
+slot.slotVersion.store(2*sequenceNumber + 1, std::memory_order_relaxed); //Mark as being written
+std::atomic_thread_fence(std::memory_order_release);
+
+memcpy(&slot.record, &inputRecord, sizeof(QRCodePoseRecord));
+slot.record.sequenceNumber = sequenceNumber;
+
+slot.slotVersion.store(2*(sequenceNumber + 1), std::memory_order_release);
+header->nextSequenceNumber.store(sequenceNumber + 1, std::memory_order_release);
+
+return sequenceNumber;
+}
+
+/*
+This destructor unmaps and unlinks the shared memory region.
+*/
+QRCodePosePublisher::~QRCodePosePublisher()
+{
+munmap(header, regionSize);
+shm_unlink(channelName.c_str());
+}
+
+/*
+This function maps an existing channel.  The subscriber starts at the next record to be published.
+@param inputChannelName: The POSIX shared memory name given to the publisher
+
+@exceptions: This function can throw exceptions
+*/
+QRCodePoseSubscriber::QRCodePoseSubscriber(const std::string &inputChannelName)
+{
+int fileDescriptor = shm_open(inputChannelName.c_str(), O_RDONLY, 0);
+if(fileDescriptor < 0)
+{
+throw SOMException(std::string("Unable to open pose channel shared memory: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+SOMScopeGuard fileDescriptorGuard([&](){close(fileDescriptor);});
+
+struct stat fileStatus;
+if(fstat(fileDescriptor, &fileStatus) != 0 || fileStatus.st_size < (off_t) sizeof(QRCodePoseChannelHeader))
+{
+throw SOMException(std::string("Pose channel shared memory is too small\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+regionSize = fileStatus.st_size;
+
+void *region = mmap(NULL, regionSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+if(region == MAP_FAILED)
+{
+throw SOMException(std::string("Unable to map pose channel shared memory: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+SOMScopeGuard regionGuard([&](){munmap(region, regionSize);});
+
+header = reinterpret_cast<const QRCodePoseChannelHeader *>(region);
+slots = reinterpret_cast<const QRCodePoseChannelSlot *>(reinterpret_cast<const char *>(region) + sizeof(QRCodePoseChannelHeader));
+
+if(header->magicNumber != QRCodePoseChannelMagicNumber)
+{
+throw SOMException(std::string("Pose channel has not been initialized by a publisher\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+std::atomic_thread_fence(std::memory_order_acquire);
+
+if(header->version != QRCodePoseChannelVersion || header->recordSize != sizeof(QRCodePoseRecord) || regionSize < sizeof(QRCodePoseChannelHeader) + sizeof(QRCodePoseChannelSlot) * header->numberOfSlots)
+{
+throw SOMException(std::string("Pose channel layout does not match this library version\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+numberOfRecordsMissed = 0;
+nextSequenceNumberToRead = header->nextSequenceNumber.load(std::memory_order_acquire);
+versionOfPeekedSlot = 0;
+
+regionGuard.dismiss();
+}
+
+/*
+This function returns a pointer to the next unread record inside the shared memory without copying it.  The record must be checked with isStillValid() after it has been used, since the publisher may have overwritten it in the meantime.  If the subscriber has fallen behind by more than the ring length, it skips forward to the oldest record still in the ring and adds the skipped records to numberOfRecordsMissed.
+@return: The record, or NULL if there is no new record yet
+*/
+const QRCodePoseRecord *QRCodePoseSubscriber::peek()
+{
+while(true)
+{
+uint64_t nextSequenceNumberToWrite = header->nextSequenceNumber.load(std::memory_order_acquire);
+if(nextSequenceNumberToRead >= nextSequenceNumberToWrite)
+{
+return NULL; //Nothing new
+}
+
+if(nextSequenceNumberToWrite - nextSequenceNumberToRead > header->numberOfSlots)
+{
+//Fell behind, so skip to the oldest record that can still be in the ring
+uint64_t oldestAvailable = nextSequenceNumberToWrite - header->numberOfSlots;
+numberOfRecordsMissed += oldestAvailable - nextSequenceNumberToRead;
+nextSequenceNumberToRead = oldestAvailable;
+}
+
+const QRCodePoseChannelSlot &slot = slots[nextSequenceNumberToRead % header->numberOfSlots];
+uint64_t slotVersion = slot.slotVersion.load(std::memory_order_acquire);
+if(slotVersion == 2*(nextSequenceNumberToRead + 1))
+{
+versionOfPeekedSlot = slotVersion;
+return &slot.record;
+}
+
+//The slot already holds (or is being overwritten by) a newer record
+numberOfRecordsMissed++;
+nextSequenceNumberToRead++;
+}
+}
+
+/*
+This function checks that a record returned by peek() was not overwritten while it was being used.  If it is valid, the subscriber moves on to the next record.
+@param inputRecord: The record returned by peek()
+@return: true if everything read from the record is consistent and false if it should be discarded
+*/
+bool QRCodePoseSubscriber::isStillValid(const QRCodePoseRecord *inputRecord)
+{
+if(inputRecord == NULL)
+{
+return false;
+}
+
+std::atomic_thread_fence(std::memory_order_acquire);
+const QRCodePoseChannelSlot &slot = slots[nextSequenceNumberToRead % header->numberOfSlots];
+bool recordIsValid = slot.slotVersion.load(std::memory_order_relaxed) == versionOfPeekedSlot;
+
+if(!recordIsValid)
+{
+numberOfRecordsMissed++;
+}
+nextSequenceNumberToRead++;
+
+return recordIsValid;
+}
+
+/*
+This function copies the next unread record into the given buffer, retrying if the publisher overwrites it during the copy.
+@param inputRecordBuffer: The buffer to store the record in
+@return: true if a record was read and false if there is no new record yet
+*/
+bool QRCodePoseSubscriber::tryRead(QRCodePoseRecord &inputRecordBuffer)
+{
+while(true)
+{
+const QRCodePoseRecord *record = peek();
+if(record == NULL)
+{
+return false;
+}
+
+memcpy(&inputRecordBuffer, record, sizeof(QRCodePoseRecord));
+
+if(isStillValid(record))
+{
+return true;
+}
+}
+}
+
+/*
+This destructor unmaps the shared memory region.
+*/
+QRCodePoseSubscriber::~QRCodePoseSubscriber()
+{
+munmap(const_cast<QRCodePoseChannelHeader *>(header), regionSize);
+}
+
+/*
+This function returns the current time of the monotonic clock that the pose channel timestamps use.
+@return: Nanoseconds since an arbitrary fixed point
+*/
+int64_t getPoseChannelTimestamp()
+{
+return getQRCodeTimestamp(); //Same clock as the estimator frame timestamps
+}
@@ -0,0 +1,159 @@
+#ifndef QRCODEPOSECHANNELHPP
+#define QRCODEPOSECHANNELHPP
+
+#include<string>
+#include<atomic>
+#include<cstdint>
+
+#include "SOMException.hpp"
+#include "SOMScopeGuard.hpp"
+#include "QRCodeIdentifierHash.hpp"
+#include <opencv2/core/core.hpp>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Pose channel needs lock free 64 bit atomics to be shared between processes");
+
+//Declare handy constants
+static const uint32_t QRCodePoseChannelMagicNumber = 0x51525043; //"QRPC"
+static const uint32_t QRCodePoseChannelVersion = 1;
+
+/*
+This struct is the fixed size binary record that is published for each pose.  It is plain old data so that it can be read in place by other processes.
+*/
+struct QRCodePoseRecord
+{
+uint64_t sequenceNumber; //Increments by one for every record the publisher writes
+uint64_t QRCodeIdentifierHash; //hashQRCodeIdentifier() of the identifier text
+int64_t captureTimestamp; //Nanoseconds on the monotonic clock when the frame was captured (0 if unknown)
+int64_t computeTimestamp; //Nanoseconds on the monotonic clock when the pose was finished
+double QRCodeDimension; //Size of the QR code in meters
+double cameraPose[16]; //4x4 camera pose matrix in row major order
+};
+
+/*
+This struct is one slot of the ring buffer.  slotVersion is odd while the publisher is writing the slot and is 2 * (sequenceNumber + 1) once the record for sequenceNumber is complete.
+*/
+struct alignas(64) QRCodePoseChannelSlot
+{
+std::atomic<uint64_t> slotVersion;
+QRCodePoseRecord record;
+};
+
+/*
+This struct is placed at the start of the shared memory region.
+*/
+struct alignas(64) QRCodePoseChannelHeader
+{
+uint32_t magicNumber;
+uint32_t version;
+uint32_t numberOfSlots;
+uint32_t recordSize;
+std::atomic<uint64_t> nextSequenceNumber; //Sequence number the publisher will write next
+};
+
+/*
+This class publishes pose records into a named POSIX shared memory ring buffer.  There is one publisher per channel and any number of subscribers, each of which sees every record (unless it falls more than a ring's length behind).  Publishing never blocks and never makes a system call: the publisher simply overwrites the oldest slot, and the per slot version lets readers detect that a record changed underneath them (a seqlock).
+*/
+class QRCodePosePublisher
+{
+public:
+/*
+This function creates (or replaces) the shared memory region for the channel.
+@param inputChannelName: The POSIX shared memory name (for example "/qrcode_poses")
+@param inputNumberOfSlots: How many records the ring holds before the oldest is overwritten
+
+@exceptions: This function can throw exceptions
+*/
+QRCodePosePublisher(const std::string &inputChannelName, uint32_t inputNumberOfSlots = 256);
+
+/*
+This function writes one pose record to the ring.
+@param inputCameraPose: The 4x4 camera pose matrix (CV_64F)
+@param inputQRCodeIdentifier: The identifier of the QR code the pose is relative to
+@param inputQRCodeDimension: The size of the QR code in meters
+@param inputCaptureTimestamp: Monotonic clock nanoseconds when the frame was captured (0 if unknown)
+@param inputComputeTimestamp: Monotonic clock nanoseconds when the pose was computed (0 means now)
+@return: The sequence number of the record that was written
+
+@exceptions: This function can throw exceptions
+*/
+uint64_t publish(const cv::Mat &inputCameraPose, const std::string &inputQRCodeIdentifier, double inputQRCodeDimension, int64_t inputCaptureTimestamp = 0, int64_t inputComputeTimestamp = 0);
+
+/*
+This function writes one pose record to the ring.  The sequence number field of the given record is ignored and replaced.
+@param inputRecord: The record to write
+@return: The sequence number of the record that was written
+*/
+uint64_t publish(const QRCodePoseRecord &inputRecord);
+
+/*
+This destructor unmaps and unlinks the shared memory region.
+*/
+~QRCodePosePublisher();
+
+private:
+QRCodePosePublisher(const QRCodePosePublisher &inputQRCodePosePublisher) = delete; //Disable copying of the object
+
+std::string channelName;
+size_t regionSize;
+QRCodePoseChannelHeader *header;
+QRCodePoseChannelSlot *slots;
+};
+
+/*
+This class reads pose records from a channel created by a QRCodePosePublisher in this or another process.  Reads are wait free and make no system calls.
+*/
+class QRCodePoseSubscriber
+{
+public:
+/*
+This function maps an existing channel.  The subscriber starts at the next record to be published.
+@param inputChannelName: The POSIX shared memory name given to the publisher
+
+@exceptions: This function can throw exceptions
+*/
+QRCodePoseSubscriber(const std::string &inputChannelName);
+
+/*
+This function returns a pointer to the next unread record inside the shared memory without copying it.  The record must be checked with isStillValid() after it has been used, since the publisher may have overwritten it in the meantime.  If the subscriber has fallen behind by more than the ring length, it skips forward to the oldest record still in the ring and adds the skipped records to numberOfRecordsMissed.
+@return: The record, or NULL if there is no new record yet
+*/
+const QRCodePoseRecord *peek();
+
+/*
+This function checks that a record returned by peek() was not overwritten while it was being used.  If it is valid, the subscriber moves on to the next record.
+@param inputRecord: The record returned by peek()
+@return: true if everything read from the record is consistent and false if it should be discarded
+*/
+bool isStillValid(const QRCodePoseRecord *inputRecord);
+
+/*
+This function copies the next unread record into the given buffer, retrying if the publisher overwrites it during the copy.
+@param inputRecordBuffer: The buffer to store the record in
+@return: true if a record was read and false if there is no new record yet
+*/
+bool tryRead(QRCodePoseRecord &inputRecordBuffer);
+
+/*
+This destructor unmaps the shared memory region.
+*/
+~QRCodePoseSubscriber();
+
+uint64_t numberOfRecordsMissed; //Records that were overwritten before this subscriber read them
+
+private:
+QRCodePoseSubscriber(const QRCodePoseSubscriber &inputQRCodePoseSubscriber) = delete; //Disable copying of the object
+
+size_t regionSize;
+const QRCodePoseChannelHeader *header;
+const QRCodePoseChannelSlot *slots;
+uint64_t nextSequenceNumberToRead;
+uint64_t versionOfPeekedSlot;
+};
+
+/*
+This function returns the current time of the monotonic clock that the pose channel timestamps use.
+@return: Nanoseconds since an arbitrary fixed point
+*/
+int64_t getPoseChannelTimestamp();
+
+#endif
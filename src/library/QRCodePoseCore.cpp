@@ -0,0 +1,502 @@
+#include "QRCodePoseCore.hpp"
+
+/*
+This function initializes the core with an identity camera matrix and no distortion.
+*/
+template<typename ScalarType>
+QRCodePoseCore<ScalarType>::QRCodePoseCore() : numberOfRefinementIterations(QRCodePoseCoreDefaultRefinementIterations), focalLengthX(1), focalLengthY(1), principalPointX(0), principalPointY(0), skew(0), k1(0), k2(0), p1(0), p2(0), k3(0)
+{
+}
+
+/*
+This function sets the camera model (converted to ScalarType).
+@param inputCameraMatrix: The 3x3 camera matrix for the frame size
+@param inputDistortionParameters: The 1x5 distortion parameters (k1, k2, p1, p2, k3)
+
+@exceptions: This function can throw exceptions
+*/
+template<typename ScalarType>
+void QRCodePoseCore<ScalarType>::setCameraModel(const cv::Mat_<double> &inputCameraMatrix, const cv::Mat_<double> &inputDistortionParameters)
+{
+if(inputCameraMatrix.rows != 3 || inputCameraMatrix.cols != 3 || inputDistortionParameters.rows * inputDistortionParameters.cols != 5)
+{
+throw SOMException(std::string("Pose core needs a 3x3 camera matrix and 5 distortion parameters\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(!(inputCameraMatrix(0, 0) != 0.0) || !(inputCameraMatrix(1, 1) != 0.0))
+{
+throw SOMException(std::string("Camera matrix has a zero focal length\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+focalLengthX = (ScalarType) inputCameraMatrix(0, 0);
+focalLengthY = (ScalarType) inputCameraMatrix(1, 1);
+principalPointX = (ScalarType) inputCameraMatrix(0, 2);
+principalPointY = (ScalarType) inputCameraMatrix(1, 2);
+skew = (ScalarType) inputCameraMatrix(0, 1);
+
+const double *distortion = inputDistortionParameters[0];
+k1 = (ScalarType) distortion[0];
+k2 = (ScalarType) distortion[1];
+p1 = (ScalarType) distortion[2];
+p2 = (ScalarType) distortion[3];
+k3 = (ScalarType) distortion[4];
+}
+
+/*
+This function removes the lens distortion from the corners of a tag and converts them to normalized image coordinates.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputNormalizedCornersBuffer: The buffer to store the normalized corners in
+*/
+template<typename ScalarType>
+void QRCodePoseCore<ScalarType>::undistortCorners(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], Corner (&inputNormalizedCornersBuffer)[QRCodePoseCoreNumberOfCorners]) const
+{
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+ScalarType distortedY = (inputPixelCorners[cornerIndex].y - principalPointY) / focalLengthY;
+ScalarType distortedX = (inputPixelCorners[cornerIndex].x - principalPointX - skew*distortedY) / focalLengthX;
+
+//Same fixed point iteration as cv::undistortPoints
+ScalarType x = distortedX;
+ScalarType y = distortedY;
+for(int iteration = 0; iteration < QRCodePoseCoreUndistortionIterations; iteration++)
+{
+ScalarType r2 = x*x + y*y;
+ScalarType inverseRadialDistortion = ScalarType(1) / (ScalarType(1) + ((k3*r2 + k2)*r2 + k1)*r2);
+ScalarType deltaX = ScalarType(2)*p1*x*y + p2*(r2 + ScalarType(2)*x*x);
+ScalarType deltaY = p1*(r2 + ScalarType(2)*y*y) + ScalarType(2)*p2*x*y;
+x = (distortedX - deltaX)*inverseRadialDistortion;
+y = (distortedY - deltaY)*inverseRadialDistortion;
+}
+
+inputNormalizedCornersBuffer[cornerIndex] = Corner(x, y);
+}
+}
+
+/*
+This function finds the pose of a tag relative to the camera in closed form from its homography.
+@param inputNormalizedCorners: The 4 undistorted corners in normalized image coordinates
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputRotationBuffer: The buffer to store the rotation (tag -> camera) in
+@param inputTranslationBuffer: The buffer to store the position of the tag center in camera coordinates in
+@return: true if the quad described a tag in front of the camera and false otherwise
+*/
+template<typename ScalarType>
+bool QRCodePoseCore<ScalarType>::estimateInitialTagPose(const Corner (&inputNormalizedCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, Rotation &inputRotationBuffer, Translation &inputTranslationBuffer)
+{
+ScalarType cornerX[QRCodePoseCoreNumberOfCorners];
+ScalarType cornerY[QRCodePoseCoreNumberOfCorners];
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+cornerX[cornerIndex] = inputNormalizedCorners[cornerIndex].x;
+cornerY[cornerIndex] = inputNormalizedCorners[cornerIndex].y;
+}
+
+ScalarType rotationColumns[9];
+ScalarType translation[3];
+if(computeHomographyTagPose(cornerX, cornerY, inputQRCodeDimension, rotationColumns, translation) == ScalarType(0))
+{
+return false;
+}
+
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+inputRotationBuffer(row, col) = rotationColumns[col*3 + row];
+}
+inputTranslationBuffer[row] = translation[row];
+}
+
+return true;
+}
+
+/*
+This function refines a tag pose with Gauss-Newton steps on the reprojection error of its corners.
+@param inputNormalizedCorners: The 4 undistorted corners in normalized image coordinates
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputNumberOfIterations: The most steps to take (it stops early once a step is negligible)
+@param inputRotation: The rotation (tag -> camera) to refine
+@param inputTranslation: The translation to refine
+@return: true if the refined pose is valid and false otherwise
+*/
+template<typename ScalarType>
+bool QRCodePoseCore<ScalarType>::refineTagPose(const Corner (&inputNormalizedCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, int inputNumberOfIterations, Rotation &inputRotation, Translation &inputTranslation)
+{
+const ScalarType halfDimension = inputQRCodeDimension / ScalarType(2);
+const ScalarType objectX[QRCodePoseCoreNumberOfCorners] = {-halfDimension, halfDimension, halfDimension, -halfDimension};
+const ScalarType objectY[QRCodePoseCoreNumberOfCorners] = {-halfDimension, -halfDimension, halfDimension, halfDimension};
+const ScalarType negligibleStepSquared = ScalarType(100) * std::numeric_limits<ScalarType>::epsilon() * std::numeric_limits<ScalarType>::epsilon();
+
+for(int iteration = 0; iteration < inputNumberOfIterations; iteration++)
+{
+//Normal equations for the 6 parameters: a small rotation applied on the left (w) followed by the translation
+cv::Matx<ScalarType, 6, 6> JtJ = cv::Matx<ScalarType, 6, 6>::zeros();
+cv::Vec<ScalarType, 6> Jtr = cv::Vec<ScalarType, 6>::all(0);
+
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+//Q is the rotated corner, X the corner in camera coordinates
+Translation Q(inputRotation(0, 0)*objectX[cornerIndex] + inputRotation(0, 1)*objectY[cornerIndex], inputRotation(1, 0)*objectX[cornerIndex] + inputRotation(1, 1)*objectY[cornerIndex], inputRotation(2, 0)*objectX[cornerIndex] + inputRotation(2, 1)*objectY[cornerIndex]);
+Translation X = Q + inputTranslation;
+if(!(X[2] > ScalarType(0)))
+{
+return false;
+}
+
+ScalarType inverseZ = ScalarType(1) / X[2];
+ScalarType u = X[0]*inverseZ;
+ScalarType v = X[1]*inverseZ;
+ScalarType residuals[2] = {u - inputNormalizedCorners[cornerIndex].x, v - inputNormalizedCorners[cornerIndex].y};
+
+//d(projection)/dX times dX/d[w t] = [-[Q]x I]
+ScalarType J[2][6] =
+{
+{-u*inverseZ*Q[1], inverseZ*Q[2] + u*inverseZ*Q[0], -inverseZ*Q[1], inverseZ, 0, -u*inverseZ},
+{-inverseZ*Q[2] - v*inverseZ*Q[1], v*inverseZ*Q[0], inverseZ*Q[0], 0, inverseZ, -v*inverseZ}
+};
+
+for(int residualIndex = 0; residualIndex < 2; residualIndex++)
+{
+for(int row = 0; row < 6; row++)
+{
+Jtr[row] += J[residualIndex][row]*residuals[residualIndex];
+for(int col = 0; col <= row; col++)
+{
+JtJ(row, col) += J[residualIndex][row]*J[residualIndex][col];
+}
+}
+}
+}
+
+//Solve JtJ step = -Jtr with a Cholesky factorization (only the lower triangle of JtJ is filled in)
+cv::Matx<ScalarType, 6, 6> L = cv::Matx<ScalarType, 6, 6>::zeros();
+for(int row = 0; row < 6; row++)
+{
+for(int col = 0; col <= row; col++)
+{
+ScalarType sum = JtJ(row, col);
+for(int k = 0; k < col; k++)
+{
+sum -= L(row, k)*L(col, k);
+}
+
+if(row == col)
+{
+if(!(sum > ScalarType(0)))
+{
+return true; //Can't improve on the current pose (such as a tag seen exactly edge on)
+}
+L(row, row) = std::sqrt(sum);
+}
+else
+{
+L(row, col) = sum / L(col, col);
+}
+}
+}
+
+cv::Vec<ScalarType, 6> step;
+for(int row = 0; row < 6; row++)
+{
+ScalarType sum = -Jtr[row];
+for(int k = 0; k < row; k++)
+{
+sum -= L(row, k)*step[k];
+}
+step[row] = sum / L(row, row);
+}
+for(int row = 5; row >= 0; row--)
+{
+ScalarType sum = step[row];
+for(int k = row + 1; k < 6; k++)
+{
+sum -= L(k, row)*step[k];
+}
+step[row] = sum / L(row, row);
+}
+
+//Apply the rotation with the Rodrigues formula, so the rotation stays orthonormal
+Translation w(step[0], step[1], step[2]);
+ScalarType angleSquared = w.dot(w);
+ScalarType angle = std::sqrt(angleSquared);
+ScalarType sinTerm = angleSquared > std::numeric_limits<ScalarType>::epsilon() ? std::sin(angle)/angle : ScalarType(1) - angleSquared/ScalarType(6);
+ScalarType cosTerm = angleSquared > std::numeric_limits<ScalarType>::epsilon() ? (ScalarType(1) - std::cos(angle))/angleSquared : ScalarType(.5) - angleSquared/ScalarType(24);
+Rotation skewW(0, -w[2], w[1], w[2], 0, -w[0], -w[1], w[0], 0);
+Rotation stepRotation = Rotation::eye() + skewW*sinTerm + (skewW*skewW)*cosTerm;
+
+inputRotation = stepRotation*inputRotation;
+inputTranslation += Translation(step[3], step[4], step[5]);
+
+if(step.dot(step) < negligibleStepSquared)
+{
+break;
+}
+}
+
+return inputTranslation[2] > ScalarType(0) && std::isfinite(inputTranslation[0]) && std::isfinite(inputTranslation[1]) && std::isfinite(inputTranslation[2]);
+}
+
+/*
+This function turns the pose of a tag relative to the camera into the pose of the camera in the coordinate system of the tag ([R^T, -R^T t]).
+@param inputRotation: The rotation (tag -> camera)
+@param inputTranslation: The position of the tag center in camera coordinates
+@param inputCameraPoseBuffer: The buffer to store the 4x4 camera pose in
+*/
+template<typename ScalarType>
+void QRCodePoseCore<ScalarType>::invertTagPose(const Rotation &inputRotation, const Translation &inputTranslation, Pose &inputCameraPoseBuffer)
+{
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+inputCameraPoseBuffer(row, col) = inputRotation(col, row);
+}
+inputCameraPoseBuffer(row, 3) = -(inputRotation(0, row)*inputTranslation[0] + inputRotation(1, row)*inputTranslation[1] + inputRotation(2, row)*inputTranslation[2]);
+inputCameraPoseBuffer(3, row) = ScalarType(0);
+}
+inputCameraPoseBuffer(3, 3) = ScalarType(1);
+}
+
+/*
+This function turns the pose of the camera in the coordinate system of a tag back into the pose of the tag relative to the camera (the inverse of invertTagPose).
+@param inputCameraPose: The 4x4 camera pose
+@param inputRotationBuffer: The buffer to store the rotation (tag -> camera) in
+@param inputTranslationBuffer: The buffer to store the position of the tag center in camera coordinates in
+*/
+template<typename ScalarType>
+void QRCodePoseCore<ScalarType>::invertCameraPose(const Pose &inputCameraPose, Rotation &inputRotationBuffer, Translation &inputTranslationBuffer)
+{
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+inputRotationBuffer(row, col) = inputCameraPose(col, row);
+}
+inputTranslationBuffer[row] = -(inputCameraPose(0, row)*inputCameraPose(0, 3) + inputCameraPose(1, row)*inputCameraPose(1, 3) + inputCameraPose(2, row)*inputCameraPose(2, 3));
+}
+}
+
+/*
+This function projects the corners of a tag into the frame, applying the lens distortion.
+@param inputRotation: The rotation (tag -> camera)
+@param inputTranslation: The position of the tag center in camera coordinates
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputPixelCornersBuffer: The buffer to store the 4 corners in pixels (in zbar order) in
+@return: true if all of the corners are in front of the camera and false otherwise
+*/
+template<typename ScalarType>
+bool QRCodePoseCore<ScalarType>::projectCorners(const Rotation &inputRotation, const Translation &inputTranslation, ScalarType inputQRCodeDimension, Corner (&inputPixelCornersBuffer)[QRCodePoseCoreNumberOfCorners]) const
+{
+const ScalarType halfDimension = inputQRCodeDimension / ScalarType(2);
+const ScalarType objectX[QRCodePoseCoreNumberOfCorners] = {-halfDimension, halfDimension, halfDimension, -halfDimension};
+const ScalarType objectY[QRCodePoseCoreNumberOfCorners] = {-halfDimension, -halfDimension, halfDimension, halfDimension};
+
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+Translation X(inputRotation(0, 0)*objectX[cornerIndex] + inputRotation(0, 1)*objectY[cornerIndex], inputRotation(1, 0)*objectX[cornerIndex] + inputRotation(1, 1)*objectY[cornerIndex], inputRotation(2, 0)*objectX[cornerIndex] + inputRotation(2, 1)*objectY[cornerIndex]);
+X += inputTranslation;
+if(!(X[2] > ScalarType(0)))
+{
+return false;
+}
+
+//Same distortion model as cv::projectPoints
+ScalarType x = X[0] / X[2];
+ScalarType y = X[1] / X[2];
+ScalarType r2 = x*x + y*y;
+ScalarType radialDistortion = ScalarType(1) + ((k3*r2 + k2)*r2 + k1)*r2;
+ScalarType distortedX = x*radialDistortion + ScalarType(2)*p1*x*y + p2*(r2 + ScalarType(2)*x*x);
+ScalarType distortedY = y*radialDistortion + p1*(r2 + ScalarType(2)*y*y) + ScalarType(2)*p2*x*y;
+inputPixelCornersBuffer[cornerIndex] = Corner(focalLengthX*distortedX + skew*distortedY + principalPointX, focalLengthY*distortedY + principalPointY);
+}
+
+return true;
+}
+
+/*
+This function finds the root mean square distance between the corners of a tag and the corners projected from a camera pose.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraPose: The 4x4 camera pose (OpenCV format) in the coordinate system of the tag
+@return: The distance in pixels (infinity if the pose puts the tag behind the camera)
+*/
+template<typename ScalarType>
+ScalarType QRCodePoseCore<ScalarType>::computeReprojectionRMS(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, const Pose &inputCameraPose) const
+{
+Rotation rotation;
+Translation translation;
+invertCameraPose(inputCameraPose, rotation, translation);
+
+Corner projectedCorners[QRCodePoseCoreNumberOfCorners];
+if(!projectCorners(rotation, translation, inputQRCodeDimension, projectedCorners))
+{
+return std::numeric_limits<ScalarType>::infinity();
+}
+
+ScalarType sumOfSquares = ScalarType(0);
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+Corner difference = projectedCorners[cornerIndex] - inputPixelCorners[cornerIndex];
+sumOfSquares += difference.x*difference.x + difference.y*difference.y;
+}
+
+return std::sqrt(sumOfSquares / ScalarType(QRCodePoseCoreNumberOfCorners));
+}
+
+/*
+This function finds the area of the quad the corners of a tag make in the frame.
+@param inputPixelCorners: The 4 corners in pixels
+@return: The area in square pixels
+*/
+template<typename ScalarType>
+ScalarType QRCodePoseCore<ScalarType>::computeQuadArea(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners])
+{
+//Shoelace formula
+ScalarType twiceArea = ScalarType(0);
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+const Corner &current = inputPixelCorners[cornerIndex];
+const Corner &next = inputPixelCorners[(cornerIndex + 1) % QRCodePoseCoreNumberOfCorners];
+twiceArea += current.x*next.y - next.x*current.y;
+}
+
+return std::fabs(twiceArea) / ScalarType(2);
+}
+
+/*
+This function finds the angle between the normal of a tag and the line from the tag center to the camera.
+@param inputCameraPose: The 4x4 camera pose in the coordinate system of the tag
+@return: The angle in radians (0 when the tag is seen head on, approaching pi/2 when it is seen edge on)
+*/
+template<typename ScalarType>
+ScalarType QRCodePoseCore<ScalarType>::computeIncidenceAngle(const Pose &inputCameraPose)
+{
+//The tag normal is the z axis of its coordinate system, and the camera sits at the translation of its pose
+ScalarType distance = std::sqrt(inputCameraPose(0, 3)*inputCameraPose(0, 3) + inputCameraPose(1, 3)*inputCameraPose(1, 3) + inputCameraPose(2, 3)*inputCameraPose(2, 3));
+if(!(distance > ScalarType(0)))
+{
+return ScalarType(0);
+}
+
+return std::acos(std::min(std::fabs(inputCameraPose(2, 3)) / distance, ScalarType(1)));
+}
+
+/*
+This function checks the second pose a square seen in perspective can have.  Small or distant tags can reproject almost as well with their normal mirrored about the line of sight, which is the usual way single tag poses go wrong.  Both the given and the mirrored pose are refined, and whichever reprojects better is kept.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraPose: The 4x4 camera pose to check, which is replaced by the better of the two refined poses
+@param inputAmbiguityRatioBuffer: The buffer to store the reprojection RMS of the rejected pose divided by that of the kept pose in (values close to 1 mean the pose is ambiguous), or 0 if there was no distinct second pose
+@return: true if the mirrored pose was kept and false otherwise
+*/
+template<typename ScalarType>
+bool QRCodePoseCore<ScalarType>::checkMirroredCameraPose(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, Pose &inputCameraPose, ScalarType &inputAmbiguityRatioBuffer) const
+{
+inputAmbiguityRatioBuffer = ScalarType(0);
+
+Rotation rotation;
+Translation translation;
+invertCameraPose(inputCameraPose, rotation, translation);
+
+ScalarType distance = std::sqrt(translation.dot(translation));
+if(!(distance > ScalarType(0)))
+{
+return false;
+}
+
+//Reflect the tag normal about the line of sight, which is a rotation about normal x lineOfSight by twice the angle between them
+Translation normal(rotation(0, 2), rotation(1, 2), rotation(2, 2));
+Translation lineOfSight = translation*(ScalarType(1)/distance);
+Translation axis = normal.cross(lineOfSight);
+ScalarType axisLength = std::sqrt(axis.dot(axis));
+ScalarType halfAngle = std::atan2(axisLength, normal.dot(lineOfSight));
+if(!(axisLength > ScalarType(0)) || !(std::fabs(std::sin(ScalarType(2)*halfAngle)) > ScalarType(QRCodePoseCoreMinimumMirrorAngle)))
+{
+return false; //Seen head on, so both poses are the same one
+}
+axis = axis*(ScalarType(1)/axisLength);
+
+ScalarType angle = ScalarType(2)*halfAngle;
+Rotation skewAxis(0, -axis[2], axis[1], axis[2], 0, -axis[0], -axis[1], axis[0], 0);
+Rotation mirrorRotation = Rotation::eye() + skewAxis*std::sin(angle) + (skewAxis*skewAxis)*(ScalarType(1) - std::cos(angle));
+
+Rotation mirroredRotation = mirrorRotation*rotation;
+Translation mirroredTranslation = translation;
+Corner normalizedCorners[QRCodePoseCoreNumberOfCorners];
+undistortCorners(inputPixelCorners, normalizedCorners);
+if(!refineTagPose(normalizedCorners, inputQRCodeDimension, QRCodePoseCoreMirroredPoseRefinementIterations, mirroredRotation, mirroredTranslation))
+{
+return false;
+}
+
+//The refinement can slide back to the given pose, in which case there is only one
+Translation mirroredNormal(mirroredRotation(0, 2), mirroredRotation(1, 2), mirroredRotation(2, 2));
+Translation normalDifference = normal.cross(mirroredNormal);
+if(!(std::sqrt(normalDifference.dot(normalDifference)) > ScalarType(QRCodePoseCoreMinimumMirrorAngle)) && normal.dot(mirroredNormal) > ScalarType(0))
+{
+return false;
+}
+
+Pose mirroredCameraPose;
+invertTagPose(mirroredRotation, mirroredTranslation, mirroredCameraPose);
+
+//Compare the two minima rather than a minimum and a pose that may not have converged
+Pose refinedCameraPose = inputCameraPose;
+if(refineTagPose(normalizedCorners, inputQRCodeDimension, QRCodePoseCoreMirroredPoseRefinementIterations, rotation, translation))
+{
+invertTagPose(rotation, translation, refinedCameraPose);
+}
+
+//Keep whichever reprojects better (a tiny floor keeps the ratio finite for noise free corners)
+const ScalarType smallestError = std::numeric_limits<ScalarType>::epsilon();
+ScalarType error = std::max(computeReprojectionRMS(inputPixelCorners, inputQRCodeDimension, refinedCameraPose), smallestError);
+ScalarType mirroredError = std::max(computeReprojectionRMS(inputPixelCorners, inputQRCodeDimension, mirroredCameraPose), smallestError);
+if(!std::isfinite(mirroredError))
+{
+return false;
+}
+
+if(mirroredError < error)
+{
+inputAmbiguityRatioBuffer = error / mirroredError;
+inputCameraPose = mirroredCameraPose;
+return true;
+}
+
+inputAmbiguityRatioBuffer = mirroredError / error;
+inputCameraPose = refinedCameraPose;
+return false;
+}
+
+/*
+This function does all of the steps above for one tag.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraPoseBuffer: The buffer to store the 4x4 camera pose (OpenCV format) in
+@return: true if the pose was solved and false if the quad was degenerate
+*/
+template<typename ScalarType>
+bool QRCodePoseCore<ScalarType>::solveCameraPose(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, Pose &inputCameraPoseBuffer) const
+{
+Corner normalizedCorners[QRCodePoseCoreNumberOfCorners];
+undistortCorners(inputPixelCorners, normalizedCorners);
+
+Rotation rotation;
+Translation translation;
+if(!estimateInitialTagPose(normalizedCorners, inputQRCodeDimension, rotation, translation))
+{
+return false;
+}
+
+if(!refineTagPose(normalizedCorners, inputQRCodeDimension, numberOfRefinementIterations, rotation, translation))
+{
+return false;
+}
+
+invertTagPose(rotation, translation, inputCameraPoseBuffer);
+return true;
+}
+
+//The two precisions the library is built with
+template class QRCodePoseCore<float>;
+template class QRCodePoseCore<double>;
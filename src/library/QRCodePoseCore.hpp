@@ -0,0 +1,157 @@
+#ifndef QRCODEPOSECOREHPP
+#define QRCODEPOSECOREHPP
+
+#include<cmath>
+#include<limits>
+
+#include "SOMException.hpp"
+#include "QRCodeHomographyPose.hpp"
+#include <opencv2/core/core.hpp>
+
+//Declare handy constants
+static constexpr int QRCodePoseCoreNumberOfCorners = 4; //Every tag is a square described by exactly 4 corners
+static constexpr int QRCodePoseCoreUndistortionIterations = 10; //Fixed point iterations used to remove the lens distortion from a corner
+static constexpr int QRCodePoseCoreDefaultRefinementIterations = 5; //Gauss-Newton steps taken from the closed form pose
+static constexpr int QRCodePoseCoreMirroredPoseRefinementIterations = 10; //Gauss-Newton steps taken from the mirrored pose, which starts further from its minimum
+static constexpr double QRCodePoseCoreMinimumMirrorAngle = 1e-3; //Radians the mirrored tag normal has to differ by to count as a second solution
+
+/*
+This class is the pose math of the estimator written for a fixed number of corners (4) and a scalar type chosen at compile time (float or double, both of which are instantiated in QRCodePoseCore.cpp).  Everything is held in fixed size cv::Matx/cv::Vec types on the stack, so nothing is allocated and the compiler can unroll all of the loops.  A pose is found in three steps:
+
+1. The corners are undistorted into normalized image coordinates with the same fixed point iteration cv::undistortPoints uses (k1, k2, p1, p2, k3 model).
+2. A closed form pose is taken from the homography between the square and its quad (computeHomographyTagPose, which QRCodeBatchPoseSolver uses as well).
+3. The pose is refined with a few Gauss-Newton steps that minimize the distance between the projected and measured corners (in normalized coordinates), which is what makes it comparable to solvePnP when the corners are noisy.
+
+The camera pose is the closed form inverse of the tag pose.  The core can also grade a pose (corner reprojection RMS, quad area and viewing angle) and check the mirrored second pose that planar targets have, which the estimator uses to decide which tags need more than the closed form pose.  The float version is meant for targets where double math is slow (many ARM boards), while the double version mostly exists to measure what float costs in accuracy (see poseCoreBenchmark).
+*/
+template<typename ScalarType>
+class QRCodePoseCore
+{
+public:
+typedef cv::Point_<ScalarType> Corner;
+typedef cv::Matx<ScalarType, 3, 3> Rotation;
+typedef cv::Vec<ScalarType, 3> Translation;
+typedef cv::Matx<ScalarType, 4, 4> Pose;
+
+/*
+This function initializes the core with an identity camera matrix and no distortion.
+*/
+QRCodePoseCore();
+
+/*
+This function sets the camera model (converted to ScalarType).
+@param inputCameraMatrix: The 3x3 camera matrix for the frame size
+@param inputDistortionParameters: The 1x5 distortion parameters (k1, k2, p1, p2, k3)
+
+@exceptions: This function can throw exceptions
+*/
+void setCameraModel(const cv::Mat_<double> &inputCameraMatrix, const cv::Mat_<double> &inputDistortionParameters);
+
+/*
+This function removes the lens distortion from the corners of a tag and converts them to normalized image coordinates.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputNormalizedCornersBuffer: The buffer to store the normalized corners in
+*/
+void undistortCorners(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], Corner (&inputNormalizedCornersBuffer)[QRCodePoseCoreNumberOfCorners]) const;
+
+/*
+This function finds the pose of a tag relative to the camera in closed form from its homography.
+@param inputNormalizedCorners: The 4 undistorted corners in normalized image coordinates
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputRotationBuffer: The buffer to store the rotation (tag -> camera) in
+@param inputTranslationBuffer: The buffer to store the position of the tag center in camera coordinates in
+@return: true if the quad described a tag in front of the camera and false otherwise
+*/
+static bool estimateInitialTagPose(const Corner (&inputNormalizedCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, Rotation &inputRotationBuffer, Translation &inputTranslationBuffer);
+
+/*
+This function refines a tag pose with Gauss-Newton steps on the reprojection error of its corners.
+@param inputNormalizedCorners: The 4 undistorted corners in normalized image coordinates
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputNumberOfIterations: The most steps to take (it stops early once a step is negligible)
+@param inputRotation: The rotation (tag -> camera) to refine
+@param inputTranslation: The translation to refine
+@return: true if the refined pose is valid and false otherwise
+*/
+static bool refineTagPose(const Corner (&inputNormalizedCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, int inputNumberOfIterations, Rotation &inputRotation, Translation &inputTranslation);
+
+/*
+This function turns the pose of a tag relative to the camera into the pose of the camera in the coordinate system of the tag ([R^T, -R^T t]).
+@param inputRotation: The rotation (tag -> camera)
+@param inputTranslation: The position of the tag center in camera coordinates
+@param inputCameraPoseBuffer: The buffer to store the 4x4 camera pose in
+*/
+static void invertTagPose(const Rotation &inputRotation, const Translation &inputTranslation, Pose &inputCameraPoseBuffer);
+
+/*
+This function turns the pose of the camera in the coordinate system of a tag back into the pose of the tag relative to the camera (the inverse of invertTagPose).
+@param inputCameraPose: The 4x4 camera pose
+@param inputRotationBuffer: The buffer to store the rotation (tag -> camera) in
+@param inputTranslationBuffer: The buffer to store the position of the tag center in camera coordinates in
+*/
+static void invertCameraPose(const Pose &inputCameraPose, Rotation &inputRotationBuffer, Translation &inputTranslationBuffer);
+
+/*
+This function projects the corners of a tag into the frame, applying the lens distortion.
+@param inputRotation: The rotation (tag -> camera)
+@param inputTranslation: The position of the tag center in camera coordinates
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputPixelCornersBuffer: The buffer to store the 4 corners in pixels (in zbar order) in
+@return: true if all of the corners are in front of the camera and false otherwise
+*/
+bool projectCorners(const Rotation &inputRotation, const Translation &inputTranslation, ScalarType inputQRCodeDimension, Corner (&inputPixelCornersBuffer)[QRCodePoseCoreNumberOfCorners]) const;
+
+/*
+This function finds the root mean square distance between the corners of a tag and the corners projected from a camera pose.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraPose: The 4x4 camera pose (OpenCV format) in the coordinate system of the tag
+@return: The distance in pixels (infinity if the pose puts the tag behind the camera)
+*/
+ScalarType computeReprojectionRMS(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, const Pose &inputCameraPose) const;
+
+/*
+This function finds the area of the quad the corners of a tag make in the frame.
+@param inputPixelCorners: The 4 corners in pixels
+@return: The area in square pixels
+*/
+static ScalarType computeQuadArea(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners]);
+
+/*
+This function finds the angle between the normal of a tag and the line from the tag center to the camera.
+@param inputCameraPose: The 4x4 camera pose in the coordinate system of the tag
+@return: The angle in radians (0 when the tag is seen head on, approaching pi/2 when it is seen edge on)
+*/
+static ScalarType computeIncidenceAngle(const Pose &inputCameraPose);
+
+/*
+This function checks the second pose a square seen in perspective can have.  Small or distant tags can reproject almost as well with their normal mirrored about the line of sight, which is the usual way single tag poses go wrong.  Both the given and the mirrored pose are refined, and whichever reprojects better is kept.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraPose: The 4x4 camera pose to check, which is replaced by the better of the two refined poses
+@param inputAmbiguityRatioBuffer: The buffer to store the reprojection RMS of the rejected pose divided by that of the kept pose in (values close to 1 mean the pose is ambiguous), or 0 if there was no distinct second pose
+@return: true if the mirrored pose was kept and false otherwise
+*/
+bool checkMirroredCameraPose(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, Pose &inputCameraPose, ScalarType &inputAmbiguityRatioBuffer) const;
+
+/*
+This function does all of the steps above for one tag.
+@param inputPixelCorners: The 4 corners in pixels (in zbar order)
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraPoseBuffer: The buffer to store the 4x4 camera pose (OpenCV format) in
+@return: true if the pose was solved and false if the quad was degenerate
+*/
+bool solveCameraPose(const Corner (&inputPixelCorners)[QRCodePoseCoreNumberOfCorners], ScalarType inputQRCodeDimension, Pose &inputCameraPoseBuffer) const;
+
+int numberOfRefinementIterations; //0 returns the closed form pose
+
+private:
+ScalarType focalLengthX;
+ScalarType focalLengthY;
+ScalarType principalPointX;
+ScalarType principalPointY;
+ScalarType skew;
+ScalarType k1, k2, p1, p2, k3;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "QRCodePoseLog.hpp"
+
+#include<cmath>
+#include<cstring>
+#include<cerrno>
+
+/*
+This function converts the rotation part of a pose into a unit quaternion.
+@param inputPose: The 4x4 pose
+@param inputQuaternionBuffer: The buffer to store the quaternion in (w, x, y, z, with w >= 0)
+*/
+void convertPoseRotationToQuaternion(const cv::Matx44d &inputPose, double *inputQuaternionBuffer)
+{
+//Use the largest of the diagonal combinations, so the square root is never taken of a tiny number
+double trace = inputPose(0, 0) + inputPose(1, 1) + inputPose(2, 2);
+double w, x, y, z;
+if(trace > 0.0)
+{
+double scale = 2.0*sqrt(1.0 + trace);
+w = .25*scale;
+x = (inputPose(2, 1) - inputPose(1, 2)) / scale;
+y = (inputPose(0, 2) - inputPose(2, 0)) / scale;
+z = (inputPose(1, 0) - inputPose(0, 1)) / scale;
+}
+else if(inputPose(0, 0) > inputPose(1, 1) && inputPose(0, 0) > inputPose(2, 2))
+{
+double scale = 2.0*sqrt(1.0 + inputPose(0, 0) - inputPose(1, 1) - inputPose(2, 2));
+w = (inputPose(2, 1) - inputPose(1, 2)) / scale;
+x = .25*scale;
+y = (inputPose(0, 1) + inputPose(1, 0)) / scale;
+z = (inputPose(0, 2) + inputPose(2, 0)) / scale;
+}
+else if(inputPose(1, 1) > inputPose(2, 2))
+{
+double scale = 2.0*sqrt(1.0 + inputPose(1, 1) - inputPose(0, 0) - inputPose(2, 2));
+w = (inputPose(0, 2) - inputPose(2, 0)) / scale;
+x = (inputPose(0, 1) + inputPose(1, 0)) / scale;
+y = .25*scale;
+z = (inputPose(1, 2) + inputPose(2, 1)) / scale;
+}
+else
+{
+double scale = 2.0*sqrt(1.0 + inputPose(2, 2) - inputPose(0, 0) - inputPose(1, 1));
+w = (inputPose(1, 0) - inputPose(0, 1)) / scale;
+x = (inputPose(0, 2) + inputPose(2, 0)) / scale;
+y = (inputPose(1, 2) + inputPose(2, 1)) / scale;
+z = .25*scale;
+}
+
+//q and -q are the same rotation, so pick the one with w >= 0 to keep logs comparable
+double sign = w < 0.0 ? -1.0 : 1.0;
+double norm = sqrt(w*w + x*x + y*y + z*z);
+inputQuaternionBuffer[0] = sign*w/norm;
+inputQuaternionBuffer[1] = sign*x/norm;
+inputQuaternionBuffer[2] = sign*y/norm;
+inputQuaternionBuffer[3] = sign*z/norm;
+}
+
+/*
+This function creates the log file.
+@param inputFilePath: Where to write the log
+@param inputFormat: The format to write it in
+
+@exceptions: This function can throw exceptions
+*/
+QRCodePoseLogWriter::QRCodePoseLogWriter(const std::string &inputFilePath, QRCodePoseLogFormat inputFormat) : file(NULL), format(inputFormat)
+{
+static_assert(sizeof(QRCodePoseLogFileHeader) == 16, "Pose log file header must be 16 bytes");
+static_assert(sizeof(QRCodePoseLogRecord) == 96, "Pose log record must be 96 bytes");
+
+if(inputFormat != POSE_LOG_CSV && inputFormat != POSE_LOG_BINARY)
+{
+throw SOMException(std::string("Unknown pose log format\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+file = fopen(inputFilePath.c_str(), inputFormat == POSE_LOG_CSV ? "w" : "wb");
+if(file == NULL)
+{
+throw SOMException(std::string("Unable to create pose log ") + inputFilePath + ": " + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+SOMScopeGuard fileGuard([&](){fclose(file); file = NULL;});
+
+//Poses are small, so write them to disk in large blocks
+setvbuf(file, NULL, _IOFBF, QRCodePoseLogWriteBufferSize);
+
+bool headerWasWritten = false;
+if(format == POSE_LOG_CSV)
+{
+headerWasWritten = fprintf(file, "frame_index,frame_time,identifier,dimension,x,y,z,qw,qx,qy,qz\n") > 0;
+}
+else
+{
+QRCodePoseLogFileHeader fileHeader;
+memset(&fileHeader, 0, sizeof(fileHeader));
+fileHeader.magicNumber = QRCodePoseLogFileMagicNumber;
+fileHeader.version = QRCodePoseLogVersion;
+headerWasWritten = fwrite(&fileHeader, sizeof(fileHeader), 1, file) == 1;
+}
+
+if(!headerWasWritten)
+{
+throw SOMException(std::string("Unable to write pose log header: ") + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+
+fileGuard.dismiss();
+}
+
+/*
+This function appends one pose to the log.
+@param inputFrameIndex: The index of the frame the pose came from
+@param inputFrameTime: The time of the frame in seconds from the start of the video
+@param inputDetection: The detection to write
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodePoseLogWriter::writePose(uint64_t inputFrameIndex, double inputFrameTime, const QRCodeDetection &inputDetection)
+{
+if(file == NULL)
+{
+throw SOMException(std::string("Pose log has already been closed\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+double orientation[4];
+convertPoseRotationToQuaternion(inputDetection.cameraPose, orientation);
+
+bool poseWasWritten = false;
+if(format == POSE_LOG_CSV)
+{
+//Identifiers are quoted, with any quotes in them doubled
+std::string quotedIdentifier = "\"";
+for(size_t i=0; i < inputDetection.QRCodeIdentifierLength; i++)
+{
+quotedIdentifier += inputDetection.QRCodeIdentifier[i];
+if(inputDetection.QRCodeIdentifier[i] == '"')
+{
+quotedIdentifier += '"';
+}
+}
+quotedIdentifier += "\"";
+
+poseWasWritten = fprintf(file, "%llu,%.6f,%s,%.6f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f\n", (unsigned long long) inputFrameIndex, inputFrameTime, quotedIdentifier.c_str(), inputDetection.QRCodeDimension, inputDetection.cameraPose(0, 3), inputDetection.cameraPose(1, 3), inputDetection.cameraPose(2, 3), orientation[0], orientation[1], orientation[2], orientation[3]) > 0;
+}
+else
+{
+QRCodePoseLogRecord record;
+memset(&record, 0, sizeof(record));
+record.frameIndex = inputFrameIndex;
+record.frameTime = inputFrameTime;
+for(int i=0; i < 3; i++)
+{
+record.position[i] = inputDetection.cameraPose(i, 3);
+}
+memcpy(record.orientation, orientation, sizeof(record.orientation));
+record.QRCodeDimension = inputDetection.QRCodeDimension;
+record.QRCodeIdentifierHash = inputDetection.QRCodeIdentifierHash;
+record.identifierLength = inputDetection.QRCodeIdentifierLength;
+
+poseWasWritten = fwrite(&record, sizeof(record), 1, file) == 1 && (record.identifierLength == 0 || fwrite(inputDetection.QRCodeIdentifier, 1, record.identifierLength, file) == record.identifierLength);
+}
+
+if(!poseWasWritten)
+{
+throw SOMException(std::string("Unable to write to pose log: ") + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+/*
+This function flushes and closes the file.  It is called by the destructor if it has not been called already.
+
+@exceptions: This function can throw exceptions
+*/
+void QRCodePoseLogWriter::close()
+{
+if(file == NULL)
+{
+return;
+}
+
+bool writeFailed = fflush(file) != 0 || ferror(file) != 0;
+int closeResult = fclose(file);
+file = NULL;
+if(writeFailed || closeResult != 0)
+{
+throw SOMException(std::string("Error finishing pose log: ") + strerror(errno) + "\n", FILE_SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+/*
+This destructor closes the file (ignoring any errors).
+*/
+QRCodePoseLogWriter::~QRCodePoseLogWriter()
+{
+try
+{
+close();
+}
+catch(const std::exception &inputException)
+{
+}
+}
@@ -0,0 +1,96 @@
+#ifndef QRCODEPOSELOGHPP
+#define QRCODEPOSELOGHPP
+
+#include<string>
+#include<cstdio>
+#include<cstdint>
+
+#include "SOMException.hpp"
+#include "SOMScopeGuard.hpp"
+#include "QRCodeStateEstimator.hpp"
+
+//Declare handy constants
+static const uint32_t QRCodePoseLogFileMagicNumber = 0x4C505251; //"QRPL"
+static const uint32_t QRCodePoseLogVersion = 1;
+static constexpr size_t QRCodePoseLogWriteBufferSize = 1 << 20; //Bytes buffered before each write to disk
+
+enum QRCodePoseLogFormat
+{
+POSE_LOG_CSV = 0, //One line per pose: frame_index,frame_time,identifier,dimension,x,y,z,qw,qx,qy,qz
+POSE_LOG_BINARY = 1 //A QRCodePoseLogFileHeader followed by one QRCodePoseLogRecord (plus its identifier) per pose
+};
+
+/*
+A binary pose log is a 16 byte file header followed by one record per pose, in frame order.  Each record is a fixed size QRCodePoseLogRecord followed by identifierLength bytes of identifier (not null terminated or padded).  All values are little endian.
+*/
+struct QRCodePoseLogFileHeader
+{
+uint32_t magicNumber;
+uint32_t version;
+uint32_t reserved[2];
+};
+
+struct QRCodePoseLogRecord
+{
+uint64_t frameIndex;
+double frameTime; //Seconds from the start of the video
+double position[3]; //Position of the camera in the coordinate system of the QR code (meters)
+double orientation[4]; //Orientation of the camera in the coordinate system of the QR code as a unit quaternion (w, x, y, z)
+double QRCodeDimension; //Length of one side of the QR code in meters
+uint64_t QRCodeIdentifierHash; //hashQRCodeIdentifier() of the full identifier
+uint32_t identifierLength; //Number of identifier bytes that follow the record
+uint32_t reserved;
+};
+
+/*
+This function converts the rotation part of a pose into a unit quaternion.
+@param inputPose: The 4x4 pose
+@param inputQuaternionBuffer: The buffer to store the quaternion in (w, x, y, z, with w >= 0)
+*/
+void convertPoseRotationToQuaternion(const cv::Matx44d &inputPose, double *inputQuaternionBuffer);
+
+/*
+This class writes camera poses to a CSV or binary log file, in the order they are given.
+*/
+class QRCodePoseLogWriter
+{
+public:
+/*
+This function creates the log file.
+@param inputFilePath: Where to write the log
+@param inputFormat: The format to write it in
+
+@exceptions: This function can throw exceptions
+*/
+QRCodePoseLogWriter(const std::string &inputFilePath, QRCodePoseLogFormat inputFormat);
+
+/*
+This function appends one pose to the log.
+@param inputFrameIndex: The index of the frame the pose came from
+@param inputFrameTime: The time of the frame in seconds from the start of the video
+@param inputDetection: The detection to write
+
+@exceptions: This function can throw exceptions
+*/
+void writePose(uint64_t inputFrameIndex, double inputFrameTime, const QRCodeDetection &inputDetection);
+
+/*
+This function flushes and closes the file.  It is called by the destructor if it has not been called already.
+
+@exceptions: This function can throw exceptions
+*/
+void close();
+
+/*
+This destructor closes the file (ignoring any errors).
+*/
+~QRCodePoseLogWriter();
+
+private:
+QRCodePoseLogWriter(const QRCodePoseLogWriter &inputQRCodePoseLogWriter) = delete; //Disable copying of the object
+
+FILE *file;
+QRCodePoseLogFormat format;
+};
+
+#endif
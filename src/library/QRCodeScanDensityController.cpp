@@ -0,0 +1,82 @@
+#include "QRCodeScanDensityController.hpp"
+
+/*
+This function initializes the controller to scan every line.
+@param inputMaximumDensity: The sparsest scanning allowed (1 disables adaptation)
+@param inputScanLinesPerTag: The number of scan lines that should cross the smallest tag in view
+*/
+QRCodeScanDensityController::QRCodeScanDensityController(int inputMaximumDensity, double inputScanLinesPerTag) : maximumDensity(std::max(1, inputMaximumDensity)), scanLinesPerTag(std::max(1.0, inputScanLinesPerTag))
+{
+reset();
+}
+
+/*
+This function returns the density to use for the next frame.
+@return: The scan density (1 means every line)
+*/
+int QRCodeScanDensityController::getDensity() const
+{
+return density;
+}
+
+/*
+This function updates the density with the results of the last frame.
+@param inputNumberOfDetections: The number of tags found in the last frame
+@param inputSmallestTagSideInPixels: The length of the shortest side of any tag found in the last frame (ignored if none were found)
+@return: The scan density to use for the next frame
+*/
+int QRCodeScanDensityController::update(int inputNumberOfDetections, double inputSmallestTagSideInPixels)
+{
+//Losing a tag that was being seen (fewer detections than usual by a whole tag) counts as a miss
+bool frameMissedTags = averageNumberOfDetections > .5 && inputNumberOfDetections < averageNumberOfDetections - .5;
+averageNumberOfDetections = (1.0 - QRCodeScanDensityAverageWeight)*averageNumberOfDetections + QRCodeScanDensityAverageWeight*inputNumberOfDetections;
+
+if(frameMissedTags)
+{
+numberOfConsecutiveHits = 0;
+numberOfConsecutiveMisses++;
+density = numberOfConsecutiveMisses >= QRCodeScanDensityMissesBeforeFullDensity ? 1 : std::max(1, density / 2);
+return density;
+}
+numberOfConsecutiveMisses = 0;
+
+if(inputNumberOfDetections <= 0)
+{
+//Nothing in view, so search with every line
+numberOfConsecutiveHits = 0;
+density = 1;
+return density;
+}
+
+//Sparsest density that still puts enough lines across the smallest tag
+int sizeLimitedDensity = (int) std::floor(inputSmallestTagSideInPixels / scanLinesPerTag);
+sizeLimitedDensity = std::min(maximumDensity, std::max(1, sizeLimitedDensity));
+
+if(density > sizeLimitedDensity)
+{
+//Tags got smaller, don't wait for a miss
+numberOfConsecutiveHits = 0;
+density = sizeLimitedDensity;
+return density;
+}
+
+numberOfConsecutiveHits++;
+if(numberOfConsecutiveHits >= QRCodeScanDensityHitsBeforeIncrease && density < sizeLimitedDensity)
+{
+numberOfConsecutiveHits = 0;
+density++;
+}
+
+return density;
+}
+
+/*
+This function goes back to scanning every line and forgets the detection history.
+*/
+void QRCodeScanDensityController::reset()
+{
+density = 1;
+numberOfConsecutiveHits = 0;
+numberOfConsecutiveMisses = 0;
+averageNumberOfDetections = 0.0;
+}
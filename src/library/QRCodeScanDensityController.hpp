@@ -0,0 +1,56 @@
+#ifndef QRCODESCANDENSITYCONTROLLERHPP
+#define QRCODESCANDENSITYCONTROLLERHPP
+
+#include<algorithm>
+#include<cmath>
+
+//Declare handy constants
+static constexpr int QRCodeDefaultMaximumScanDensity = 4; //Never scan fewer than 1 in 4 rows/columns
+static constexpr double QRCodeDefaultScanLinesPerTag = 12.0; //Scan lines wanted across the smallest tag (about 3 through each finder pattern)
+static constexpr int QRCodeScanDensityHitsBeforeIncrease = 5; //Frames in a row with all tags found before scanning gets sparser
+static constexpr int QRCodeScanDensityMissesBeforeFullDensity = 3; //Frames in a row with tags lost before going back to every line
+static constexpr double QRCodeScanDensityAverageWeight = .2; //Weight of the newest frame in the average number of detections
+
+/*
+This class picks zbar's scan line density (ZBAR_CFG_X_DENSITY/ZBAR_CFG_Y_DENSITY, where N means every Nth row and column is scanned) from frame to frame.  zbar finds QR codes by their finder patterns along scan lines, so the density can go up as long as enough lines still cross the smallest tag in view.  The controller moves up one step at a time while every frame keeps finding its tags and drops back (halving the density, then going to every line) as soon as detections go missing, so a lost tag costs at most a few frames.
+*/
+class QRCodeScanDensityController
+{
+public:
+/*
+This function initializes the controller to scan every line.
+@param inputMaximumDensity: The sparsest scanning allowed (1 disables adaptation)
+@param inputScanLinesPerTag: The number of scan lines that should cross the smallest tag in view
+*/
+QRCodeScanDensityController(int inputMaximumDensity = QRCodeDefaultMaximumScanDensity, double inputScanLinesPerTag = QRCodeDefaultScanLinesPerTag);
+
+/*
+This function returns the density to use for the next frame.
+@return: The scan density (1 means every line)
+*/
+int getDensity() const;
+
+/*
+This function updates the density with the results of the last frame.
+@param inputNumberOfDetections: The number of tags found in the last frame
+@param inputSmallestTagSideInPixels: The length of the shortest side of any tag found in the last frame (ignored if none were found)
+@return: The scan density to use for the next frame
+*/
+int update(int inputNumberOfDetections, double inputSmallestTagSideInPixels);
+
+/*
+This function goes back to scanning every line and forgets the detection history.
+*/
+void reset();
+
+int maximumDensity;
+double scanLinesPerTag;
+
+private:
+int density;
+int numberOfConsecutiveHits;
+int numberOfConsecutiveMisses;
+double averageNumberOfDetections;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "QRCodeStateEstimator.hpp" 
 
+#include<cstring>
+
 /*
 This function initializes the state estimator with the OpenCV camera calibration parameter so that it can determine pose using the camera parameters.
 @param inputCameraImageWidth: The width of camera images used in the camera calibration
@@ -48,11 +50,39 @@ expectedCameraImageHeight = inputCameraImageHeight;
 
 cameraMatrix = inputCameraCalibrationMatrix;
 distortionParameters = inputCameraDistortionParameters;
+frameCameraMatrix = cameraMatrix.clone();
+frameCameraMatrixWidth = expectedCameraImageWidth;
+frameCameraMatrixHeight = expectedCameraImageHeight;
+SOM_TRY
+singlePrecisionPoseCore.setCameraModel(frameCameraMatrix, distortionParameters);
+SOM_CATCH("Error setting up single precision pose core\n")
+singlePrecisionPoseSolveIsEnabled = false;
+SOM_TRY
+poseQualityCore.setCameraModel(frameCameraMatrix, distortionParameters);
+SOM_CATCH("Error setting up pose quality core\n")
+poseQualityCore.numberOfRefinementIterations = 0;
+poseQualityGatingIsEnabled = false;
+poseQualityThresholds.maximumReprojectionRMS = QRCodeDefaultMaximumReprojectionRMS;
+poseQualityThresholds.minimumQuadArea = QRCodeDefaultMinimumQuadArea;
+poseQualityThresholds.maximumIncidenceAngle = QRCodeDefaultMaximumIncidenceAngle;
+contrastEnhancementTracksTags = true;
+contrastEnhancementFullFrameInterval = QRCodeDefaultContrastEnhancementFullFrameInterval;
+framesSinceFullFrameContrastEnhancement = 0;
+trackedTagRegions.reserve(QRCodeMaximumDetectionsPerFrame);
 showResultsInWindow = inputShowResultsInWindow;
-
-//Configure the QR code reader object
+detectionsBuffer.resize(QRCodeMaximumDetectionsPerFrame);
+minimumNumberOfTagsForBatchPoseSolve = QRCodeDefaultMinimumNumberOfTagsForBatchPoseSolve;
+batchPoseSolver.reserve(QRCodeMaximumDetectionsPerFrame);
+adaptiveScanDensityIsEnabled = false;
+appliedScanDensity = 0;
+latencyTraceTrackIndex = 0;
+numberOfFramesProcessed = 0;
+
+//Configure the QR code reader object (turning off the other decoders so zbar doesn't also look for bar codes along every scan line)
+zbarScanner.set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_ENABLE, 0);
 zbarScanner.set_config(zbar::ZBAR_QRCODE , zbar::ZBAR_CFG_ENABLE, 1);
 zbarScanner.enable_cache(false); //Set it so that it will show QR code result even if it was in the last frame
+zbarFrame.set_format("Y800"); //8 bit grayscale
 
 //Create window to show results, if we are suppose to
 if(showResultsInWindow == true)
@@ -61,50 +91,97 @@ cv::namedWindow(QRCodeStateEstimatorWindowTitle, CV_WINDOW_AUTOSIZE);
 }
 }
 
+/*
+This function initializes the state estimator with a calibration loaded by loadCameraCalibration (or filled in by hand).
+@param inputCameraCalibration: The image size, camera matrix and distortion parameters of the camera
+@param inputShowResultsInWindow: True if you would like the QR results to be shown in a window
+
+@exception: This function can throw exceptions
+*/
+QRCodeStateEstimator::QRCodeStateEstimator(const QRCodeCameraCalibration &inputCameraCalibration, bool inputShowResultsInWindow) : QRCodeStateEstimator(inputCameraCalibration.imageWidth, inputCameraCalibration.imageHeight, inputCameraCalibration.cameraMatrix, inputCameraCalibration.distortionParameters, inputShowResultsInWindow)
+{
+}
+
+/*
+This function loads a calibration file so that it can be handed to the calibration constructor.
+@param inputCalibrationFilePath: The OpenCV calibration file
+@return: The loaded calibration
+
+@exception: This function can throw exceptions
+*/
+static QRCodeCameraCalibration loadCameraCalibrationForEstimator(const std::string &inputCalibrationFilePath)
+{
+QRCodeCameraCalibration calibration;
+
+SOM_TRY
+loadCameraCalibration(inputCalibrationFilePath, calibration, true);
+SOM_CATCH("Error loading camera calibration\n")
+
+return calibration;
+}
+
+/*
+This function initializes the state estimator from an OpenCV XML/YAML camera calibration file, using (and creating) the binary calibration cache next to it so later starts skip the XML/YAML parsing.
+@param inputCalibrationFilePath: The OpenCV calibration file
+@param inputShowResultsInWindow: True if you would like the QR results to be shown in a window
+
+@exception: This function can throw exceptions
+*/
+QRCodeStateEstimator::QRCodeStateEstimator(const std::string &inputCalibrationFilePath, bool inputShowResultsInWindow) : QRCodeStateEstimator(loadCameraCalibrationForEstimator(inputCalibrationFilePath), inputShowResultsInWindow)
+{
+}
+
 /*
 This function takes a BGR frame of the appropriate size, scans for a QR code with an embedded size (recognized decimal formats: ft, in, cm, mm, m), and stores the pose of the camera (OpenCV format) relative to the coordinate system of the QR tag in the provided buffer.  If multiple tags are recognized, it will only return the information for the first.
-@param inputBGRFrame: The frame to process (should be same size as calibration)
+@param inputBGRFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPoseBuffer: The buffer to place the 4x4 camera pose matrix in
 @param inputQRCodeIdentifierBuffer: A buffer to place left text from the QR code after the dimension information has been removed
 @param inputQRCodeDimensionBuffer: A buffer to place size of the QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool QRCodeStateEstimator::estimateStateFromBGRFrame(const cv::Mat &inputBGRFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer)
+bool QRCodeStateEstimator::estimateStateFromBGRFrame(const cv::Mat &inputBGRFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer, QRCodeFrameTimestamps *inputFrameTimestamps)
 {
-if(inputBGRFrame.channels() != 3)
-{
-throw SOMException(std::string("Given frame is not BGR\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
-}
-
-//Convert the frame to grayscale
-cvtColor(inputBGRFrame, frameBuffer, CV_BGR2GRAY);
+std::vector<cv::Mat> cameraPosesBuffer;
+std::vector<std::string> QRCodeIdentifiersBuffer;
+std::vector<double> QRCodeDimensionBuffer;
+bool returnValue;
 
-//Get the pose using the grayscale version
 SOM_TRY
-return estimateStateFromGrayscaleFrame(frameBuffer, inputCameraPoseBuffer, inputQRCodeIdentifierBuffer, inputQRCodeDimensionBuffer);
+returnValue = estimateOneOrMoreStatesFromBGRFrame(inputBGRFrame, cameraPosesBuffer, QRCodeIdentifiersBuffer, QRCodeDimensionBuffer, inputFrameTimestamps);
 SOM_CATCH("Error calculating pose from image\n")
+
+if(cameraPosesBuffer.size() > 0)
+{
+inputCameraPoseBuffer = cameraPosesBuffer[0];
+inputQRCodeIdentifierBuffer = QRCodeIdentifiersBuffer[0];
+inputQRCodeDimensionBuffer = QRCodeDimensionBuffer[0];
+}
+
+return returnValue;
 }
 
 /*
 This function takes a grayscale frame of the appropriate size, scans for a QR code with an embedded size (recognized decimal formats: ft, in, cm, mm, m), and stores the pose of the camera (OpenCV format) relative to the coordinate system of the QR tag in the provided buffer.  If multiple tags are recognized, it will only return the information for the first.
-@param inputGrayscaleFrame: The frame to process (should be same size as calibration)
+@param inputGrayscaleFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPoseBuffer: The buffer to place the 4x4 camera pose matrix in
 @param inputQRCodeIdentifierBuffer: A buffer to place left text from the QR code after the dimension information has been removed
 @param inputQRCodeDimensionBuffer: A buffer to place size of the QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool QRCodeStateEstimator::estimateStateFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer)
+bool QRCodeStateEstimator::estimateStateFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer, QRCodeFrameTimestamps *inputFrameTimestamps)
 {
 std::vector<cv::Mat> cameraPosesBuffer;
 std::vector<std::string> QRCodeIdentifiersBuffer;
 std::vector<double> QRCodeDimensionBuffer;
 bool returnValue;
 
-returnValue = estimateOneOrMoreStatesFromGrayscaleFrame(inputGrayscaleFrame, cameraPosesBuffer, QRCodeIdentifiersBuffer, QRCodeDimensionBuffer);
+returnValue = estimateOneOrMoreStatesFromGrayscaleFrame(inputGrayscaleFrame, cameraPosesBuffer, QRCodeIdentifiersBuffer, QRCodeDimensionBuffer, inputFrameTimestamps);
 
 if(cameraPosesBuffer.size() > 0)
 {
@@ -118,95 +195,226 @@ return returnValue;
 
 /*
 This function takes a BGR frame of the appropriate size, scans for a QR codes with an embedded size (recognized decimal formats: ft, in, cm, mm, m), and stores the poses of the camera (OpenCV format) relative to the different coordinate systems of the QR tags in the provided buffer.
-@param inputBGRFrame: The frame to process (should be same size as calibration)
+@param inputBGRFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPosesBuffer: The buffer to place the 4x4 camera pose matrices in
 @param inputQRCodeIdentifiersBuffer: A buffer to place the text left from each QR code after the dimension information has been removed
 @param inputQRCodeDimensionsBuffer: A buffer to place size of each QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool QRCodeStateEstimator::estimateOneOrMoreStatesFromBGRFrame(const cv::Mat &inputBGRFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer)
+bool QRCodeStateEstimator::estimateOneOrMoreStatesFromBGRFrame(const cv::Mat &inputBGRFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps)
 {
 if(inputBGRFrame.channels() != 3)
 {
 throw SOMException(std::string("Given frame is not BGR\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
 }
 
-//Convert the frame to grayscale
-cvtColor(inputBGRFrame, frameBuffer, CV_BGR2GRAY);
+//Make sure the intrinsics match the frame size (this gives a more detailed error than the status code)
+updateCameraMatrixForFrameSize(inputBGRFrame.cols, inputBGRFrame.rows);
+
+int numberOfDetections = 0;
+QRCodeEstimationStatus status = tryEstimateStatesFromBGRFrame(inputBGRFrame, detectionsBuffer.data(), detectionsBuffer.size(), numberOfDetections, inputFrameTimestamps);
 
-//Get the pose using the grayscale version
 SOM_TRY
-return estimateOneOrMoreStatesFromGrayscaleFrame(frameBuffer, inputCameraPosesBuffer, inputQRCodeIdentifiersBuffer, inputQRCodeDimensionsBuffer);
+return copyDetectionsToBuffers(status, numberOfDetections, inputCameraPosesBuffer, inputQRCodeIdentifiersBuffer, inputQRCodeDimensionsBuffer);
 SOM_CATCH("Error calculating pose from image\n")
 }
 
 /*
 This function takes a grayscale frame of the appropriate size, scans for any QR codes with an embedded sizes (recognized decimal formats: ft, in, cm, mm, m), and stores the poses of the camera (OpenCV format) relative to the different coordinate systems of the QR tags in the provided buffers.
-@param inputGrayscaleFrame: The frame to process (should be same size as calibration)
+@param inputGrayscaleFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPosesBuffer: The buffer to place the 4x4 camera pose matrices in
 @param inputQRCodeIdentifiersBuffer: A buffer to place the text left from each QR code after the dimension information has been removed
 @param inputQRCodeDimensionsBuffer: A buffer to place size of each QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool QRCodeStateEstimator::estimateOneOrMoreStatesFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer)
+bool QRCodeStateEstimator::estimateOneOrMoreStatesFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps)
 {
 if(inputGrayscaleFrame.channels() != 1)
 {
 throw SOMException(std::string("Given frame is not grayscale\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
 }
 
-//Wrap the image data so that it can be used by zbar
-int frameWidth = inputGrayscaleFrame.cols;
-int frameHeight = inputGrayscaleFrame.rows;
-uchar *rawData = (uchar *)(inputGrayscaleFrame.data);
+//Make sure the intrinsics match the frame size (this gives a more detailed error than the status code)
+updateCameraMatrixForFrameSize(inputGrayscaleFrame.cols, inputGrayscaleFrame.rows);
+
+QRCodeFrameTimestamps frameTimestamps;
+beginFrameTimestamps(inputFrameTimestamps, frameTimestamps);
 
+//zbar needs the rows back to back, so copy frames that are a region of a larger image
+const cv::Mat *frameToProcess = &inputGrayscaleFrame;
+if(!inputGrayscaleFrame.isContinuous())
+{
+inputGrayscaleFrame.copyTo(continuousFrameBuffer);
+frameToProcess = &continuousFrameBuffer;
+}
+frameTimestamps.grayscaleConversionFinishedTimestamp = getQRCodeTimestamp();
 
-// Wrap image data
-zbar::Image zbarFrame(frameWidth, frameHeight, "Y800", rawData, frameWidth * frameHeight);
-SOMScopeGuard zbarFrameGuard([&](){zbarFrame.set_data(NULL, 0);});
+int numberOfDetections = 0;
+QRCodeEstimationStatus status = estimateStatesFromContinuousGrayscaleFrame(*frameToProcess, detectionsBuffer.data(), detectionsBuffer.size(), numberOfDetections, frameTimestamps);
+finishFrameTimestamps(status, numberOfDetections, frameTimestamps, inputFrameTimestamps);
 
-//Scan for QR codes
-if(zbarScanner.scan(zbarFrame) == -1)
+SOM_TRY
+return copyDetectionsToBuffers(status, numberOfDetections, inputCameraPosesBuffer, inputQRCodeIdentifiersBuffer, inputQRCodeDimensionsBuffer);
+SOM_CATCH("Error calculating pose from image\n")
+}
+
+/*
+This function is the exception free version of estimateOneOrMoreStatesFromBGRFrame.  Once the internal grayscale buffer has been allocated for the frame size, the estimator's own buffers are not allocated again for bad frames or undecodable payloads (zbar may still allocate inside its scan).
+@param inputBGRFrame: The 8 bit BGR frame to process (the calibration size or a scaled/binned version of it)
+@param inputDetectionsBuffer: The array to store the detections in
+@param inputDetectionsBufferSize: How many detections the array can hold (the lowest priority tags beyond that are dropped)
+@param inputNumberOfDetectionsBuffer: The buffer to store the number of detections written in
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
+@return: QRCODE_STATUS_OK if one or more poses were estimated, otherwise the reason why not
+*/
+QRCodeEstimationStatus QRCodeStateEstimator::tryEstimateStatesFromBGRFrame(const cv::Mat &inputBGRFrame, QRCodeDetection *inputDetectionsBuffer, int inputDetectionsBufferSize, int &inputNumberOfDetectionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps) noexcept
+{
+inputNumberOfDetectionsBuffer = 0;
+
+QRCodeFrameTimestamps frameTimestamps;
+beginFrameTimestamps(inputFrameTimestamps, frameTimestamps);
+
+QRCodeEstimationStatus status = QRCODE_STATUS_INVALID_FRAME;
+if(inputBGRFrame.type() == CV_8UC3 && inputBGRFrame.dims == 2 && inputBGRFrame.data != NULL)
+{
+//Convert the frame to grayscale (frameBuffer is only reallocated when the frame size changes)
+bool frameWasConverted = false;
+try
+{
+cvtColor(inputBGRFrame, frameBuffer, CV_BGR2GRAY);
+frameWasConverted = true;
+}
+catch(...)
 {
-printf("TestScanner error\n");
-throw SOMException(std::string("QR code scanner returned with error\n"), ZBAR_ERROR, __FILE__, __LINE__);
 }
 
-//Clear the buffers to store everything in
-inputCameraPosesBuffer.clear();
-inputQRCodeIdentifiersBuffer.clear();
-inputQRCodeDimensionsBuffer.clear();
+if(frameWasConverted)
+{
+frameTimestamps.grayscaleConversionFinishedTimestamp = getQRCodeTimestamp();
+status = estimateStatesFromContinuousGrayscaleFrame(frameBuffer, inputDetectionsBuffer, inputDetectionsBufferSize, inputNumberOfDetectionsBuffer, frameTimestamps);
+}
+}
+
+finishFrameTimestamps(status, inputNumberOfDetectionsBuffer, frameTimestamps, inputFrameTimestamps);
+return status;
+}
 
-for (zbar::Image::SymbolIterator symbol = zbarFrame.symbol_begin();  symbol != zbarFrame.symbol_end();  ++symbol) 
+/*
+This function is the exception free version of estimateOneOrMoreStatesFromGrayscaleFrame.  The estimator allocates nothing of its own for bad frames or undecodable payloads (the zbar image is reused from frame to frame), which keeps the cost of garbage frames bounded for real time threads.  zbar may still allocate inside its scan, and solvePnP while working on a valid tag.  A tag whose pose can't be solved is skipped rather than failing the frame.
+@param inputGrayscaleFrame: The continuous 8 bit grayscale frame to process (the calibration size or a scaled/binned version of it)
+@param inputDetectionsBuffer: The array to store the detections in
+@param inputDetectionsBufferSize: How many detections the array can hold (the lowest priority tags beyond that are dropped)
+@param inputNumberOfDetectionsBuffer: The buffer to store the number of detections written in
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
+@return: QRCODE_STATUS_OK if one or more poses were estimated, otherwise the reason why not
+*/
+QRCodeEstimationStatus QRCodeStateEstimator::tryEstimateStatesFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, QRCodeDetection *inputDetectionsBuffer, int inputDetectionsBufferSize, int &inputNumberOfDetectionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps) noexcept
 {
-if(symbol->get_type() != zbar::ZBAR_QRCODE || symbol->get_location_size() != 4)
+QRCodeFrameTimestamps frameTimestamps;
+beginFrameTimestamps(inputFrameTimestamps, frameTimestamps);
+frameTimestamps.grayscaleConversionFinishedTimestamp = frameTimestamps.estimationStartTimestamp;
+
+QRCodeEstimationStatus status = estimateStatesFromContinuousGrayscaleFrame(inputGrayscaleFrame, inputDetectionsBuffer, inputDetectionsBufferSize, inputNumberOfDetectionsBuffer, frameTimestamps);
+
+finishFrameTimestamps(status, inputNumberOfDetectionsBuffer, frameTimestamps, inputFrameTimestamps);
+return status;
+}
+
+/*
+This function starts the timestamps of a frame.
+@param inputFrameTimestamps: The timestamps given by the caller (NULL if none were given)
+@param inputFrameTimestampsBuffer: The buffer to start the timestamps in
+*/
+void QRCodeStateEstimator::beginFrameTimestamps(const QRCodeFrameTimestamps *inputFrameTimestamps, QRCodeFrameTimestamps &inputFrameTimestampsBuffer) noexcept
 {
-continue; //Skip if it isn't a QR code or its outline is described by more than 4 vertices
-} 
+inputFrameTimestampsBuffer = QRCodeFrameTimestamps();
+if(inputFrameTimestamps != NULL)
+{
+inputFrameTimestampsBuffer.captureTimestamp = inputFrameTimestamps->captureTimestamp;
+}
+inputFrameTimestampsBuffer.estimationStartTimestamp = getQRCodeTimestamp();
+inputFrameTimestampsBuffer.frameNumber = numberOfFramesProcessed;
+numberOfFramesProcessed++;
+}
 
-double QRCodeDimensionInMeters;
-std::string QRCodeIdentifierString;
-if(extractQRCodeDimensionFromString(symbol->get_data(), QRCodeDimensionInMeters, QRCodeIdentifierString) != true)
+/*
+This function finishes the timestamps of a frame, records them in the latency tracer (if there is one) and hands them back to the caller.
+@param inputStatus: The result of the frame
+@param inputNumberOfDetections: The number of detections in the frame
+@param inputFrameTimestamps: The timestamps of the frame
+@param inputFrameTimestampsBuffer: The caller's timestamps (NULL if none were given)
+*/
+void QRCodeStateEstimator::finishFrameTimestamps(QRCodeEstimationStatus inputStatus, int inputNumberOfDetections, QRCodeFrameTimestamps &inputFrameTimestamps, QRCodeFrameTimestamps *inputFrameTimestampsBuffer) noexcept
 {
-continue; //Couldn't read dimension
+inputFrameTimestamps.estimationFinishedTimestamp = getQRCodeTimestamp();
+inputFrameTimestamps.numberOfDetections = inputNumberOfDetections;
+inputFrameTimestamps.status = inputStatus;
+
+if(latencyTracer != nullptr)
+{
+latencyTracer->recordFrame(inputFrameTimestamps, latencyTraceTrackIndex);
 }
 
-//Convert zbar points to opencv points
-std::vector<cv::Point2d> openCVPoints;
-for(int i=0; i < symbol->get_location_size(); i++)
+if(inputFrameTimestampsBuffer != NULL)
 {
-openCVPoints.push_back(cv::Point2d(symbol->get_location_x(i), symbol->get_location_y(i)));
+*inputFrameTimestampsBuffer = inputFrameTimestamps;
+}
 }
 
+/*
+This function converts the results in detectionsBuffer into the vectors used by the exception throwing functions.
+@param inputStatus: The status returned by the exception free function
+@param inputNumberOfDetections: The number of detections in detectionsBuffer
+@param inputCameraPosesBuffer: The buffer to place the 4x4 camera pose matrices in
+@param inputQRCodeIdentifiersBuffer: A buffer to place the text left from each QR code after the dimension information has been removed
+@param inputQRCodeDimensionsBuffer: A buffer to place size of each QR code in meters 
+@return: true if there were any poses and false otherwise
 
-//The center of the coordinate system associated with the QR code is in the center of the rectangle
+@exceptions: This function can throw exceptions
+*/
+bool QRCodeStateEstimator::copyDetectionsToBuffers(QRCodeEstimationStatus inputStatus, int inputNumberOfDetections, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer)
+{
+if(inputStatus != QRCODE_STATUS_OK && inputStatus != QRCODE_STATUS_NO_QR_CODES)
+{
+throw SOMException(std::string(QRCodeEstimationStatusToString(inputStatus)) + "\n", inputStatus == QRCODE_STATUS_SCANNER_ERROR ? ZBAR_ERROR : INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+//Clear the buffers to store everything in
+inputCameraPosesBuffer.clear();
+inputQRCodeIdentifiersBuffer.clear();
+inputQRCodeDimensionsBuffer.clear();
+
+for(int i=0; i < inputNumberOfDetections; i++)
+{
+inputCameraPosesBuffer.push_back(cv::Mat(detectionsBuffer[i].cameraPose, true));
+inputQRCodeIdentifiersBuffer.push_back(std::string(detectionsBuffer[i].QRCodeIdentifier, detectionsBuffer[i].QRCodeIdentifierLength));
+inputQRCodeDimensionsBuffer.push_back(detectionsBuffer[i].QRCodeDimension);
+}
+
+return inputCameraPosesBuffer.size() > 0;
+}
 
-double buf = QRCodeDimensionInMeters/2.0;
-std::vector<cv::Point3d> objectVerticesInObjectCoordinates = 
+/*
+This function solves for the pose of the camera relative to one QR code without allocating any OpenCV matrices of its own.
+@param inputCorners: The 4 corners of the QR code in the frame
+@param inputQRCodeDimension: The length of one side of the QR code in meters
+@param inputCameraMatrix: The camera matrix for the frame size
+@param inputDistortionParameters: The 1x5 distortion parameters
+@param inputCameraPoseBuffer: The buffer to store the pose of the camera relative to the QR code in
+
+@exceptions: This function can throw exceptions (solvePnP can throw cv::Exception)
+*/
+static void solveQRCodeCameraPose(const cv::Point2d *inputCorners, double inputQRCodeDimension, const cv::Mat &inputCameraMatrix, const cv::Mat &inputDistortionParameters, cv::Matx44d &inputCameraPoseBuffer)
+{
+//The center of the coordinate system associated with the QR code is in the center of the rectangle
+double buf = inputQRCodeDimension/2.0;
+cv::Point3d objectVerticesInObjectCoordinates[4] = 
 {
 cv::Point3d(-buf, -buf, 0), 
 cv::Point3d(buf, -buf, 0),
@@ -214,156 +422,598 @@ cv::Point3d(buf, buf, 0),
 cv::Point3d(-buf, buf, 0)
 };
 
-//Make buffers to get 3x1 rotation vector and 3x1 translation vector
-cv::Mat_<double> rotationVector(3,1);
-cv::Mat_<double> translationVector(3,1);
-
+//Wrap the stack arrays in headers (same layout as std::vector<Point3d>/std::vector<Point2d>, but no allocation)
+cv::Mat objectPoints(4, 1, CV_64FC3, objectVerticesInObjectCoordinates);
+cv::Mat imagePoints(4, 1, CV_64FC2, const_cast<cv::Point2d *>(inputCorners));
 
 //Use solvePnP to get the rotation and translation vector of the QR code relative to the camera
-cv::solvePnP(objectVerticesInObjectCoordinates, openCVPoints, cameraMatrix, distortionParameters, rotationVector, translationVector);
+cv::Matx31d rotationVector;
+cv::Matx31d translationVector;
+cv::solvePnP(objectPoints, imagePoints, inputCameraMatrix, inputDistortionParameters, rotationVector, translationVector);
 
+//Get 3x3 rotation matrix (camera -> object)
+cv::Matx33d rotationMatrix;
+cv::Rodrigues(rotationVector, rotationMatrix);
 
-cv::Mat_<double> rotationMatrix, viewMatrix(4, 4);
+//The view matrix is a rigid transform, so its inverse is [R^T, -R^T t] (no need for a general matrix inverse)
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+inputCameraPoseBuffer(row, col) = rotationMatrix(col, row);
+}
+inputCameraPoseBuffer(row, 3) = -(rotationMatrix(0, row)*translationVector(0) + rotationMatrix(1, row)*translationVector(1) + rotationMatrix(2, row)*translationVector(2));
+inputCameraPoseBuffer(3, row) = 0.0;
+}
+inputCameraPoseBuffer(3, 3) = 1.0;
+}
 
-//Get 3x3 rotation matrix
-cv::Rodrigues(rotationVector, rotationMatrix);
+/*
+This function solves the camera pose for each of the given detections, using the batch solver if there are at least minimumNumberOfTagsForBatchPoseSolve of them and solvePnP (or singlePrecisionPoseCore if it is enabled) otherwise.  If poseQualityGatingIsEnabled, tags which aren't batch solved first try the closed form pose and only get the full solve and the mirrored pose check if it falls outside poseQualityThresholds.  Every solved detection is graded.  Detections whose pose can't be solved are removed (the rest keep their order).
+@param inputDetections: The detections with their corners and dimensions filled in
+@param inputNumberOfDetections: The number of detections, which is reduced by the number that were removed
+@return: The number of detections that were removed
+*/
+int QRCodeStateEstimator::solveDetectionPoses(QRCodeDetection *inputDetections, int &inputNumberOfDetections) noexcept
+{
+bool posesWereBatchSolved = false;
+if(minimumNumberOfTagsForBatchPoseSolve > 0 && inputNumberOfDetections >= minimumNumberOfTagsForBatchPoseSolve)
+{
+try
+{
+batchPoseSolver.clear();
+batchPoseSolver.reserve(inputNumberOfDetections);
+for(int i=0; i < inputNumberOfDetections; i++)
+{
+batchPoseSolver.addTag(inputDetections[i].corners, inputDetections[i].QRCodeDimension);
+}
+batchPoseSolver.solve(frameCameraMatrix, distortionParameters);
+posesWereBatchSolved = true;
+}
+catch(...)
+{
+//Fall back to solving them one at a time
+}
+}
 
-//Zero out view matrix
-viewMatrix = cv::Mat::zeros(4, 4, CV_64F); 
+int numberOfSolvedDetections = 0;
+for(int i=0; i < inputNumberOfDetections; i++)
+{
+bool poseWasSolved = false;
+bool poseNeedsFullSolve = true;
+bool poseIsGated = poseQualityGatingIsEnabled && !posesWereBatchSolved;
+inputDetections[i].ambiguityRatio = 0.0;
 
-//Get opencv transfer matrix (camera -> object)
-for(int row = 0; row < 3; row++)
+//Good tags keep the closed form pose, so only marginal ones pay for the full solve
+if(poseIsGated && poseQualityCore.solveCameraPose(inputDetections[i].corners, inputDetections[i].QRCodeDimension, inputDetections[i].cameraPose))
+{
+gradeDetectionPose(inputDetections[i]);
+poseNeedsFullSolve = !meetsPoseQualityThresholds(inputDetections[i], poseQualityThresholds);
+poseWasSolved = !poseNeedsFullSolve;
+}
+inputDetections[i].poseWasRefined = poseNeedsFullSolve && !posesWereBatchSolved; //Batch poses are closed form poses too
+
+if(!poseNeedsFullSolve)
+{
+//Already solved and graded
+}
+else if(posesWereBatchSolved)
+{
+poseWasSolved = batchPoseSolver.getCameraPose(i, inputDetections[i].cameraPose);
+}
+else if(singlePrecisionPoseSolveIsEnabled)
+{
+cv::Point2f corners[QRCodePoseCoreNumberOfCorners];
+for(int cornerIndex = 0; cornerIndex < QRCodePoseCoreNumberOfCorners; cornerIndex++)
+{
+corners[cornerIndex] = inputDetections[i].corners[cornerIndex];
+}
+
+cv::Matx44f cameraPose;
+poseWasSolved = singlePrecisionPoseCore.solveCameraPose(corners, (float) inputDetections[i].QRCodeDimension, cameraPose);
+for(int element = 0; element < 16; element++)
+{
+inputDetections[i].cameraPose.val[element] = cameraPose.val[element];
+}
+}
+else
+{
+try
 {
-for(int col = 0; col < 3; col ++)
+solveQRCodeCameraPose(inputDetections[i].corners, inputDetections[i].QRCodeDimension, frameCameraMatrix, distortionParameters, inputDetections[i].cameraPose);
+poseWasSolved = true;
+}
+catch(...)
 {
-viewMatrix.at<double>(row, col) = rotationMatrix.at<double>(row, col);
+//Degenerate quad, skip this tag
 }
-viewMatrix.at<double>(row, 3) = translationVector.at<double>(row, 0);
 }
-viewMatrix.at<double>(3,3) = 1.0;
 
+if(!poseWasSolved)
+{
+continue;
+}
 
-//Invert matrix to get position and orientation of camera relative to tag, storing it in a buffer
-cv::Mat cameraPoseBuffer;
-invert(viewMatrix, cameraPoseBuffer);
+if(poseNeedsFullSolve)
+{
+//Marginal tags are the ones whose pose may have settled on the wrong one of the two a square can have
+if(poseIsGated)
+{
+poseQualityCore.checkMirroredCameraPose(inputDetections[i].corners, inputDetections[i].QRCodeDimension, inputDetections[i].cameraPose, inputDetections[i].ambiguityRatio);
+}
+gradeDetectionPose(inputDetections[i]);
+}
 
-//Store in buffer vectors
-inputCameraPosesBuffer.push_back(cameraPoseBuffer);
-inputQRCodeIdentifiersBuffer.push_back(QRCodeIdentifierString);
-inputQRCodeDimensionsBuffer.push_back(QRCodeDimensionInMeters);
+if(numberOfSolvedDetections != i)
+{
+inputDetections[numberOfSolvedDetections] = inputDetections[i];
+}
+numberOfSolvedDetections++;
+}
 
-} //End symbol for loop
+int numberOfRemovedDetections = inputNumberOfDetections - numberOfSolvedDetections;
+inputNumberOfDetections = numberOfSolvedDetections;
+return numberOfRemovedDetections;
+}
 
-if(showResultsInWindow)
+/*
+This function fills in the reprojection RMS, quad area and incidence angle of a detection from its corners and camera pose.
+@param inputDetection: The detection to grade
+*/
+void QRCodeStateEstimator::gradeDetectionPose(QRCodeDetection &inputDetection) const noexcept
 {
-//Draw base image
-cv::Mat bufferFrame = inputGrayscaleFrame;
+inputDetection.reprojectionRMS = poseQualityCore.computeReprojectionRMS(inputDetection.corners, inputDetection.QRCodeDimension, inputDetection.cameraPose);
+inputDetection.quadArea = QRCodePoseCore<double>::computeQuadArea(inputDetection.corners);
+inputDetection.incidenceAngle = QRCodePoseCore<double>::computeIncidenceAngle(inputDetection.cameraPose);
+}
 
-// Draw location of the symbols found
-for (zbar::Image::SymbolIterator symbol = zbarFrame.symbol_begin();  symbol != zbarFrame.symbol_end();  ++symbol) 
+/*
+This function runs contrastEnhancer on a frame, over the whole frame or only around the tags found in the last frame if they are being tracked.
+@param inputGrayscaleFrame: The continuous 8 bit grayscale frame to enhance
+@return: The frame to scan, which is enhancedFrameBuffer or (if the enhancement failed) the given frame
+*/
+const cv::Mat &QRCodeStateEstimator::enhanceFrameContrast(const cv::Mat &inputGrayscaleFrame) noexcept
+{
+try
 {
-if(symbol->get_type() != zbar::ZBAR_QRCODE || symbol->get_location_size() != 4)
+bool enhanceOnlyTrackedTags = contrastEnhancementTracksTags && trackedTagRegions.size() > 0 && framesSinceFullFrameContrastEnhancement + 1 < contrastEnhancementFullFrameInterval;
+if(enhanceOnlyTrackedTags)
+{
+contrastEnhancer.enhanceRegions(inputGrayscaleFrame, trackedTagRegions.data(), trackedTagRegions.size(), enhancedFrameBuffer);
+framesSinceFullFrameContrastEnhancement++;
+}
+else
+{
+contrastEnhancer.enhanceFrame(inputGrayscaleFrame, enhancedFrameBuffer);
+framesSinceFullFrameContrastEnhancement = 0;
+}
+}
+catch(...)
+{
+return inputGrayscaleFrame; //Scan the frame as it is
+}
+
+return enhancedFrameBuffer;
+}
+
+/*
+This function remembers the areas around the given detections, so that the next frame's contrast enhancement can be limited to them.
+@param inputDetections: The detections of the frame
+@param inputNumberOfDetections: The number of detections
+*/
+void QRCodeStateEstimator::updateTrackedTagRegions(const QRCodeDetection *inputDetections, int inputNumberOfDetections) noexcept
+{
+trackedTagRegions.clear();
+for(int i=0; i < inputNumberOfDetections && trackedTagRegions.size() < trackedTagRegions.capacity(); i++)
+{
+double minimumX = inputDetections[i].corners[0].x;
+double maximumX = minimumX;
+double minimumY = inputDetections[i].corners[0].y;
+double maximumY = minimumY;
+for(int cornerIndex = 1; cornerIndex < 4; cornerIndex++)
+{
+minimumX = std::min(minimumX, inputDetections[i].corners[cornerIndex].x);
+maximumX = std::max(maximumX, inputDetections[i].corners[cornerIndex].x);
+minimumY = std::min(minimumY, inputDetections[i].corners[cornerIndex].y);
+maximumY = std::max(maximumY, inputDetections[i].corners[cornerIndex].y);
+}
+
+//Leave room for the tag to move before the next frame
+double margin = QRCodeTrackedRegionMargin * std::max(maximumX - minimumX, maximumY - minimumY);
+trackedTagRegions.push_back(cv::Rect((int) floor(minimumX - margin), (int) floor(minimumY - margin), (int) ceil(maximumX - minimumX + 2.0*margin) + 1, (int) ceil(maximumY - minimumY + 2.0*margin) + 1));
+}
+}
+
+/*
+This function scans a continuous 8 bit grayscale frame and solves the poses of the tags in it (the work shared by all of the estimation functions).  It stamps the end of the scan and of the pose solve.
+@param inputGrayscaleFrame: The frame to process
+@param inputDetectionsBuffer: The array to store the detections in
+@param inputDetectionsBufferSize: How many detections the array can hold (the lowest priority tags beyond that are dropped)
+@param inputNumberOfDetectionsBuffer: The buffer to store the number of detections written in
+@param inputFrameTimestamps: The timestamps of the frame
+@return: QRCODE_STATUS_OK if one or more poses were estimated, otherwise the reason why not
+*/
+QRCodeEstimationStatus QRCodeStateEstimator::estimateStatesFromContinuousGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, QRCodeDetection *inputDetectionsBuffer, int inputDetectionsBufferSize, int &inputNumberOfDetectionsBuffer, QRCodeFrameTimestamps &inputFrameTimestamps) noexcept
+{
+inputNumberOfDetectionsBuffer = 0;
+
+if(inputGrayscaleFrame.type() != CV_8UC1 || inputGrayscaleFrame.dims != 2 || inputGrayscaleFrame.data == NULL || !inputGrayscaleFrame.isContinuous() || (inputDetectionsBuffer == NULL && inputDetectionsBufferSize > 0))
+{
+return QRCODE_STATUS_INVALID_FRAME;
+}
+
+int frameWidth = inputGrayscaleFrame.cols;
+int frameHeight = inputGrayscaleFrame.rows;
+
+//Make sure the intrinsics match the frame size before doing any work on it
+if(!tryUpdateCameraMatrixForFrameSize(frameWidth, frameHeight))
+{
+return QRCODE_STATUS_UNSUPPORTED_FRAME_SIZE;
+}
+
+//Boost the local contrast first if it is enabled (zbar misses a lot of tags in dim light)
+const cv::Mat &scanFrame = contrastEnhancer.mode == CONTRAST_ENHANCEMENT_NONE ? inputGrayscaleFrame : enhanceFrameContrast(inputGrayscaleFrame);
+
+//Wrap the image data so that it can be used by zbar
+uchar *rawData = (uchar *)(scanFrame.data);
+
+QRCodeCornersBuffer.clear();
+int numberOfPoseSolverFailures = 0;
+
+//Only the highest priority tags allowed by the filter get pose work
+int maximumNumberOfDetections = inputDetectionsBufferSize;
+if(identifierFilter.maximumNumberOfPosesPerFrame > 0)
+{
+maximumNumberOfDetections = std::min(maximumNumberOfDetections, identifierFilter.maximumNumberOfPosesPerFrame);
+}
+
+int numberOfDecodedSymbols = 0;
+double smallestSymbolSideInPixels = 0.0;
+
+try
+{
+//Only tell zbar about the density when it changes
+int scanDensity = adaptiveScanDensityIsEnabled ? scanDensityController.getDensity() : 1;
+if(scanDensity != appliedScanDensity)
+{
+zbarScanner.set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_X_DENSITY, scanDensity);
+zbarScanner.set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_Y_DENSITY, scanDensity);
+appliedScanDensity = scanDensity;
+}
+
+//Point the persistent zbar image at the frame (creating one every frame would allocate)
+zbarFrame.set_size(frameWidth, frameHeight);
+zbarFrame.set_data(rawData, frameWidth * frameHeight);
+
+//Make sure it updates every frame, even if it found the qr code in the last frame
+SOMScopeGuard zbarFrameGuard([&](){zbarScanner.recycle_image(zbarFrame); zbarFrame.set_data(NULL, 0);});
+
+//Scan for QR codes
+if(zbarScanner.scan(zbarFrame) == -1)
+{
+return QRCODE_STATUS_SCANNER_ERROR;
+}
+
+//Walk the symbols with the zbar C API, since the C++ iterator copies each symbol's data into a std::string
+for(const zbar_symbol_t *symbol = zbar_image_first_symbol(zbarFrame); symbol != NULL && maximumNumberOfDetections > 0; symbol = zbar_symbol_next(symbol))
+{
+if(zbar_symbol_get_type(symbol) != zbar::ZBAR_QRCODE || zbar_symbol_get_loc_size(symbol) != 4)
 {
 continue; //Skip if it isn't a QR code or its outline is described by more than 4 vertices
 } 
 
-double QRCodeDimensionInMeters;
-std::string QRCodeIdentifierString;
-if(extractQRCodeDimensionFromString(symbol->get_data(), QRCodeDimensionInMeters, QRCodeIdentifierString) != true)
+//The scan density follows every symbol zbar decoded, so tags dropped by the filter, the per frame cap or the pose solver don't read as scan misses
+for(int i=0; i < 4; i++)
+{
+double sideX = zbar_symbol_get_loc_x(symbol, (i + 1) % 4) - zbar_symbol_get_loc_x(symbol, i);
+double sideY = zbar_symbol_get_loc_y(symbol, (i + 1) % 4) - zbar_symbol_get_loc_y(symbol, i);
+double sideLength = sqrt(sideX*sideX + sideY*sideY);
+smallestSymbolSideInPixels = (numberOfDecodedSymbols == 0 && i == 0) ? sideLength : std::min(smallestSymbolSideInPixels, sideLength);
+}
+numberOfDecodedSymbols++;
+
+const char *payloadText = zbar_symbol_get_data(symbol);
+QRCodePayload payload;
+if(!payloadCache.parse(payloadText, zbar_symbol_get_data_length(symbol), payload))
 {
 continue; //Couldn't read dimension
 }
 
-line(bufferFrame, cv::Point(symbol->get_location_x(0), symbol->get_location_y(0)), cv::Point(symbol->get_location_x(1), symbol->get_location_y(1)), cv::Scalar(0, 0, 0), 2, 8, 0); //Red 0->1
-line(bufferFrame, cv::Point(symbol->get_location_x(1), symbol->get_location_y(1)), cv::Point(symbol->get_location_x(2), symbol->get_location_y(2)), cv::Scalar(85, 85, 85), 2, 8, 0); //Green 1 -> 2
-line(bufferFrame, cv::Point(symbol->get_location_x(2), symbol->get_location_y(2)), cv::Point(symbol->get_location_x(3), symbol->get_location_y(3)), cv::Scalar(150, 150, 150), 2, 8, 0); //Blue 2 -> 3
-line(bufferFrame, cv::Point(symbol->get_location_x(3), symbol->get_location_y(3)), cv::Point(symbol->get_location_x(0), symbol->get_location_y(0)), cv::Scalar(255, 255, 255), 2, 8, 0); //Yellow  3 -> 0
+const char *identifier = payloadText + payload.identifierOffset;
+uint64_t identifierHash = hashQRCodeIdentifier(identifier, payload.identifierLength);
+int priority = 0;
+if(!identifierFilter.checkIdentifier(identifier, payload.identifierLength, identifierHash, priority))
+{
+continue; //Not a tag we care about
+}
+
+//Once full, a tag only gets in by replacing the lowest priority one (the earliest found wins ties)
+int detectionIndex = inputNumberOfDetectionsBuffer;
+if(inputNumberOfDetectionsBuffer >= maximumNumberOfDetections)
+{
+detectionIndex = 0;
+for(int i=1; i < inputNumberOfDetectionsBuffer; i++)
+{
+if(inputDetectionsBuffer[i].priority <= inputDetectionsBuffer[detectionIndex].priority)
+{
+detectionIndex = i;
+}
+}
+
+if(priority <= inputDetectionsBuffer[detectionIndex].priority)
+{
+continue;
+}
+}
+
+QRCodeDetection &detection = inputDetectionsBuffer[detectionIndex];
+
+//Convert zbar points to opencv points
+for(int i=0; i < 4; i++)
+{
+detection.corners[i] = cv::Point2d(zbar_symbol_get_loc_x(symbol, i), zbar_symbol_get_loc_y(symbol, i));
+}
+
+detection.QRCodeIdentifierLength = std::min(payload.identifierLength, QRCodeMaximumIdentifierLength);
+detection.QRCodeIdentifierWasTruncated = payload.identifierLength > QRCodeMaximumIdentifierLength;
+memcpy(detection.QRCodeIdentifier, identifier, detection.QRCodeIdentifierLength);
+detection.QRCodeIdentifier[detection.QRCodeIdentifierLength] = '\0';
+detection.QRCodeIdentifierHash = identifierHash;
+detection.priority = priority;
+detection.QRCodeDimension = payload.QRCodeDimension;
+detection.payloadVersion = payload.version;
+detection.hasWorldPoseHint = payload.hasWorldPoseHint;
+memcpy(detection.worldPoseHint, payload.worldPoseHint, sizeof(detection.worldPoseHint));
+
+if(detectionIndex == inputNumberOfDetectionsBuffer)
+{
+inputNumberOfDetectionsBuffer++;
+}
+} //End symbol for loop
+}
+catch(...)
+{
+inputNumberOfDetectionsBuffer = 0;
+return QRCODE_STATUS_SCANNER_ERROR;
+}
+
+//Put the highest priority tags first (stable, so equal priorities stay in the order zbar found them)
+for(int i=1; i < inputNumberOfDetectionsBuffer; i++)
+{
+for(int j=i; j > 0 && inputDetectionsBuffer[j].priority > inputDetectionsBuffer[j-1].priority; j--)
+{
+std::swap(inputDetectionsBuffer[j], inputDetectionsBuffer[j-1]);
+}
+}
+
+inputFrameTimestamps.scanFinishedTimestamp = getQRCodeTimestamp();
+
+//Solve the poses of all of the tags together (the payloads have already been copied, so zbar's symbols are no longer needed)
+numberOfPoseSolverFailures = solveDetectionPoses(inputDetectionsBuffer, inputNumberOfDetectionsBuffer);
+inputFrameTimestamps.poseSolveFinishedTimestamp = getQRCodeTimestamp();
+
+if(contrastEnhancer.mode != CONTRAST_ENHANCEMENT_NONE)
+{
+updateTrackedTagRegions(inputDetectionsBuffer, inputNumberOfDetectionsBuffer);
+}
+
+if(adaptiveScanDensityIsEnabled)
+{
+scanDensityController.update(numberOfDecodedSymbols, smallestSymbolSideInPixels);
+}
+
+if(showResultsInWindow)
+{
+try
+{
+for(int i=0; i < inputNumberOfDetectionsBuffer; i++)
+{
+QRCodeCornersBuffer.insert(QRCodeCornersBuffer.end(), inputDetectionsBuffer[i].corners, inputDetectionsBuffer[i].corners + 4);
+}
+
+//Draw on a copy, since the frame belongs to the caller (it may be recorded afterwards or be a read only mapping of a recording)
+inputGrayscaleFrame.copyTo(displayFrameBuffer);
+cv::Mat &bufferFrame = displayFrameBuffer;
+
+// Draw location of the symbols that were used (corners were saved while estimating, so payloads are not parsed again)
+for(int i=0; i + 3 < QRCodeCornersBuffer.size(); i += 4)
+{
+line(bufferFrame, QRCodeCornersBuffer[i], QRCodeCornersBuffer[i+1], cv::Scalar(0, 0, 0), 2, 8, 0); //Red 0->1
+line(bufferFrame, QRCodeCornersBuffer[i+1], QRCodeCornersBuffer[i+2], cv::Scalar(85, 85, 85), 2, 8, 0); //Green 1 -> 2
+line(bufferFrame, QRCodeCornersBuffer[i+2], QRCodeCornersBuffer[i+3], cv::Scalar(150, 150, 150), 2, 8, 0); //Blue 2 -> 3
+line(bufferFrame, QRCodeCornersBuffer[i+3], QRCodeCornersBuffer[i], cv::Scalar(255, 255, 255), 2, 8, 0); //Yellow  3 -> 0
 }
 
 imshow(QRCodeStateEstimatorWindowTitle, bufferFrame);
 cv::waitKey(30);
 }
+catch(...)
+{
+//Showing the results is best effort
+}
+}
 
+if(inputNumberOfDetectionsBuffer > 0)
+{
+return QRCODE_STATUS_OK;
+}
 
-//Make sure it updates every frame, even if it found the qr code in the last frame
-zbarScanner.recycle_image(zbarFrame);
-
-if(inputCameraPosesBuffer.size() > 0)
+if(numberOfPoseSolverFailures > 0)
 {
-return true;
+return QRCODE_STATUS_POSE_SOLVER_ERROR;
 }
 
- 
-//Didn't find/process any suitable QR codes, so return false
-return false;
+//Didn't find/process any suitable QR codes
+return QRCODE_STATUS_NO_QR_CODES;
 }
 
 
 
 
 /*
-This function takes a string in the format "dimensionIdentifier" (for example, "12.0in-FKDJL") and stores the dimension from the string in meters and the remainder.  In the example case, it would store 0.3048 and "FKDJL".  It supports the following extensions and is case insensitive: "m-", "cm-", "mm-", "ft-", "in-".
-@param inputQRCodeString: The original string
-@param inputDimensionBuffer: The buffer to store the extracted dimension (in meters) in
-@param inputIdentifierBuffer: The remainder of the string after the dimension has been extracted
-@return: true if it was possible to extract the dimension and false otherwise
+This function makes sure frameCameraMatrix holds the camera matrix for frames of the given size.  Frames may be any uniformly scaled version of the calibrated size (such as 640x360 for a 1280x720 calibration) or any integer binned/skipped version of it (such as 640x720 for 2x1 binning).  The focal lengths and principal point are scaled (treating pixel centers as the sample points), while the distortion parameters are left alone since they act on normalized coordinates.
+@param inputFrameWidth: The width of the frame that is about to be processed
+@param inputFrameHeight: The height of the frame that is about to be processed
+
+@exceptions: This function can throw exceptions
 */
-bool extractQRCodeDimensionFromString(const std::string &inputQRCodeString, double &inputDimensionBuffer, std::string &inputIdentifierBuffer)
+void QRCodeStateEstimator::updateCameraMatrixForFrameSize(int inputFrameWidth, int inputFrameHeight)
 {
-//Check the string for extensions and use the closest one
-std::string buffer = inputQRCodeString;
-
-//Convert local copy to lower case
-std::transform(buffer.begin(), buffer.end(), buffer.begin(), ::tolower);
-
-int minimumUnitIdentifierStartingIndex = buffer.size(); //The first index of the string that matches one of the unit IDs
-std::string minimumUnitIDType; //The unit ID that generated the minimum
+if(inputFrameWidth <= 0 || inputFrameHeight <= 0)
+{
+throw SOMException(std::string("Frame dimensions invalid\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
 
+if(!tryUpdateCameraMatrixForFrameSize(inputFrameWidth, inputFrameHeight))
+{
+throw SOMException(std::string("Frame size ") + std::to_string(inputFrameWidth) + "x" + std::to_string(inputFrameHeight) + " is not a scaled or binned version of the calibrated size " + std::to_string(expectedCameraImageWidth) + "x" + std::to_string(expectedCameraImageHeight) + "\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+}
 
-//Find which identifier (if any) to use
-for(auto iter = unitIdentifierToMetricMeterConversionFactor.begin(); iter != unitIdentifierToMetricMeterConversionFactor.end(); iter++)
+/*
+This function is the exception free version of updateCameraMatrixForFrameSize.
+@param inputFrameWidth: The width of the frame that is about to be processed
+@param inputFrameHeight: The height of the frame that is about to be processed
+@return: true if frameCameraMatrix is valid for the frame size and false if the size is not supported
+*/
+bool QRCodeStateEstimator::tryUpdateCameraMatrixForFrameSize(int inputFrameWidth, int inputFrameHeight) noexcept
 {
-//Find where the current unit identifier is in the string
-int currentIndex = buffer.find(iter->first);
-if(currentIndex == std::string::npos)
+if(inputFrameWidth == frameCameraMatrixWidth && inputFrameHeight == frameCameraMatrixHeight)
 {
-continue; //Unit identifier not found, so skip
+return true; //Already have the right matrix
 }
 
-//Update minimum if better
-if(currentIndex < minimumUnitIdentifierStartingIndex)
+if(inputFrameWidth <= 0 || inputFrameHeight <= 0)
+{
+return false;
+}
+
+double horizontalScale = ((double) inputFrameWidth) / expectedCameraImageWidth;
+double verticalScale = ((double) inputFrameHeight) / expectedCameraImageHeight;
+
+//A uniform resize has to be the rounded size for its scale in both directions (anything else, such as a sensor crop, would shift the principal point)
+bool isUniformlyScaled = lround(expectedCameraImageWidth * verticalScale) == inputFrameWidth && lround(expectedCameraImageHeight * horizontalScale) == inputFrameHeight;
+
+//Otherwise it has to be an integer binning/skipping mode in each direction
+bool isBinned = expectedCameraImageWidth % inputFrameWidth == 0 && expectedCameraImageHeight % inputFrameHeight == 0;
+
+if(!isUniformlyScaled && !isBinned)
 {
-minimumUnitIdentifierStartingIndex = currentIndex;
-minimumUnitIDType = iter->first;
+return false;
 }
 
+//Write the elements in place (frameCameraMatrix is already 3x3, so nothing is allocated), keeping the old ones in case the pose cores reject the new matrix
+cv::Matx33d previousFrameCameraMatrix;
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+previousFrameCameraMatrix(row, col) = frameCameraMatrix.at<double>(row, col);
+}
 }
 
-//Check if we found any of the unit identifiers
-if(minimumUnitIDType.size() == 0)
+for(int row = 0; row < 3; row++)
 {
-return false; //We did not
+for(int col = 0; col < 3; col++)
+{
+frameCameraMatrix.at<double>(row, col) = cameraMatrix.at<double>(row, col);
+}
 }
+frameCameraMatrix.at<double>(0, 0) = cameraMatrix.at<double>(0, 0) * horizontalScale; //fx
+frameCameraMatrix.at<double>(0, 1) = cameraMatrix.at<double>(0, 1) * horizontalScale; //skew
+frameCameraMatrix.at<double>(0, 2) = (cameraMatrix.at<double>(0, 2) + 0.5) * horizontalScale - 0.5; //cx
+frameCameraMatrix.at<double>(1, 1) = cameraMatrix.at<double>(1, 1) * verticalScale; //fy
+frameCameraMatrix.at<double>(1, 2) = (cameraMatrix.at<double>(1, 2) + 0.5) * verticalScale - 0.5; //cy
 
-//Grab all of the string up to the unit identifier and convert it to a double 
-std::string numberPortion = buffer.substr(0, minimumUnitIdentifierStartingIndex);
-double dimensionInOriginalUnits;
+try
+{
+singlePrecisionPoseCore.setCameraModel(frameCameraMatrix, distortionParameters);
+poseQualityCore.setCameraModel(frameCameraMatrix, distortionParameters);
+}
+catch(...)
+{
+//Put the matrix (and the cores) back so they still agree with frameCameraMatrixWidth/Height
+for(int row = 0; row < 3; row++)
+{
+for(int col = 0; col < 3; col++)
+{
+frameCameraMatrix.at<double>(row, col) = previousFrameCameraMatrix(row, col);
+}
+}
 
 try
 {
-dimensionInOriginalUnits = std::stod(numberPortion);
+singlePrecisionPoseCore.setCameraModel(frameCameraMatrix, distortionParameters);
+poseQualityCore.setCameraModel(frameCameraMatrix, distortionParameters);
+}
+catch(...)
+{
+//Force the next frame to recompute everything
+frameCameraMatrixWidth = 0;
+frameCameraMatrixHeight = 0;
+}
+return false;
+}
+
+frameCameraMatrixWidth = inputFrameWidth;
+frameCameraMatrixHeight = inputFrameHeight;
+return true;
 }
-catch(const std::exception &inputException)
+
+/*
+This function converts a QRCodeEstimationStatus into a string.  It does not allocate memory.
+@param inputStatus: The status to convert
+@return: A static string describing the status
+*/
+const char *QRCodeEstimationStatusToString(QRCodeEstimationStatus inputStatus)
+{
+switch(inputStatus)
 {
-return false; //Invalid numeric input
+case QRCODE_STATUS_OK:
+return "OK";
+case QRCODE_STATUS_NO_QR_CODES:
+return "No QR codes found";
+case QRCODE_STATUS_INVALID_FRAME:
+return "Given frame is empty, not 8 bit or not continuous";
+case QRCODE_STATUS_UNSUPPORTED_FRAME_SIZE:
+return "Frame size is not a scaled or binned version of the calibrated size";
+case QRCODE_STATUS_SCANNER_ERROR:
+return "QR code scanner returned with error";
+case QRCODE_STATUS_POSE_SOLVER_ERROR:
+return "Unable to solve for the pose of any QR code";
 }
 
-//Store the equivalent value in meters
-inputDimensionBuffer = dimensionInOriginalUnits * unitIdentifierToMetricMeterConversionFactor.at(minimumUnitIDType);
+return "Unknown status";
+}
 
-//Store the remainder of the string
-inputIdentifierBuffer = inputQRCodeString.substr(minimumUnitIdentifierStartingIndex + minimumUnitIDType.size(), std::string::npos); 
+/*
+This function checks whether the quality metrics of a detection are within the given thresholds.
+@param inputDetection: The detection to check
+@param inputThresholds: The thresholds to check it against
+@return: true if the pose is good and false if it is marginal
+*/
+bool meetsPoseQualityThresholds(const QRCodeDetection &inputDetection, const QRCodePoseQualityThresholds &inputThresholds)
+{
+//Written so that NaN metrics count as marginal
+return inputDetection.reprojectionRMS <= inputThresholds.maximumReprojectionRMS && inputDetection.quadArea >= inputThresholds.minimumQuadArea && inputDetection.incidenceAngle <= inputThresholds.maximumIncidenceAngle;
+}
 
-return true;
+/*
+This function takes a string in the format "dimensionIdentifier" (for example, "12.0in-FKDJL") and stores the dimension from the string in meters and the remainder.  In the example case, it would store 0.3048 and "FKDJL".  It supports the following extensions and is case insensitive: "m-", "cm-", "mm-", "ft-", "in-".  Key/value payloads (see parseQRCodePayload) are also accepted, in which case the remainder is the "id" value.
+@param inputQRCodeString: The original string
+@param inputDimensionBuffer: The buffer to store the extracted dimension (in meters) in
+@param inputIdentifierBuffer: The remainder of the string after the dimension has been extracted
+@return: true if it was possible to extract the dimension and false otherwise
+*/
+bool extractQRCodeDimensionFromString(const std::string &inputQRCodeString, double &inputDimensionBuffer, std::string &inputIdentifierBuffer)
+{
+QRCodePayload payload;
+if(!parseQRCodePayload(inputQRCodeString.data(), inputQRCodeString.size(), payload))
+{
+return false;
 }
 
+inputDimensionBuffer = payload.QRCodeDimension;
+inputIdentifierBuffer.assign(inputQRCodeString, payload.identifierOffset, payload.identifierLength);
+return true;
+}
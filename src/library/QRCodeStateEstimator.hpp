@@ -4,9 +4,21 @@
 #include<string>
 #include<algorithm>
 #include<map>
+#include<cmath>
+#include<cstdint>
+#include<vector>
+#include<memory>
 
 #include "SOMException.hpp"
 #include "SOMScopeGuard.hpp"
+#include "QRCodeCameraCalibration.hpp"
+#include "QRCodePayloadParser.hpp"
+#include "QRCodeBatchPoseSolver.hpp"
+#include "QRCodeScanDensityController.hpp"
+#include "QRCodeLatencyTrace.hpp"
+#include "QRCodeIdentifierFilter.hpp"
+#include "QRCodePoseCore.hpp"
+#include "QRCodeContrastEnhancer.hpp"
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -15,7 +27,76 @@
 
 //Declare handy constants
 static const std::string QRCodeStateEstimatorWindowTitle = "QR Code State Estimator";
-static const std::map<std::string, double> unitIdentifierToMetricMeterConversionFactor = {{"m-", 1.0}, {"cm-", .01}, {"mm-", .001}, {"ft-", .3048}, {"in-", .0254}};
+static const std::map<std::string, double> unitIdentifierToMetricMeterConversionFactor = {{"m-", 1.0}, {"cm-", .01}, {"mm-", .001}, {"ft-", .3048}, {"in-", .0254}}; //Deprecated: kept for existing code, parsing uses QRCodeUnitIdentifiers
+static constexpr size_t QRCodeMaximumIdentifierLength = 128; //Longer identifiers are truncated in QRCodeDetection (the hash still covers all of it)
+static constexpr int QRCodeMaximumDetectionsPerFrame = 64; //Size of the detection buffer used by the exception throwing functions
+static constexpr int QRCodeDefaultMinimumNumberOfTagsForBatchPoseSolve = 0; //Batch solving is opt in, since its unrefined closed form poses are less accurate than solvePnP
+static constexpr double QRCodeDefaultMaximumReprojectionRMS = 1.0; //Pixels
+static constexpr double QRCodeDefaultMinimumQuadArea = 1024.0; //Square pixels (a 32x32 pixel tag)
+static constexpr double QRCodeDefaultMaximumIncidenceAngle = 1.0471975511965976; //60 degrees in radians
+static constexpr int QRCodeDefaultContrastEnhancementFullFrameInterval = 10; //While tracking, the whole frame is still enhanced every this many frames so new tags can be found
+static constexpr double QRCodeTrackedRegionMargin = .5; //Fraction of a tracked tag's size its enhanced region extends past it on each side
+
+/*
+This enum describes the result of the exception free estimation functions.
+*/
+enum QRCodeEstimationStatus
+{
+QRCODE_STATUS_OK, //One or more poses were estimated
+QRCODE_STATUS_NO_QR_CODES, //No QR codes with a readable payload were found
+QRCODE_STATUS_INVALID_FRAME, //The frame was empty, the wrong type or not continuous in memory
+QRCODE_STATUS_UNSUPPORTED_FRAME_SIZE, //The frame is not a scaled or binned version of the calibrated size
+QRCODE_STATUS_SCANNER_ERROR, //zbar failed to scan the frame
+QRCODE_STATUS_POSE_SOLVER_ERROR //QR codes were found, but the pose could not be solved for any of them
+};
+
+/*
+This function converts a QRCodeEstimationStatus into a string.  It does not allocate memory.
+@param inputStatus: The status to convert
+@return: A static string describing the status
+*/
+const char *QRCodeEstimationStatusToString(QRCodeEstimationStatus inputStatus);
+
+/*
+This struct holds everything estimated for a single QR code.  It is fixed size, so a caller provided array of them can be filled without allocating memory.
+*/
+struct QRCodeDetection
+{
+cv::Matx44d cameraPose; //Pose of the camera (OpenCV format) in the coordinate system of the QR code
+double QRCodeDimension; //Length of one side of the QR code in meters
+char QRCodeIdentifier[QRCodeMaximumIdentifierLength + 1]; //Null terminated identifier
+size_t QRCodeIdentifierLength;
+bool QRCodeIdentifierWasTruncated; //True if the identifier was longer than QRCodeMaximumIdentifierLength
+uint64_t QRCodeIdentifierHash; //hashQRCodeIdentifier() of the full identifier
+int priority; //Priority given to the identifier by the estimator's identifier filter (0 if it has no rules)
+int payloadVersion;
+bool hasWorldPoseHint;
+double worldPoseHint[6]; //x, y, z (meters) and roll, pitch, yaw (radians) of the tag in the world
+cv::Point2d corners[4]; //Corners of the QR code in the frame
+double reprojectionRMS; //Root mean square distance in pixels between the corners and the corners projected from cameraPose
+double quadArea; //Area of the QR code in the frame in square pixels
+double incidenceAngle; //Angle in radians between the QR code's normal and the line from it to the camera (0 when seen head on)
+bool poseWasRefined; //False if the pose is an unrefined closed form pose (it met the estimator's poseQualityThresholds and was used as is, or it came from the batch solver)
+double ambiguityRatio; //Reprojection RMS of the rejected mirrored pose divided by that of cameraPose (close to 1 means either could be right, 0 if the check was not run)
+};
+
+/*
+This struct holds the limits a detection's pose quality has to be within to count as good.  Poses outside of them are marginal, which the estimator can use to decide which tags need the full pose solve.
+*/
+struct QRCodePoseQualityThresholds
+{
+double maximumReprojectionRMS; //Pixels
+double minimumQuadArea; //Square pixels
+double maximumIncidenceAngle; //Radians
+};
+
+/*
+This function checks whether the quality metrics of a detection are within the given thresholds.
+@param inputDetection: The detection to check
+@param inputThresholds: The thresholds to check it against
+@return: true if the pose is good and false if it is marginal
+*/
+bool meetsPoseQualityThresholds(const QRCodeDetection &inputDetection, const QRCodePoseQualityThresholds &inputThresholds);
 
 
 /*
@@ -36,67 +117,225 @@ This function initializes the state estimator with the OpenCV camera calibration
 */
 QRCodeStateEstimator(int inputCameraImageWidth, int inputCameraImageHeight, const cv::Mat_<double> &inputCameraCalibrationMatrix, const cv::Mat_<double> &inputCameraDistortionParameters, bool inputShowResultsInWindow = false);
 
+/*
+This function initializes the state estimator with a calibration loaded by loadCameraCalibration (or filled in by hand).
+@param inputCameraCalibration: The image size, camera matrix and distortion parameters of the camera
+@param inputShowResultsInWindow: True if you would like the QR results to be shown in a window
+
+@exception: This function can throw exceptions
+*/
+QRCodeStateEstimator(const QRCodeCameraCalibration &inputCameraCalibration, bool inputShowResultsInWindow = false);
+
+/*
+This function initializes the state estimator from an OpenCV XML/YAML camera calibration file, using (and creating) the binary calibration cache next to it so later starts skip the XML/YAML parsing.
+@param inputCalibrationFilePath: The OpenCV calibration file
+@param inputShowResultsInWindow: True if you would like the QR results to be shown in a window
+
+@exception: This function can throw exceptions
+*/
+QRCodeStateEstimator(const std::string &inputCalibrationFilePath, bool inputShowResultsInWindow = false);
+
 /*
 This function takes a BGR frame of the appropriate size, scans for a QR code with an embedded size (recognized decimal formats: ft, in, cm, mm, m), and stores the pose of the camera (OpenCV format) relative to the coordinate system of the QR tag in the provided buffer.  If multiple tags are recognized, it will only return the information for the first.
-@param inputBGRFrame: The frame to process (should be same size as calibration)
+@param inputBGRFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPoseBuffer: The buffer to place the 4x4 camera pose matrix in
 @param inputQRCodeIdentifierBuffer: A buffer to place left text from the QR code after the dimension information has been removed
 @param inputQRCodeDimensionBuffer: A buffer to place size of the QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool estimateStateFromBGRFrame(const cv::Mat &inputBGRFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer);
+bool estimateStateFromBGRFrame(const cv::Mat &inputBGRFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer, QRCodeFrameTimestamps *inputFrameTimestamps = nullptr);
 
 /*
 This function takes a grayscale frame of the appropriate size, scans for a QR code with an embedded size (recognized decimal formats: ft, in, cm, mm, m), and stores the pose of the camera (OpenCV format) relative to the coordinate system of the QR tag in the provided buffer.  If multiple tags are recognized, it will only return the information for the first.
-@param inputGrayscaleFrame: The frame to process (should be same size as calibration)
+@param inputGrayscaleFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPoseBuffer: The buffer to place the 4x4 camera pose matrix in
 @param inputQRCodeIdentifierBuffer: A buffer to place left text from the QR code after the dimension information has been removed
 @param inputQRCodeDimensionBuffer: A buffer to place size of the QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool estimateStateFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer);
+bool estimateStateFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, cv::Mat &inputCameraPoseBuffer, std::string &inputQRCodeIdentifierBuffer, double &inputQRCodeDimensionBuffer, QRCodeFrameTimestamps *inputFrameTimestamps = nullptr);
 
 /*
 This function takes a BGR frame of the appropriate size, scans for a QR codes with an embedded size (recognized decimal formats: ft, in, cm, mm, m), and stores the poses of the camera (OpenCV format) relative to the different coordinate systems of the QR tags in the provided buffer.
-@param inputBGRFrame: The frame to process (should be same size as calibration)
+@param inputBGRFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPosesBuffer: The buffer to place the 4x4 camera pose matrices in
 @param inputQRCodeIdentifiersBuffer: A buffer to place the text left from each QR code after the dimension information has been removed
 @param inputQRCodeDimensionsBuffer: A buffer to place size of each QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool estimateOneOrMoreStatesFromBGRFrame(const cv::Mat &inputBGRFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer);
+bool estimateOneOrMoreStatesFromBGRFrame(const cv::Mat &inputBGRFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps = nullptr);
 
 /*
 This function takes a grayscale frame of the appropriate size, scans for any QR codes with an embedded sizes (recognized decimal formats: ft, in, cm, mm, m), and stores the poses of the camera (OpenCV format) relative to the different coordinate systems of the QR tags in the provided buffers.
-@param inputGrayscaleFrame: The frame to process (should be same size as calibration)
+@param inputGrayscaleFrame: The frame to process (the calibration size or a scaled/binned version of it)
 @param inputCameraPosesBuffer: The buffer to place the 4x4 camera pose matrices in
 @param inputQRCodeIdentifiersBuffer: A buffer to place the text left from each QR code after the dimension information has been removed
 @param inputQRCodeDimensionsBuffer: A buffer to place size of each QR code in meters 
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
 @return: true if it was able to scan a QR code and estimate its pose relative to it and false otherwise
 
 @exceptions: This function can throw exceptions
 */
-bool estimateOneOrMoreStatesFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer);
+bool estimateOneOrMoreStatesFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps = nullptr);
+
+/*
+This function is the exception free version of estimateOneOrMoreStatesFromBGRFrame.  Once the internal grayscale buffer has been allocated for the frame size, the estimator's own buffers are not allocated again for bad frames or undecodable payloads (zbar may still allocate inside its scan).
+@param inputBGRFrame: The 8 bit BGR frame to process (the calibration size or a scaled/binned version of it)
+@param inputDetectionsBuffer: The array to store the detections in
+@param inputDetectionsBufferSize: How many detections the array can hold (the lowest priority tags beyond that are dropped)
+@param inputNumberOfDetectionsBuffer: The buffer to store the number of detections written in
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
+@return: QRCODE_STATUS_OK if one or more poses were estimated, otherwise the reason why not
+*/
+QRCodeEstimationStatus tryEstimateStatesFromBGRFrame(const cv::Mat &inputBGRFrame, QRCodeDetection *inputDetectionsBuffer, int inputDetectionsBufferSize, int &inputNumberOfDetectionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps = nullptr) noexcept;
+
+/*
+This function is the exception free version of estimateOneOrMoreStatesFromGrayscaleFrame.  The estimator allocates nothing of its own for bad frames or undecodable payloads (the zbar image is reused from frame to frame), which keeps the cost of garbage frames bounded for real time threads.  zbar may still allocate inside its scan, and solvePnP while working on a valid tag.  A tag whose pose can't be solved is skipped rather than failing the frame.
+@param inputGrayscaleFrame: The continuous 8 bit grayscale frame to process (the calibration size or a scaled/binned version of it)
+@param inputDetectionsBuffer: The array to store the detections in
+@param inputDetectionsBufferSize: How many detections the array can hold (the lowest priority tags beyond that are dropped)
+@param inputNumberOfDetectionsBuffer: The buffer to store the number of detections written in
+@param inputFrameTimestamps: Optional timestamps of the frame, with captureTimestamp filled in by the caller and the stage timestamps filled in by this function
+@return: QRCODE_STATUS_OK if one or more poses were estimated, otherwise the reason why not
+*/
+QRCodeEstimationStatus tryEstimateStatesFromGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, QRCodeDetection *inputDetectionsBuffer, int inputDetectionsBufferSize, int &inputNumberOfDetectionsBuffer, QRCodeFrameTimestamps *inputFrameTimestamps = nullptr) noexcept;
+
+
+
+/*
+This function makes sure frameCameraMatrix holds the camera matrix for frames of the given size.  Frames may be any uniformly scaled version of the calibrated size (such as 640x360 for a 1280x720 calibration) or any integer binned/skipped version of it (such as 640x720 for 2x1 binning).  The focal lengths and principal point are scaled (treating pixel centers as the sample points), while the distortion parameters are left alone since they act on normalized coordinates.
+@param inputFrameWidth: The width of the frame that is about to be processed
+@param inputFrameHeight: The height of the frame that is about to be processed
+
+@exceptions: This function can throw exceptions
+*/
+void updateCameraMatrixForFrameSize(int inputFrameWidth, int inputFrameHeight);
+
+/*
+This function is the exception free version of updateCameraMatrixForFrameSize.
+@param inputFrameWidth: The width of the frame that is about to be processed
+@param inputFrameHeight: The height of the frame that is about to be processed
+@return: true if frameCameraMatrix is valid for the frame size and false if the size is not supported
+*/
+bool tryUpdateCameraMatrixForFrameSize(int inputFrameWidth, int inputFrameHeight) noexcept;
+
+/*
+This function solves the camera pose for each of the given detections, using the batch solver if there are at least minimumNumberOfTagsForBatchPoseSolve of them and solvePnP (or singlePrecisionPoseCore if it is enabled) otherwise.  If poseQualityGatingIsEnabled, tags which aren't batch solved first try the closed form pose and only get the full solve and the mirrored pose check if it falls outside poseQualityThresholds.  Every solved detection is graded.  Detections whose pose can't be solved are removed (the rest keep their order).
+@param inputDetections: The detections with their corners and dimensions filled in
+@param inputNumberOfDetections: The number of detections, which is reduced by the number that were removed
+@return: The number of detections that were removed
+*/
+int solveDetectionPoses(QRCodeDetection *inputDetections, int &inputNumberOfDetections) noexcept;
+
+/*
+This function fills in the reprojection RMS, quad area and incidence angle of a detection from its corners and camera pose.
+@param inputDetection: The detection to grade
+*/
+void gradeDetectionPose(QRCodeDetection &inputDetection) const noexcept;
+
+/*
+This function runs contrastEnhancer on a frame, over the whole frame or only around the tags found in the last frame if they are being tracked.
+@param inputGrayscaleFrame: The continuous 8 bit grayscale frame to enhance
+@return: The frame to scan, which is enhancedFrameBuffer or (if the enhancement failed) the given frame
+*/
+const cv::Mat &enhanceFrameContrast(const cv::Mat &inputGrayscaleFrame) noexcept;
+
+/*
+This function remembers the areas around the given detections, so that the next frame's contrast enhancement can be limited to them.
+@param inputDetections: The detections of the frame
+@param inputNumberOfDetections: The number of detections
+*/
+void updateTrackedTagRegions(const QRCodeDetection *inputDetections, int inputNumberOfDetections) noexcept;
+
+/*
+This function scans a continuous 8 bit grayscale frame and solves the poses of the tags in it (the work shared by all of the estimation functions).  It stamps the end of the scan and of the pose solve.
+@param inputGrayscaleFrame: The frame to process
+@param inputDetectionsBuffer: The array to store the detections in
+@param inputDetectionsBufferSize: How many detections the array can hold (the lowest priority tags beyond that are dropped)
+@param inputNumberOfDetectionsBuffer: The buffer to store the number of detections written in
+@param inputFrameTimestamps: The timestamps of the frame
+@return: QRCODE_STATUS_OK if one or more poses were estimated, otherwise the reason why not
+*/
+QRCodeEstimationStatus estimateStatesFromContinuousGrayscaleFrame(const cv::Mat &inputGrayscaleFrame, QRCodeDetection *inputDetectionsBuffer, int inputDetectionsBufferSize, int &inputNumberOfDetectionsBuffer, QRCodeFrameTimestamps &inputFrameTimestamps) noexcept;
 
+/*
+This function starts the timestamps of a frame.
+@param inputFrameTimestamps: The timestamps given by the caller (NULL if none were given)
+@param inputFrameTimestampsBuffer: The buffer to start the timestamps in
+*/
+void beginFrameTimestamps(const QRCodeFrameTimestamps *inputFrameTimestamps, QRCodeFrameTimestamps &inputFrameTimestampsBuffer) noexcept;
 
+/*
+This function finishes the timestamps of a frame, records them in the latency tracer (if there is one) and hands them back to the caller.
+@param inputStatus: The result of the frame
+@param inputNumberOfDetections: The number of detections in the frame
+@param inputFrameTimestamps: The timestamps of the frame
+@param inputFrameTimestampsBuffer: The caller's timestamps (NULL if none were given)
+*/
+void finishFrameTimestamps(QRCodeEstimationStatus inputStatus, int inputNumberOfDetections, QRCodeFrameTimestamps &inputFrameTimestamps, QRCodeFrameTimestamps *inputFrameTimestampsBuffer) noexcept;
+
+/*
+This function converts the results in detectionsBuffer into the vectors used by the exception throwing functions.
+@param inputStatus: The status returned by the exception free function
+@param inputNumberOfDetections: The number of detections in detectionsBuffer
+@param inputCameraPosesBuffer: The buffer to place the 4x4 camera pose matrices in
+@param inputQRCodeIdentifiersBuffer: A buffer to place the text left from each QR code after the dimension information has been removed
+@param inputQRCodeDimensionsBuffer: A buffer to place size of each QR code in meters 
+@return: true if there were any poses and false otherwise
+
+@exceptions: This function can throw exceptions
+*/
+bool copyDetectionsToBuffers(QRCodeEstimationStatus inputStatus, int inputNumberOfDetections, std::vector<cv::Mat> &inputCameraPosesBuffer, std::vector<std::string> &inputQRCodeIdentifiersBuffer, std::vector<double> &inputQRCodeDimensionsBuffer);
 
 int expectedCameraImageWidth;
 int expectedCameraImageHeight;
 cv::Mat_<double> cameraMatrix;  //3x3 matrix
+cv::Mat_<double> frameCameraMatrix; //3x3 matrix scaled to the size of the frames currently being processed
+int frameCameraMatrixWidth; //The frame width frameCameraMatrix was computed for
+int frameCameraMatrixHeight; //The frame height frameCameraMatrix was computed for
 cv::Mat_<double> distortionParameters; //1x5 matrix
 bool showResultsInWindow; //True if the image should be shown in a window
 zbar::ImageScanner zbarScanner;
+zbar::Image zbarFrame; //Pointed at each frame while it is scanned, and recycled afterwards so zbar can reuse its symbols
 cv::Mat frameBuffer;
+cv::Mat continuousFrameBuffer; //Copy of frames which were not continuous in memory
+cv::Mat displayFrameBuffer; //Copy of the frame the results are drawn on when showResultsInWindow is set
+std::vector<QRCodeDetection> detectionsBuffer; //Used by the exception throwing functions
+QRCodePayloadCache payloadCache; //Parsed payloads of recently seen tags
+QRCodeIdentifierFilter identifierFilter; //Which tags get their poses solved (everything unless rules are added)
+std::vector<cv::Point2d> QRCodeCornersBuffer; //Corners (4 per tag) of the tags used in the last frame
+QRCodeBatchPoseSolver batchPoseSolver; //Give it a worker pool to spread very large batches across threads
+int minimumNumberOfTagsForBatchPoseSolve; //Frames with at least this many tags are solved with batchPoseSolver (0 disables it)
+QRCodePoseCore<float> singlePrecisionPoseCore; //Kept in step with frameCameraMatrix
+bool singlePrecisionPoseSolveIsEnabled; //True if tags that aren't batch solved should use singlePrecisionPoseCore instead of solvePnP
+QRCodePoseCore<double> poseQualityCore; //Kept in step with frameCameraMatrix and set to take no refinement steps, it grades poses and gives the closed form pose of the fast path
+bool poseQualityGatingIsEnabled; //True if tags that aren't batch solved should use the closed form pose when it meets poseQualityThresholds, and get the full solve plus the mirrored pose check otherwise
+QRCodePoseQualityThresholds poseQualityThresholds;
+QRCodeContrastEnhancer contrastEnhancer; //Preprocesses frames before zbar scans them unless its mode is CONTRAST_ENHANCEMENT_NONE
+bool contrastEnhancementTracksTags; //True if only the areas around the tags found in the last frame are enhanced while there are any
+int contrastEnhancementFullFrameInterval; //While tracking, every this many frames are still enhanced in full
+int framesSinceFullFrameContrastEnhancement;
+std::vector<cv::Rect> trackedTagRegions; //Areas around the tags found in the last frame (capacity for QRCodeMaximumDetectionsPerFrame, so updating it doesn't allocate)
+cv::Mat enhancedFrameBuffer;
+bool adaptiveScanDensityIsEnabled; //True if scanDensityController should pick zbar's scan density from frame to frame
+QRCodeScanDensityController scanDensityController;
+int appliedScanDensity; //The density zbarScanner is currently configured with
+std::shared_ptr<QRCodeLatencyTracer> latencyTracer; //If set, the timestamps of every frame are recorded in it
+int latencyTraceTrackIndex; //Which track of the trace this estimator's frames are shown on
+uint64_t numberOfFramesProcessed;
 };
 
 /*
-This function takes a string in the format "dimensionIdentifier" (for example, "12.0in-FKDJL") and stores the dimension from the string in meters and the remainder.  In the example case, it would store 0.3048 and "FKDJL".  It supports the following extensions and is case insensitive: "m-", "cm-", "mm-", "ft-", "in-".
+This function takes a string in the format "dimensionIdentifier" (for example, "12.0in-FKDJL") and stores the dimension from the string in meters and the remainder.  In the example case, it would store 0.3048 and "FKDJL".  It supports the following extensions and is case insensitive: "m-", "cm-", "mm-", "ft-", "in-".  Key/value payloads (see parseQRCodePayload) are also accepted, in which case the remainder is the "id" value.
 @param inputQRCodeString: The original string
 @param inputDimensionBuffer: The buffer to store the extracted dimension (in meters) in
 @param inputIdentifierBuffer: The remainder of the string after the dimension has been extracted
@@ -0,0 +1,186 @@
+#include "SOMThreadConfiguration.hpp"
+
+#include<pthread.h>
+#include<sched.h>
+#include<unistd.h>
+#include<dirent.h>
+#include<sys/syscall.h>
+#include<cerrno>
+#include<cstring>
+#include<cstdlib>
+#include<climits>
+
+#include "SOMScopeGuard.hpp"
+
+//Declare handy constants
+static constexpr int SOMMemoryPolicyBind = 2; //MPOL_BIND from the kernel's mempolicy.h (so libnuma isn't needed)
+static constexpr int SOMMaximumNUMANode = 1023;
+
+/*
+This function applies a configuration to the calling thread.  Memory binding only affects pages the thread touches afterwards, so objects which should live on the local node (such as a QRCodeStateEstimator and its zbar scanner) should be created by the thread after this has been called.  Real time priorities need CAP_SYS_NICE or a suitable RLIMIT_RTPRIO.
+@param inputConfiguration: The configuration to apply
+
+@exceptions: This function can throw exceptions
+*/
+void applyThreadConfiguration(const SOMThreadConfiguration &inputConfiguration)
+{
+if(inputConfiguration.CPUCores.size() > 0)
+{
+cpu_set_t CPUSet;
+CPU_ZERO(&CPUSet);
+for(int CPUCore : inputConfiguration.CPUCores)
+{
+if(CPUCore < 0 || CPUCore >= CPU_SETSIZE)
+{
+throw SOMException(std::string("CPU core ") + std::to_string(CPUCore) + " is out of range\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+CPU_SET(CPUCore, &CPUSet);
+}
+
+int result = pthread_setaffinity_np(pthread_self(), sizeof(CPUSet), &CPUSet);
+if(result != 0)
+{
+throw SOMException(std::string("Unable to set thread affinity: ") + strerror(result) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+if(inputConfiguration.realTimePriority != 0)
+{
+if(inputConfiguration.realTimePriority < sched_get_priority_min(SCHED_FIFO) || inputConfiguration.realTimePriority > sched_get_priority_max(SCHED_FIFO))
+{
+throw SOMException(std::string("Real time priority ") + std::to_string(inputConfiguration.realTimePriority) + " is out of range\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+sched_param schedulingParameters;
+memset(&schedulingParameters, 0, sizeof(schedulingParameters));
+schedulingParameters.sched_priority = inputConfiguration.realTimePriority;
+int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedulingParameters);
+if(result != 0)
+{
+throw SOMException(std::string("Unable to set SCHED_FIFO priority (needs CAP_SYS_NICE or an rtprio limit): ") + strerror(result) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+
+if(inputConfiguration.bindMemoryToLocalNUMANode)
+{
+//Use the nodes of the cores the thread is allowed on, or of the core it is on right now
+std::vector<int> CPUCores = inputConfiguration.CPUCores;
+if(CPUCores.size() == 0)
+{
+int currentCPUCore = sched_getcpu();
+if(currentCPUCore < 0)
+{
+throw SOMException(std::string("Unable to get current CPU core: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+CPUCores.push_back(currentCPUCore);
+}
+
+unsigned long nodeMask[(SOMMaximumNUMANode + 1) / (sizeof(unsigned long) * CHAR_BIT)];
+memset(nodeMask, 0, sizeof(nodeMask));
+bool foundNode = false;
+for(int CPUCore : CPUCores)
+{
+int node = getNUMANodeOfCPUCore(CPUCore);
+if(node < 0 || node >= SOMMaximumNUMANode)
+{
+continue;
+}
+nodeMask[node / (sizeof(unsigned long) * CHAR_BIT)] |= 1UL << (node % (sizeof(unsigned long) * CHAR_BIT));
+foundNode = true;
+}
+
+if(!foundNode)
+{
+return; //Not a NUMA system, so all memory is local
+}
+
+if(syscall(SYS_set_mempolicy, SOMMemoryPolicyBind, nodeMask, sizeof(nodeMask) * CHAR_BIT) != 0)
+{
+throw SOMException(std::string("Unable to bind memory to NUMA node: ") + strerror(errno) + "\n", SYSTEM_ERROR, __FILE__, __LINE__);
+}
+}
+}
+
+/*
+This function returns the NUMA node a CPU core belongs to.
+@param inputCPUCore: The core to look up
+@return: The node number, or -1 if the system does not report one (such as a kernel without NUMA support)
+*/
+int getNUMANodeOfCPUCore(int inputCPUCore)
+{
+//The core's sysfs directory has a nodeN link for the node it is on
+std::string CPUDirectoryPath = "/sys/devices/system/cpu/cpu" + std::to_string(inputCPUCore);
+DIR *CPUDirectory = opendir(CPUDirectoryPath.c_str());
+if(CPUDirectory == NULL)
+{
+return -1;
+}
+SOMScopeGuard CPUDirectoryGuard([&](){closedir(CPUDirectory);});
+
+for(dirent *entry = readdir(CPUDirectory); entry != NULL; entry = readdir(CPUDirectory))
+{
+if(strncmp(entry->d_name, "node", 4) != 0)
+{
+continue;
+}
+
+char *numberEnd = NULL;
+long node = strtol(entry->d_name + 4, &numberEnd, 10);
+if(numberEnd != entry->d_name + 4 && *numberEnd == '\0' && node >= 0)
+{
+return (int) node;
+}
+}
+
+return -1;
+}
+
+/*
+This function parses a list of CPU cores such as "2,3,8-11".
+@param inputCoreList: The text to parse
+@return: The cores in the list
+
+@exceptions: This function can throw exceptions
+*/
+std::vector<int> parseCPUCoreList(const std::string &inputCoreList)
+{
+std::vector<int> CPUCores;
+const char *position = inputCoreList.c_str();
+while(*position != '\0')
+{
+char *numberEnd = NULL;
+long firstCore = strtol(position, &numberEnd, 10);
+if(numberEnd == position || firstCore < 0 || firstCore >= CPU_SETSIZE)
+{
+throw SOMException(std::string("Invalid CPU core list: ") + inputCoreList + "\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+position = numberEnd;
+
+long lastCore = firstCore;
+if(*position == '-')
+{
+lastCore = strtol(position + 1, &numberEnd, 10);
+if(numberEnd == position + 1 || lastCore < firstCore || lastCore >= CPU_SETSIZE)
+{
+throw SOMException(std::string("Invalid CPU core list: ") + inputCoreList + "\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+position = numberEnd;
+}
+
+for(long CPUCore = firstCore; CPUCore <= lastCore; CPUCore++)
+{
+CPUCores.push_back((int) CPUCore);
+}
+
+if(*position == ',')
+{
+position++;
+}
+else if(*position != '\0')
+{
+throw SOMException(std::string("Invalid CPU core list: ") + inputCoreList + "\n", INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+}
+
+return CPUCores;
+}
@@ -0,0 +1,43 @@
+#ifndef SOMTHREADCONFIGURATIONHPP
+#define SOMTHREADCONFIGURATIONHPP
+
+#include<vector>
+#include<string>
+
+#include "SOMException.hpp"
+
+/*
+This struct describes where a thread should run and how it should be scheduled.  The default values leave the thread as it is.
+*/
+struct SOMThreadConfiguration
+{
+std::vector<int> CPUCores; //The cores the thread may run on (empty leaves the affinity alone)
+int realTimePriority = 0; //SCHED_FIFO priority (1 to 99), or 0 to keep the normal scheduler
+bool bindMemoryToLocalNUMANode = false; //True if memory the thread allocates afterwards should only come from the NUMA node(s) of its cores
+};
+
+/*
+This function applies a configuration to the calling thread.  Memory binding only affects pages the thread touches afterwards, so objects which should live on the local node (such as a QRCodeStateEstimator and its zbar scanner) should be created by the thread after this has been called.  Real time priorities need CAP_SYS_NICE or a suitable RLIMIT_RTPRIO.
+@param inputConfiguration: The configuration to apply
+
+@exceptions: This function can throw exceptions
+*/
+void applyThreadConfiguration(const SOMThreadConfiguration &inputConfiguration);
+
+/*
+This function returns the NUMA node a CPU core belongs to.
+@param inputCPUCore: The core to look up
+@return: The node number, or -1 if the system does not report one (such as a kernel without NUMA support)
+*/
+int getNUMANodeOfCPUCore(int inputCPUCore);
+
+/*
+This function parses a list of CPU cores such as "2,3,8-11".
+@param inputCoreList: The text to parse
+@return: The cores in the list
+
+@exceptions: This function can throw exceptions
+*/
+std::vector<int> parseCPUCoreList(const std::string &inputCoreList);
+
+#endif
@@ -0,0 +1,275 @@
+#include "SOMWorkerPool.hpp"
+
+/*
+This function starts the worker threads.
+@param inputNumberOfWorkers: How many threads to start (0 means one per hardware thread)
+
+@exceptions: This function can throw exceptions
+*/
+SOMWorkerPool::SOMWorkerPool(int inputNumberOfWorkers)
+{
+if(inputNumberOfWorkers < 0)
+{
+throw SOMException(std::string("Number of workers cannot be negative\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+if(inputNumberOfWorkers == 0)
+{
+inputNumberOfWorkers = std::max((int) std::thread::hardware_concurrency(), 1);
+}
+
+SOM_TRY
+startWorkers(std::vector<SOMThreadConfiguration>(inputNumberOfWorkers));
+SOM_CATCH("Error starting workers\n")
+}
+
+/*
+This function starts one worker thread per configuration, each of which applies its configuration to itself before taking any jobs.
+@param inputWorkerConfigurations: The configuration of each worker
+
+@exceptions: This function can throw exceptions
+*/
+SOMWorkerPool::SOMWorkerPool(const std::vector<SOMThreadConfiguration> &inputWorkerConfigurations)
+{
+if(inputWorkerConfigurations.size() == 0)
+{
+throw SOMException(std::string("Worker pool needs at least one worker\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+SOM_TRY
+startWorkers(inputWorkerConfigurations);
+SOM_CATCH("Error starting configured workers\n")
+}
+
+/*
+This function adds a job to the queue.  It will be run by the first worker that becomes free.
+@param inputJob: The function to run
+
+@exceptions: This function can throw exceptions
+*/
+void SOMWorkerPool::submit(std::function<void()> inputJob)
+{
+{
+std::lock_guard<std::mutex> lock(queueMutex);
+jobQueue.push_back(std::move(inputJob));
+numberOfUnfinishedJobs++;
+}
+
+jobAvailableCondition.notify_one();
+}
+
+/*
+This function adds a job to the queue of one worker.  That worker runs it ahead of any jobs in the shared queue.
+@param inputWorkerIndex: The worker to run the job on (0 to getNumberOfWorkers() - 1)
+@param inputJob: The function to run
+
+@exceptions: This function can throw exceptions
+*/
+void SOMWorkerPool::submitToWorker(int inputWorkerIndex, std::function<void()> inputJob)
+{
+if(inputWorkerIndex < 0 || inputWorkerIndex >= workerJobQueues.size())
+{
+throw SOMException(std::string("Worker index out of range\n"), INVALID_FUNCTION_INPUT, __FILE__, __LINE__);
+}
+
+{
+std::lock_guard<std::mutex> lock(queueMutex);
+workerJobQueues[inputWorkerIndex].push_back(std::move(inputJob));
+numberOfUnfinishedJobs++;
+}
+
+//The workers share one condition, so wake all of them to make sure the right one sees it
+jobAvailableCondition.notify_all();
+}
+
+/*
+This function blocks until every job that has been submitted so far has finished.  If any of them threw an exception, the first exception is rethrown (and cleared).
+
+@exceptions: This function can throw exceptions
+*/
+void SOMWorkerPool::wait()
+{
+std::exception_ptr exceptionToRethrow;
+
+{
+std::unique_lock<std::mutex> lock(queueMutex);
+allJobsFinishedCondition.wait(lock, [&](){return numberOfUnfinishedJobs == 0;});
+exceptionToRethrow = firstJobException;
+firstJobException = nullptr;
+}
+
+if(exceptionToRethrow)
+{
+SOM_TRY
+std::rethrow_exception(exceptionToRethrow);
+SOM_CATCH("Worker pool job failed\n")
+}
+}
+
+/*
+This function returns the number of worker threads owned by the pool.
+@return: The number of worker threads
+*/
+int SOMWorkerPool::getNumberOfWorkers() const
+{
+return workers.size();
+}
+
+/*
+This destructor lets the workers finish the jobs that are already queued and then joins them.
+*/
+SOMWorkerPool::~SOMWorkerPool()
+{
+stopWorkers();
+}
+
+/*
+This function starts the workers and waits for all of them to apply their configurations.
+@param inputWorkerConfigurations: The configuration of each worker
+
+@exceptions: This function can throw exceptions
+*/
+void SOMWorkerPool::startWorkers(const std::vector<SOMThreadConfiguration> &inputWorkerConfigurations)
+{
+numberOfUnfinishedJobs = 0;
+poolIsShuttingDown = false;
+numberOfStartingWorkers = inputWorkerConfigurations.size();
+workerStartExceptions.resize(inputWorkerConfigurations.size());
+workerJobQueues.resize(inputWorkerConfigurations.size());
+
+for(int i=0; i < inputWorkerConfigurations.size(); i++)
+{
+try
+{
+workers.push_back(std::thread([this, i, &inputWorkerConfigurations](){workerLoop(i, inputWorkerConfigurations[i]);}));
+}
+catch(...)
+{
+//Don't leave the threads that did start running
+{
+std::lock_guard<std::mutex> lock(queueMutex);
+numberOfStartingWorkers -= inputWorkerConfigurations.size() - i;
+}
+stopWorkers();
+throw;
+}
+}
+
+//The configurations are passed by reference, so wait for them to be applied before returning
+std::exception_ptr firstStartException;
+{
+std::unique_lock<std::mutex> lock(queueMutex);
+workersStartedCondition.wait(lock, [&](){return numberOfStartingWorkers == 0;});
+for(int i=0; i < workerStartExceptions.size() && !firstStartException; i++)
+{
+firstStartException = workerStartExceptions[i];
+}
+}
+
+if(firstStartException)
+{
+stopWorkers();
+SOM_TRY
+std::rethrow_exception(firstStartException);
+SOM_CATCH("Error configuring worker thread\n")
+}
+}
+
+/*
+This function tells the workers to finish the queued jobs and joins them.
+*/
+void SOMWorkerPool::stopWorkers()
+{
+{
+std::lock_guard<std::mutex> lock(queueMutex);
+poolIsShuttingDown = true;
+}
+
+jobAvailableCondition.notify_all();
+
+for(int i=0; i < workers.size(); i++)
+{
+if(workers[i].joinable())
+{
+workers[i].join();
+}
+}
+}
+
+/*
+This function is run by each of the worker threads.
+@param inputWorkerIndex: The index of the worker
+@param inputConfiguration: The configuration the worker applies to itself
+*/
+void SOMWorkerPool::workerLoop(int inputWorkerIndex, SOMThreadConfiguration inputConfiguration)
+{
+std::exception_ptr startException;
+try
+{
+applyThreadConfiguration(inputConfiguration);
+}
+catch(...)
+{
+startException = std::current_exception();
+}
+
+{
+std::lock_guard<std::mutex> lock(queueMutex);
+workerStartExceptions[inputWorkerIndex] = startException;
+numberOfStartingWorkers--;
+if(numberOfStartingWorkers == 0)
+{
+workersStartedCondition.notify_all();
+}
+}
+
+if(startException)
+{
+return; //The constructor will stop the pool
+}
+
+std::deque<std::function<void()> > &workerJobQueue = workerJobQueues[inputWorkerIndex];
+while(true)
+{
+std::function<void()> job;
+
+{
+std::unique_lock<std::mutex> lock(queueMutex);
+jobAvailableCondition.wait(lock, [&](){return poolIsShuttingDown || jobQueue.size() > 0 || workerJobQueue.size() > 0;});
+
+//This worker's own jobs go first
+std::deque<std::function<void()> > &queueToTakeFrom = workerJobQueue.size() > 0 ? workerJobQueue : jobQueue;
+if(queueToTakeFrom.size() == 0)
+{
+return; //Shutting down and nothing left to do
+}
+
+job = std::move(queueToTakeFrom.front());
+queueToTakeFrom.pop_front();
+}
+
+std::exception_ptr jobException;
+try
+{
+job();
+}
+catch(...)
+{
+jobException = std::current_exception();
+}
+
+{
+std::lock_guard<std::mutex> lock(queueMutex);
+if(jobException && !firstJobException)
+{
+firstJobException = jobException;
+}
+
+numberOfUnfinishedJobs--;
+if(numberOfUnfinishedJobs == 0)
+{
+allJobsFinishedCondition.notify_all();
+}
+}
+}
+}
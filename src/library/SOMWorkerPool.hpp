@@ -0,0 +1,114 @@
+#ifndef SOMWORKERPOOLHPP
+#define SOMWORKERPOOLHPP
+
+#include<functional>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<deque>
+#include<vector>
+#include<exception>
+#include<algorithm>
+
+#include "SOMException.hpp"
+#include "SOMThreadConfiguration.hpp"
+
+/*
+This class owns a fixed set of worker threads which pull jobs from a shared first in first out queue.  It is intended to be created once and shared between everything in a process that wants to do work in parallel, so that the total number of busy threads never exceeds the number of cores that were asked for.
+
+Workers can be given a SOMThreadConfiguration each (pinning them to cores, making them SCHED_FIFO and binding their memory to the local NUMA node), and jobs can be sent to a particular worker so that state which belongs to that worker (such as a pinned camera's estimator) stays in its caches and on its node.
+
+Jobs should catch their own exceptions if the submitter needs to know which job failed.  Any exception that escapes a job is stored and the first one is rethrown from wait().
+*/
+class SOMWorkerPool
+{
+public:
+/*
+This function starts the worker threads.
+@param inputNumberOfWorkers: How many threads to start (0 means one per hardware thread)
+
+@exceptions: This function can throw exceptions
+*/
+SOMWorkerPool(int inputNumberOfWorkers = 0);
+
+/*
+This function starts one worker thread per configuration, each of which applies its configuration to itself before taking any jobs.
+@param inputWorkerConfigurations: The configuration of each worker
+
+@exceptions: This function can throw exceptions
+*/
+SOMWorkerPool(const std::vector<SOMThreadConfiguration> &inputWorkerConfigurations);
+
+/*
+This function adds a job to the queue.  It will be run by the first worker that becomes free.
+@param inputJob: The function to run
+
+@exceptions: This function can throw exceptions
+*/
+void submit(std::function<void()> inputJob);
+
+/*
+This function adds a job to the queue of one worker.  That worker runs it ahead of any jobs in the shared queue.
+@param inputWorkerIndex: The worker to run the job on (0 to getNumberOfWorkers() - 1)
+@param inputJob: The function to run
+
+@exceptions: This function can throw exceptions
+*/
+void submitToWorker(int inputWorkerIndex, std::function<void()> inputJob);
+
+/*
+This function blocks until every job that has been submitted so far has finished.  If any of them threw an exception, the first exception is rethrown (and cleared).
+
+@exceptions: This function can throw exceptions
+*/
+void wait();
+
+/*
+This function returns the number of worker threads owned by the pool.
+@return: The number of worker threads
+*/
+int getNumberOfWorkers() const;
+
+/*
+This destructor lets the workers finish the jobs that are already queued and then joins them.
+*/
+~SOMWorkerPool();
+
+private:
+SOMWorkerPool(const SOMWorkerPool &inputSOMWorkerPool) = delete; //Disable copying of the object
+
+/*
+This function starts the workers and waits for all of them to apply their configurations.
+@param inputWorkerConfigurations: The configuration of each worker
+
+@exceptions: This function can throw exceptions
+*/
+void startWorkers(const std::vector<SOMThreadConfiguration> &inputWorkerConfigurations);
+
+/*
+This function tells the workers to finish the queued jobs and joins them.
+*/
+void stopWorkers();
+
+/*
+This function is run by each of the worker threads.
+@param inputWorkerIndex: The index of the worker
+@param inputConfiguration: The configuration the worker applies to itself
+*/
+void workerLoop(int inputWorkerIndex, SOMThreadConfiguration inputConfiguration);
+
+std::vector<std::thread> workers;
+std::deque<std::function<void()> > jobQueue;
+std::vector<std::deque<std::function<void()> > > workerJobQueues; //Jobs for one worker only
+int numberOfStartingWorkers; //Workers which haven't applied their configuration yet
+std::vector<std::exception_ptr> workerStartExceptions;
+std::condition_variable workersStartedCondition;
+std::mutex queueMutex;
+std::condition_variable jobAvailableCondition;
+std::condition_variable allJobsFinishedCondition;
+int numberOfUnfinishedJobs;
+bool poolIsShuttingDown;
+std::exception_ptr firstJobException;
+};
+
+#endif